@@ -0,0 +1,327 @@
+#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+
+AABB AABB::Empty()
+{
+    AABB box;
+    box.min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    box.max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    return box;
+}
+
+void AABB::Grow(const AABB& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+void AABB::Grow(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+glm::vec3 AABB::Center() const
+{
+    return (min + max) * 0.5f;
+}
+
+float AABB::SurfaceArea() const
+{
+    glm::vec3 size = max - min;
+    if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+    {
+        return 0.0f;
+    }
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<AABB>& bounds)
+{
+    uint32_t objectCount = (uint32_t)bounds.size();
+    m_bounds = bounds;
+    m_nodes.clear();
+    m_nodeRanges.clear();
+    m_parents.clear();
+    m_dirtyNodes.clear();
+
+    // a binary tree with at least one object per leaf never has more than 2n - 1 nodes
+    m_nodes.reserve(objectCount * 2);
+    m_nodeRanges.reserve(objectCount * 2);
+    m_parents.reserve(objectCount * 2);
+
+    m_objectIndices.resize(objectCount);
+    m_objectLeaves.resize(objectCount);
+    std::vector<glm::vec3> centroids(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        m_objectIndices[i] = i;
+        centroids[i] = bounds[i].Center();
+    }
+
+    if (objectCount > 0)
+    {
+        BuildNode(centroids, 0, objectCount, m_noParent);
+    }
+    m_dirty.assign(m_nodes.size(), 0);
+}
+
+uint32_t BoundingVolumeHierarchy::BuildNode(const std::vector<glm::vec3>& centroids, uint32_t first, uint32_t count, uint32_t parent)
+{
+    uint32_t nodeIndex = (uint32_t)m_nodes.size();
+    m_nodes.push_back(Node());
+    m_nodeRanges.push_back(ObjectRange{ first, count });
+    m_parents.push_back(parent);
+
+    AABB nodeBounds = AABB::Empty();
+    AABB centroidBounds = AABB::Empty();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        nodeBounds.Grow(m_bounds[m_objectIndices[i]]);
+        centroidBounds.Grow(centroids[m_objectIndices[i]]);
+    }
+    SetNodeBounds(nodeIndex, nodeBounds);
+
+    // split along the axis the centroids are most spread out on
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    // all the centroids are in the same spot, so there's no way to split them
+    if (count <= 2 || extent[axis] <= 0.0f)
+    {
+        MakeLeaf(nodeIndex, first, count);
+        return nodeIndex;
+    }
+
+    // drop everything into bins along the axis
+    struct Bin
+    {
+        AABB bounds = AABB::Empty();
+        uint32_t count = 0;
+    };
+    Bin bins[m_binCount];
+    float binScale = m_binCount / extent[axis];
+    auto getBin = [&](uint32_t objectIndex) {
+        int bin = (int)((centroids[objectIndex][axis] - centroidBounds.min[axis]) * binScale);
+        return std::min(bin, m_binCount - 1);
+    };
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        Bin& bin = bins[getBin(m_objectIndices[i])];
+        bin.bounds.Grow(m_bounds[m_objectIndices[i]]);
+        bin.count++;
+    }
+
+    // sweep from the right to get the cost of the right side of every split, then from the left to find the best one.
+    // split s puts bins [0, s] on the left
+    float rightCosts[m_binCount];
+    AABB rightBounds = AABB::Empty();
+    uint32_t rightCount = 0;
+    for (int s = m_binCount - 1; s > 0; --s)
+    {
+        rightBounds.Grow(bins[s].bounds);
+        rightCount += bins[s].count;
+        rightCosts[s - 1] = rightBounds.SurfaceArea() * rightCount;
+    }
+
+    float bestCost = FLT_MAX;
+    int bestSplit = -1;
+    AABB leftBounds = AABB::Empty();
+    uint32_t leftCount = 0;
+    for (int s = 0; s < m_binCount - 1; ++s)
+    {
+        leftBounds.Grow(bins[s].bounds);
+        leftCount += bins[s].count;
+        float cost = leftBounds.SurfaceArea() * leftCount + rightCosts[s];
+        if (leftCount > 0 && leftCount < count && cost < bestCost)
+        {
+            bestCost = cost;
+            bestSplit = s;
+        }
+    }
+
+    // not splitting at all means testing every object in the node, which costs about count * area. Splitting costs
+    // the two child box tests on top of whatever is below them, so it only pays off if it beats that
+    float nodeArea = nodeBounds.SurfaceArea();
+    float leafCost = nodeArea * count;
+    float splitCost = 2.0f * nodeArea + bestCost;
+    if (bestSplit < 0 || (count <= m_maxLeafSize && splitCost >= leafCost))
+    {
+        MakeLeaf(nodeIndex, first, count);
+        return nodeIndex;
+    }
+
+    uint32_t* middle = std::partition(&m_objectIndices[first], &m_objectIndices[first] + count,
+        [&](uint32_t objectIndex) { return getBin(objectIndex) <= bestSplit; });
+    uint32_t leftSize = (uint32_t)(middle - &m_objectIndices[first]);
+
+    // because of the depth first layout the left child is always nodeIndex + 1, so we only need to remember the right
+    BuildNode(centroids, first, leftSize, nodeIndex);
+    uint32_t right = BuildNode(centroids, first + leftSize, count - leftSize, nodeIndex);
+    m_nodes[nodeIndex].leftFirst = right;
+    m_nodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::MakeLeaf(uint32_t nodeIndex, uint32_t first, uint32_t count)
+{
+    m_nodes[nodeIndex].leftFirst = first;
+    m_nodes[nodeIndex].count = count;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        m_objectLeaves[m_objectIndices[i]] = nodeIndex;
+    }
+}
+
+void BoundingVolumeHierarchy::SetNodeBounds(uint32_t nodeIndex, const AABB& bounds)
+{
+    m_nodes[nodeIndex].min = bounds.min;
+    m_nodes[nodeIndex].max = bounds.max;
+}
+
+size_t BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& visibleIndices) const
+{
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+    size_t startSize = visibleIndices.size();
+
+    // each entry is a node still to visit, plus a bit for each frustum plane its parent wasn't completely in front of.
+    // Once a box is completely in front of a plane, so is everything inside it, so its children can skip that plane
+    struct StackEntry
+    {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    const uint32_t allPlanes = (1 << Frustum::PlaneCount) - 1;
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back(StackEntry{ 0, allPlanes });
+
+    while (!stack.empty())
+    {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_nodes[entry.node];
+
+        uint32_t planeMask = entry.planeMask;
+        bool outside = false;
+        for (int p = 0; p < Frustum::PlaneCount; ++p)
+        {
+            if ((planeMask & (1 << p)) == 0)
+            {
+                continue;
+            }
+            // the corners of the box furthest along and furthest against the plane normal
+            const glm::vec4& plane = frustum.GetPlane(p);
+            glm::vec3 furthest(plane.x >= 0.0f ? node.max.x : node.min.x, plane.y >= 0.0f ? node.max.y : node.min.y, plane.z >= 0.0f ? node.max.z : node.min.z);
+            glm::vec3 nearest(plane.x >= 0.0f ? node.min.x : node.max.x, plane.y >= 0.0f ? node.min.y : node.max.y, plane.z >= 0.0f ? node.min.z : node.max.z);
+            if (plane.x * furthest.x + plane.y * furthest.y + plane.z * furthest.z + plane.w < 0.0f)
+            {
+                outside = true;
+                break;
+            }
+            if (plane.x * nearest.x + plane.y * nearest.y + plane.z * nearest.z + plane.w >= 0.0f)
+            {
+                planeMask &= ~(1 << p);
+            }
+        }
+        if (outside)
+        {
+            continue;
+        }
+
+        if (planeMask == 0)
+        {
+            // completely inside, so everything under this node is visible
+            const ObjectRange& range = m_nodeRanges[entry.node];
+            visibleIndices.insert(visibleIndices.end(), &m_objectIndices[range.first], &m_objectIndices[range.first] + range.count);
+        }
+        else if (node.count > 0)
+        {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+            {
+                const AABB& bounds = m_bounds[m_objectIndices[i]];
+                if (frustum.IntersectsAABB(bounds.min, bounds.max))
+                {
+                    visibleIndices.push_back(m_objectIndices[i]);
+                }
+            }
+        }
+        else
+        {
+            // push the right child first so the left one (which is right after this node in memory) is visited next
+            stack.push_back(StackEntry{ node.leftFirst, planeMask });
+            stack.push_back(StackEntry{ entry.node + 1, planeMask });
+        }
+    }
+    return visibleIndices.size() - startSize;
+}
+
+void BoundingVolumeHierarchy::UpdateObject(uint32_t objectIndex, const AABB& bounds)
+{
+    m_bounds[objectIndex] = bounds;
+
+    // mark the leaf and everything above it, stopping as soon as we reach a node that's already marked, since
+    // everything above that one is marked too
+    uint32_t node = m_objectLeaves[objectIndex];
+    while (node != m_noParent && !m_dirty[node])
+    {
+        m_dirty[node] = 1;
+        m_dirtyNodes.push_back(node);
+        node = m_parents[node];
+    }
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+    // children always come after their parent in the depth first layout, so going from the highest index down means
+    // both children of a node are refitted before the node itself is. When lots of the tree has changed, it's
+    // cheaper to just walk every node backwards and pick out the marked ones than to sort the list of marked nodes
+    if (m_dirtyNodes.size() * 8 > m_nodes.size())
+    {
+        for (size_t nodeIndex = m_nodes.size(); nodeIndex-- > 0;)
+        {
+            if (m_dirty[nodeIndex])
+            {
+                RefitNode((uint32_t)nodeIndex);
+            }
+        }
+    }
+    else
+    {
+        std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end(), std::greater<uint32_t>());
+        for (uint32_t nodeIndex : m_dirtyNodes)
+        {
+            RefitNode(nodeIndex);
+        }
+    }
+    m_dirtyNodes.clear();
+}
+
+void BoundingVolumeHierarchy::RefitNode(uint32_t nodeIndex)
+{
+    const Node& node = m_nodes[nodeIndex];
+    AABB bounds = AABB::Empty();
+    if (node.count > 0)
+    {
+        for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+        {
+            bounds.Grow(m_bounds[m_objectIndices[i]]);
+        }
+    }
+    else
+    {
+        const Node& left = m_nodes[nodeIndex + 1];
+        const Node& right = m_nodes[node.leftFirst];
+        bounds.min = glm::min(left.min, right.min);
+        bounds.max = glm::max(left.max, right.max);
+    }
+    SetNodeBounds(nodeIndex, bounds);
+    m_dirty[nodeIndex] = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+/// <summary>
+/// Axis aligned bounding box
+/// </summary>
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    /// <summary>
+    /// A box that contains nothing, so that growing it by anything gives back that thing
+    /// </summary>
+    static AABB Empty();
+    void Grow(const AABB& other);
+    void Grow(const glm::vec3& point);
+    glm::vec3 Center() const;
+    float SurfaceArea() const;
+};
+
+/// <summary>
+/// A bounding volume hierarchy over a set of objects, used to find the ones inside a frustum without testing every
+/// object. Each node has a box around everything below it, so if a node's box is outside the frustum the whole
+/// subtree gets skipped, and if it's completely inside, everything below it is visible without any more tests.
+///
+/// The tree is built top down with a binned surface area heuristic: at each node, the object centroids are dropped
+/// into a handful of bins along the longest axis, and the split between bins that gives the smallest
+/// (area of left box * objects on the left) + (area of right box * objects on the right) wins, since that's roughly
+/// how many box tests a random query will have to do below this node.
+///
+/// Nodes are stored flattened in one array in depth first order, so a node's left child is always the very next node
+/// and only the right child's index needs storing. That makes a node 32 bytes (2 per cache line) and means the
+/// traversal mostly walks forward through memory.
+///
+/// When objects move, UpdateObject + Refit recompute the boxes of only the nodes above the objects that changed,
+/// without rebuilding the tree. That's much cheaper than a rebuild, but the tree gets less efficient if objects move
+/// far from where they were at build time, so rebuild now and then if that happens.
+/// </summary>
+class BoundingVolumeHierarchy
+{
+public:
+    void Build(const std::vector<AABB>& bounds);
+
+    /// <summary>
+    /// Appends the indices of all objects whose box intersects the frustum to visibleIndices, and returns how many
+    /// were added
+    /// </summary>
+    size_t QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& visibleIndices) const;
+
+    /// <summary>
+    /// Changes the box of one object. The tree isn't fixed up until Refit is called, so several objects can be
+    /// moved and then refitted in one go
+    /// </summary>
+    void UpdateObject(uint32_t objectIndex, const AABB& bounds);
+    void Refit();
+
+    size_t GetObjectCount() const { return m_bounds.size(); }
+    size_t GetNodeCount() const { return m_nodes.size(); }
+
+private:
+    struct Node
+    {
+        glm::vec3 min;
+        // for a leaf, the index of its first object in m_objectIndices. Otherwise the index of its right child
+        uint32_t leftFirst;
+        glm::vec3 max;
+        // number of objects in a leaf. 0 for interior nodes
+        uint32_t count;
+    };
+
+    // which objects are under a node. Thanks to the depth first layout they're always one contiguous run of
+    // m_objectIndices, even for interior nodes. Kept out of Node so nodes stay 32 bytes, since this is only
+    // needed when a node turns out to be completely inside the frustum
+    struct ObjectRange
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    static constexpr uint32_t m_noParent = 0xFFFFFFFF;
+    static constexpr int m_binCount = 16;
+    static constexpr uint32_t m_maxLeafSize = 8;
+
+    std::vector<Node> m_nodes;
+    std::vector<ObjectRange> m_nodeRanges;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_objectIndices;
+    std::vector<uint32_t> m_objectLeaves;
+    std::vector<AABB> m_bounds;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint32_t> m_dirtyNodes;
+
+    uint32_t BuildNode(const std::vector<glm::vec3>& centroids, uint32_t first, uint32_t count, uint32_t parent);
+    void MakeLeaf(uint32_t nodeIndex, uint32_t first, uint32_t count);
+    void SetNodeBounds(uint32_t nodeIndex, const AABB& bounds);
+    void RefitNode(uint32_t nodeIndex);
+};
@@ -0,0 +1,31 @@
+#include "CameraUniformBuffer.h"
+
+#include "GLStateCache.h"
+
+void CameraUniformBuffer::Create()
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_alignment = alignment;
+	GLsizeiptr stride = ((GLsizeiptr)sizeof(CameraUniforms) + m_alignment - 1) / m_alignment * m_alignment;
+	m_ring.Create(GL_UNIFORM_BUFFER, stride * m_frameCount, "Camera");
+}
+
+void CameraUniformBuffer::Destroy()
+{
+	m_ring.Destroy();
+}
+
+void CameraUniformBuffer::Update(const CameraUniforms& uniforms)
+{
+	GLintptr offset = m_ring.Write(&uniforms, sizeof(CameraUniforms), m_alignment);
+	if (offset >= 0)
+	{
+		GLStateCache::BindBufferRange(GL_UNIFORM_BUFFER, CameraUniforms::BindingPoint, m_ring.GetBuffer(), offset, sizeof(CameraUniforms));
+	}
+}
+
+void CameraUniformBuffer::EndFrame()
+{
+	m_ring.EndFrame();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "StreamingRingBuffer.h"
+
+/// <summary>
+/// The per-frame camera data every program reads from the "Camera" uniform block (src/shaders/simple/camera.glsl).
+/// The block is std140, so its layout is fixed by the spec rather than left to the driver: mat4s are 4 vec4 columns,
+/// vec4s are 16 byte aligned, and a lone float takes 4 bytes but the block size gets rounded up to 16. This struct
+/// has to match that byte for byte, which the static_asserts below check, so change both together
+/// </summary>
+struct CameraUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition; // w is unused
+	float time;
+	float padding[3];
+
+	static constexpr const char* BlockName = "Camera";
+	// every program has its Camera block bound to this binding point (see Shader::bindUniformBlocks), so the buffer
+	// only has to be bound here once per frame, however many programs read it
+	static constexpr GLuint BindingPoint = 0;
+};
+static_assert(offsetof(CameraUniforms, view) == 0, "std140: view must be at offset 0");
+static_assert(offsetof(CameraUniforms, projection) == 64, "std140: projection must be at offset 64");
+static_assert(offsetof(CameraUniforms, viewProjection) == 128, "std140: viewProjection must be at offset 128");
+static_assert(offsetof(CameraUniforms, cameraPosition) == 192, "std140: cameraPosition must be at offset 192");
+static_assert(offsetof(CameraUniforms, time) == 208, "std140: time must be at offset 208");
+static_assert(sizeof(CameraUniforms) == 224, "std140: the block size is rounded up to a multiple of 16");
+static_assert(sizeof(glm::mat4) == 64 && sizeof(glm::vec4) == 16, "glm types must be tightly packed floats");
+
+/// <summary>
+/// The buffer behind the Camera block. Writing into a uniform buffer the GPU might still be reading from (the previous
+/// frame's draws) makes the driver stall until it's done, or quietly copy the buffer. To avoid both, each frame's copy
+/// of the block gets fresh space in a StreamingRingBuffer big enough for m_frameCount of them, so the GPU can be a
+/// couple of frames behind without anyone waiting. The ring takes care of the persistent mapping (or the unsynchronized
+/// fallback on 3.3) and the fences that say when a copy is free again
+/// </summary>
+class CameraUniformBuffer
+{
+public:
+	CameraUniformBuffer() = default;
+	CameraUniformBuffer(const CameraUniformBuffer&) = delete;
+	CameraUniformBuffer& operator=(const CameraUniformBuffer&) = delete;
+
+	/// <summary>
+	/// Needs a current context. Call Destroy (or let the destructor do it) before the context goes away
+	/// </summary>
+	void Create();
+	void Destroy();
+
+	/// <summary>
+	/// Writes this frame's copy of the block and binds it to CameraUniforms::BindingPoint. Call once per frame, before
+	/// the draws that use it
+	/// </summary>
+	void Update(const CameraUniforms& uniforms);
+
+	/// <summary>
+	/// Call after the last draw of the frame that reads the block, so this frame's copy isn't reused until the GPU is done
+	/// </summary>
+	void EndFrame();
+
+	bool IsPersistentlyMapped() const { return m_ring.IsPersistentlyMapped(); }
+	uint64_t GetFenceWaitCount() const { return m_ring.GetFenceWaitCount(); }
+
+private:
+	static constexpr int m_frameCount = 3;
+
+	StreamingRingBuffer m_ring;
+	// each copy starts on a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which glBindBufferRange requires
+	GLsizeiptr m_alignment = 256;
+};
@@ -1,4 +1,12 @@
 #include "CoordinateSystems.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "VertexArrayCache.h"
+#include "VertexLayout.h"
 
 // static non-const class members must be defined outside of the class definition as well. This is done in the cpp bc they're considered an implementation detail.
 float CoordinateSystems::yaw;
@@ -7,12 +15,200 @@ float CoordinateSystems::lastX, CoordinateSystems::lastY;
 float CoordinateSystems::fov;
 bool CoordinateSystems::firstMouse;
 
-CoordinateSystems::CoordinateSystems(IApplicationParamsProvider* appParamsProvider) : Texturing(appParamsProvider) {
+// the cube's corners are all +-0.5 and its texture coordinates 0 or 1, which half floats and 16 bit normalized ints
+// hold exactly, in 12 bytes a vertex instead of 20. No normalized int format holds 0.5 exactly (their max is odd), so
+// positions any smaller than a padded half float would move the corners
+using CubeVertexLayout = VertexLayout<Pos3h, UV2us>;
+// the instanced shader's aModel, at location 2. A mat4 takes up 4 locations, one per column, so it covers 2 to 5
+using CubeInstanceLayout = InstanceLayout<Mat4f>;
+static_assert(CubeInstanceLayout::Matches<glm::mat4>(), "the instance buffer is tightly packed model matrices");
+// the cube from one buffer and the matrices from another, which lands the matrix on locations 2 to 5
+using InstancedCubeLayout = MultiBufferVertexLayout<CubeVertexLayout, CubeInstanceLayout>;
+static_assert(CubeVertexLayout::LocationCount == 2, "the instanced shader expects aModel at location 2");
+
+// every cube spins around this. The GPU culling path needs it too, since it builds the matrices itself
+static const glm::vec3 s_cubeRotationAxis(1.0f, 0.3f, 0.5f);
+
+CoordinateSystems::CoordinateSystems(IApplicationParamsProvider* appParamsProvider, unsigned int cubeCount, bool instanced, bool gpuCulling) :
+    Texturing(appParamsProvider), m_transformKernel(s_cubeRotationAxis) {
     lastY = 300;
     lastX = 400;
     yaw = -90.0f;
     fov = 45.0f;
     firstMouse = true;
+    // the GPU path draws with the instanced shader too, and if the context can't do it, the instanced CPU path is next best
+    m_gpuCullingRequested = gpuCulling;
+    m_instanced = instanced || gpuCulling;
+    CreateCubePositions(cubeCount);
+    m_visibleCubes.Resize(cubeCount);
+    m_visibleIndices.resize(cubeCount);
+    m_cubeTransforms.resize(cubeCount);
+    m_chunkVisibleCounts.resize((cubeCount + m_cubeChunkSize - 1) / m_cubeChunkSize);
+    if (cubeCount >= m_bvhCubeThreshold)
+    {
+        BuildCubeBvh();
+    }
+}
+
+/// <summary>
+/// Keeps the original 10 cubes where they were, then scatters any extra cubes randomly in a box that grows with the
+/// cube count so that the density stays roughly the same. The seed is fixed so every run gets the same field.
+/// </summary>
+void CoordinateSystems::CreateCubePositions(unsigned int cubeCount)
+{
+    m_cubes.Resize(cubeCount);
+
+    // roughly one cube per 3x3x3 block of space
+    float halfExtent = 1.5f * std::cbrt((float)cubeCount);
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> distribution(-halfExtent, halfExtent);
+    for (unsigned int i = 0; i < cubeCount; ++i)
+    {
+        if (i < m_presetCubeCount)
+        {
+            m_cubes.x[i] = m_presetCubePositions[i].x;
+            m_cubes.y[i] = m_presetCubePositions[i].y;
+            m_cubes.z[i] = m_presetCubePositions[i].z;
+        }
+        else
+        {
+            m_cubes.x[i] = distribution(generator);
+            m_cubes.y[i] = distribution(generator);
+            m_cubes.z[i] = distribution(generator);
+        }
+        // every cube starts off rotated 20 degrees more than the last one
+        m_cubes.angleDegrees[i] = 20.0f * i;
+    }
+}
+
+/// <summary>
+/// Puts a box around every cube's bounding sphere and builds m_bvh from them. The cubes never move, so this only has to
+/// happen once
+/// </summary>
+void CoordinateSystems::BuildCubeBvh()
+{
+    std::vector<AABB> bounds(m_cubes.Size());
+    glm::vec3 halfSize(m_cubeBoundingRadius, m_cubeBoundingRadius, m_cubeBoundingRadius);
+    for (size_t i = 0; i < m_cubes.Size(); ++i)
+    {
+        glm::vec3 center(m_cubes.x[i], m_cubes.y[i], m_cubes.z[i]);
+        bounds[i].min = center - halfSize;
+        bounds[i].max = center + halfSize;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    m_bvh.Build(bounds);
+    std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
+    m_useBvh = true;
+    std::cout << "Built BVH over " << m_cubes.Size() << " cubes: " << m_bvh.GetNodeCount() << " nodes in " << buildTime.count() << " ms" << std::endl;
+}
+
+/// <summary>
+/// Kicks off culling the cube field against the frustum and computing the model matrices of whatever is left, on the
+/// job system. m_transformJob has to be waited on before m_cubeTransforms and m_chunkVisibleCounts can be read.
+/// </summary>
+void CoordinateSystems::StartCubeTransformUpdate(float time, const Frustum& frustum)
+{
+    if (m_useBvh)
+    {
+        // the tree walk is quick enough to do right here, and then the visible cubes are handed out to the workers
+        // in chunks just like the whole field is otherwise. The chunks past the end of the list get nothing
+        m_visibleIndices.clear();
+        size_t visibleCount = m_bvh.QueryFrustum(frustum, m_visibleIndices);
+        m_jobSystem.Dispatch(m_transformJob, m_chunkVisibleCounts.size(), 1, [this, time, visibleCount](size_t firstChunk, size_t endChunk) {
+            for (size_t chunk = firstChunk; chunk < endChunk; ++chunk)
+            {
+                size_t first = chunk * m_cubeChunkSize;
+                size_t count = first < visibleCount ? std::min(m_cubeChunkSize, visibleCount - first) : 0;
+                TransformVisibleCubes(first, count, time);
+                m_chunkVisibleCounts[chunk] = count;
+            }
+        });
+        return;
+    }
+
+    // the frustum is captured by value, since the job outlives this call
+    m_jobSystem.Dispatch(m_transformJob, m_chunkVisibleCounts.size(), 1, [this, time, frustum](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; ++chunk)
+        {
+            size_t first = chunk * m_cubeChunkSize;
+            size_t count = std::min(m_cubeChunkSize, m_cubes.Size() - first);
+            size_t visibleCount = frustum.CullSpheres(m_cubes.x.data(), m_cubes.y.data(), m_cubes.z.data(), m_cubeBoundingRadius,
+                first, count, &m_visibleIndices[first]);
+            TransformVisibleCubes(first, visibleCount, time);
+            m_chunkVisibleCounts[chunk] = visibleCount;
+        }
+    });
+}
+
+/// <summary>
+/// Computes the model matrices of the cubes listed in m_visibleIndices[first] to m_visibleIndices[first + visibleCount - 1],
+/// into the same range of m_cubeTransforms
+/// </summary>
+void CoordinateSystems::TransformVisibleCubes(size_t first, size_t visibleCount, float time)
+{
+    // pack the visible cubes together so the kernel can go through them in one go.
+    // translate each cube to its position, and rotate it about <1, 0.3, 0.5> axis 20 degrees times i (+ a bit more per unit time passed, for every third box)
+    // these will be used as the model matrices in the vertex shader
+    for (size_t j = 0; j < visibleCount; ++j)
+    {
+        uint32_t i = m_visibleIndices[first + j];
+        float angle = m_cubes.angleDegrees[i];
+        if (i % 3 == 0) {
+            angle += time * 5.0f;
+        }
+        m_visibleCubes.x[first + j] = m_cubes.x[i];
+        m_visibleCubes.y[first + j] = m_cubes.y[i];
+        m_visibleCubes.z[first + j] = m_cubes.z[i];
+        m_visibleCubes.angleDegrees[first + j] = angle;
+    }
+    m_transformKernel.ComputeModelMatrices(m_visibleCubes, first, visibleCount, m_cubeTransforms.data());
+}
+
+/// <summary>
+/// Prints how many cubes made it through culling, and complains if anything in the frame loop looked up a uniform by name.
+/// Only once a second, since printing every frame slows things down more than the culling saves
+/// </summary>
+void CoordinateSystems::ReportCullingStats(float time)
+{
+    if (time - m_lastCullingReportTime < 1.0f)
+    {
+        return;
+    }
+    m_lastCullingReportTime = time;
+    if (m_useGpuCulling)
+    {
+        // the CPU never sees the culling results otherwise
+        m_visibleCubeCount = m_gpuCulling.ReadVisibleCount();
+    }
+    size_t cubeCount = m_cubes.Size();
+    std::cout << "Visible cubes: " << m_visibleCubeCount << " of " << cubeCount
+        << " (" << cubeCount - m_visibleCubeCount << " culled)";
+    if (!m_useGpuCulling)
+    {
+        std::cout << ", transformed with " << TransformKernel::GetInstructionSetName(m_transformKernel.GetInstructionSet())
+            << " on " << m_jobSystem.GetWorkerCount() << " worker threads";
+    }
+    std::cout << std::endl;
+
+    // nothing in the frame loop should be asking the driver for uniform locations any more
+    size_t lookups = Shader::getUniformLocationLookupCount() - m_uniformLookupsBeforeLoop;
+    if (lookups > 0)
+    {
+        std::cout << "WARNING: " << lookups << " glGetUniformLocation calls made inside the frame loop" << std::endl;
+    }
+
+    const GLStateCache::Counters& stateCalls = GLStateCache::GetLastFrameCounters();
+    std::cout << "State changes last frame: " << stateCalls.issued << " issued, " << stateCalls.skipped << " skipped as redundant" << std::endl;
+    const VertexArrayCache::Counters& vertexArrayCalls = VertexArrayCache::GetLastFrameCounters();
+    std::cout << "VAOs: " << VertexArrayCache::GetVertexArrayCount() << ", " << stateCalls.vertexArraySwitches << " switches and "
+        << vertexArrayCalls.vertexBufferBinds << " vertex buffer binds last frame" << std::endl;
+    const RenderQueue::Stats& queueStats = m_renderQueue.GetLastStats();
+    std::cout << "Render queue: " << queueStats.commands << " draws, " << queueStats.stateChangesSorted << " state changes sorted vs "
+        << queueStats.stateChangesUnsorted << " in submission order" << std::endl;
+    // should hold steady from one report to the next. If it creeps up, something is being made every frame and not freed
+    std::cout << "GL objects: " << GLResourceRegistry::GetLiveCount() << " live, ~" << GLResourceRegistry::GetTotalBytes() / 1024
+        << " KB" << std::endl;
 }
 
 int CoordinateSystems::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader& shader2, unsigned int VAO, unsigned int VAO2, unsigned int texture1, unsigned int texture2)
@@ -28,24 +224,23 @@ int CoordinateSystems::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader&
     // if this was isometric this wouldn't work, instead you'd need to change the left/right/top/bottom of the orthogonal projection matrix
     glfwSetScrollCallback(window, CoordinateSystems::scroll_callback);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glEnable(GL_DEPTH_TEST); // z is important. It doesn't check z buffer by default.
+    GLStateCache::PolygonMode(GL_FILL);
+    GLStateCache::Enable(GL_DEPTH_TEST); // z is important. It doesn't check z buffer by default.
+
+    // resolve the uniforms once up front. "model" in particular gets set once per cube per frame in the non instanced path
+    UniformHandle modelUniform = shader.getUniformHandle("model", GL_FLOAT_MAT4);
+    m_uniformLookupsBeforeLoop = Shader::getUniformLocationLookupCount();
+    m_cameraBuffer.Create();
+
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = (float) glfwGetTime();
         m_deltaTime = currentFrame - m_lastFrame;
         m_lastFrame = currentFrame;
         GLFWUtilities::closeWindowIfEscapePressed(window);
+        ShaderHotReload::Update();
+        m_textureLoader.Update();
         CoordinateSystems::processInput(window);
-        glClearColor(0.3f, 0.6f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear both the color and z buffers, or the previous frame's z will be there.
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        shader.use();
 
         // MODEL MATRIX
         //glm::mat4 model = glm::mat4(1.0);
@@ -89,29 +284,69 @@ int CoordinateSystems::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader&
         glm::mat4 projection;
 
         // fov, aspect ratio, near, far
-        projection = glm::perspective(fov, 800.0f / 600.0f, 0.1f, 100.0f);
+        projection = glm::perspective(fov, 800.0f / 600.0f, 0.1f, m_farPlane);
 
-        //shader.setMat4("model", glm::value_ptr(model));
-        shader.setMat4("view", glm::value_ptr(view));
-        shader.setMat4("projection", glm::value_ptr(projection));
-        
-        glBindVertexArray(VAO);
-        for (unsigned int i = 0; i < 10; ++i)
+        // now we know where the camera is looking, the workers can start on culling and the model matrices. Or the GPU
+        // can, in which case none of the CPU culling below happens
+        Frustum frustum(projection * view);
+        if (m_useGpuCulling)
         {
-            // translate the cube to its position in cubePositions[i], and rotate it about <1, 0.3, 0.5> axis 20 degrees times i (+ a bit more per unit time passed, for every third box)
-            // this will be used as the model matrix in the vertex shader
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            if (i % 3 == 0) {
-                angle += (float)glfwGetTime() * 5.0f;
-            }
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            shader.setMat4("model", glm::value_ptr(model));
+            m_gpuCulling.Cull(frustum, currentFrame);
+        }
+        else
+        {
+            StartCubeTransformUpdate(currentFrame, frustum);
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        glClearColor(0.3f, 0.6f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear both the color and z buffers, or the previous frame's z will be there.
+
+        // the camera block is shared by every program, so this is the only place view and projection get set
+        CameraUniforms camera;
+        camera.view = view;
+        camera.projection = projection;
+        camera.viewProjection = projection * view;
+        camera.cameraPosition = glm::vec4(m_cameraPos, 1.0f);
+        camera.time = currentFrame;
+        m_cameraBuffer.Update(camera);
+
+        //shader.setMat4("model", glm::value_ptr(model));
 
+        // every cube is drawn with the same program, textures and VAO, so only the model matrix and depth differ
+        RenderQueue::Command cube;
+        cube.shader = &shader;
+        cube.vertexArray = VAO;
+        cube.textures[0] = m_textureLoader.GetTexture(texture1);
+        cube.textures[1] = m_textureLoader.GetTexture(texture2);
+        cube.indexType = GL_UNSIGNED_INT;
+        const GeometryPool::Mesh& cubeMesh = m_geometryPool.GetMesh(m_cubeMeshId);
+        cube.count = cubeMesh.indexCount;
+        cube.first = cubeMesh.firstIndex;
+        cube.baseVertex = cubeMesh.baseVertex;
+
+        if (m_useGpuCulling)
+        {
+            // the program, textures and VAO as a render queue command would set them, then every cube in one call
+            shader.use();
+            GLStateCache::BindTextureUnit(0, GL_TEXTURE_2D, cube.textures[0]);
+            GLStateCache::BindTextureUnit(1, GL_TEXTURE_2D, cube.textures[1]);
+            GLStateCache::BindVertexArray(VAO);
+            m_gpuCulling.Draw(GL_TRIANGLES);
+        }
+        else
+        {
+            DrawCpuCulledCubes(cube, modelUniform);
         }
+        m_renderQueue.Execute();
+
+        // nothing else this frame reads the camera block or the matrices, so their space can be reused once the GPU
+        // gets past here
+        m_cameraBuffer.EndFrame();
+        m_instanceRing.EndFrame();
+        m_textureLoader.EndFrame();
+        GLStateCache::EndFrame();
+        VertexArrayCache::EndFrame();
+        ReportCullingStats(currentFrame);
 
         //glDrawElements(GL_TRIANGLES, sizeof(m_indices), GL_UNSIGNED_INT, 0);
 
@@ -119,54 +354,179 @@ int CoordinateSystems::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader&
 
         glfwSwapBuffers(window);
     }
-    glfwTerminate();
+    m_cameraBuffer.Destroy();
+    m_instanceRing.Destroy();
+    m_gpuCulling.Destroy();
     return 0;
 }
 
-const float* CoordinateSystems::GetVertices(size_t& size)
+/// <summary>
+/// Waits for the workers to finish this frame's culling and model matrices, then submits the visible cubes to the
+/// render queue: all of them as one instanced draw, or one draw each
+/// </summary>
+void CoordinateSystems::DrawCpuCulledCubes(RenderQueue::Command cube, UniformHandle modelUniform)
 {
-    size = sizeof(m_verticesCube);
-    return m_verticesCube;
+    // everything before this only needed the main thread. From here on we need this frame's model matrices
+    m_jobSystem.Wait(m_transformJob);
+    m_visibleCubeCount = 0;
+    for (size_t visibleCount : m_chunkVisibleCounts)
+    {
+        m_visibleCubeCount += visibleCount;
+    }
+
+    if (m_instanced)
+    {
+        // the visible matrices are at the start of each chunk's slice. Pack them together into fresh space in the
+        // ring, which the GPU isn't reading from, so neither the copy nor the draw waits on last frame's draws
+        StreamingRingBuffer::Allocation instances = m_instanceRing.Allocate(m_visibleCubeCount * sizeof(glm::mat4), sizeof(glm::vec4));
+        if (instances.data)
+        {
+            unsigned char* destination = (unsigned char*)instances.data;
+            for (size_t chunk = 0; chunk < m_chunkVisibleCounts.size(); ++chunk)
+            {
+                size_t chunkBytes = m_chunkVisibleCounts[chunk] * sizeof(glm::mat4);
+                memcpy(destination, &m_cubeTransforms[chunk * m_cubeChunkSize], chunkBytes);
+                destination += chunkBytes;
+            }
+            m_instanceRing.Commit(instances);
+            cube.vertexArray = BindCubeVertexArray(instances.offset);
+
+            // one call for the whole field. The vertex shader picks up its model matrix from the instanced attribute
+            cube.instanceCount = (GLsizei)m_visibleCubeCount;
+            m_renderQueue.Submit(cube, 0.0f);
+        }
+    }
+    else
+    {
+        // one draw per cube, sorted front to back so the depth test can skip the hidden ones' fragments
+        cube.matrixUniform = modelUniform;
+        for (size_t chunk = 0; chunk < m_chunkVisibleCounts.size(); ++chunk)
+        {
+            for (size_t j = 0; j < m_chunkVisibleCounts[chunk]; ++j)
+            {
+                const glm::mat4& model = m_cubeTransforms[chunk * m_cubeChunkSize + j];
+                cube.matrix = glm::value_ptr(model);
+                float distance = glm::length(glm::vec3(model[3].x, model[3].y, model[3].z) - m_cameraPos);
+                m_renderQueue.Submit(cube, distance / m_farPlane);
+            }
+        }
+    }
+}
+
+const void* CoordinateSystems::GetVertices(size_t& size)
+{
+    size = m_cubeMesh.vertices.size() * sizeof(float);
+    return m_cubeMesh.vertices.data();
 }
 
-const char* CoordinateSystems::GetVertexShaderPath()
+const char* CoordinateSystems::GetVertexShaderName()
 {
     return m_overriddenVertexShader;
 }
 
-const char* CoordinateSystems::GetFragmentShaderPath()
+std::vector<std::string> CoordinateSystems::GetShaderKeywords()
 {
-    return m_overriddenFragmentShader;
+    if (m_instanced)
+    {
+        return { "INSTANCED" };
+    }
+    return {};
 }
 
 void CoordinateSystems::CreateRectangle(GLuint& VAO)
 {
-    // array object to store raw vertices, element buffers, and vertex attribute settings
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    // Run asks for two, but they'd be the same, so the cube is only added once and VertexArrayCache hands back the
+    // same VAO both times
+    if (m_cubeMeshId == GeometryPool::InvalidMesh)
+    {
+        CreateCubeBuffers();
+    }
+    if (m_instanced)
+    {
+        CreateInstanceBuffer();
+        VAO = BindCubeVertexArray(0);
+    }
+    else
+    {
+        GLuint vertexBuffer = m_geometryPool.GetVertexBuffer();
+        VAO = VertexArrayCache::Bind(CubeVertexLayout::GetFormat(), &vertexBuffer, nullptr, m_geometryPool.GetIndexBuffer());
+    }
+}
+
+/// <summary>
+/// Adds the cube's vertices and indices to m_geometryPool, which is made for the cube's vertex format here
+/// </summary>
+void CoordinateSystems::CreateCubeBuffers()
+{
+    // the cube as written is 36 vertices, one per corner of every triangle. Merged, it's the 16 distinct ones (the
+    // texture coordinates only tell some of the faces' corners apart), and the triangles get reordered to reuse them
+    m_cubeMesh = MeshProcessing::Optimize(m_verticesCube, m_cubeVertexCount, 5, "cube");
 
-    // raw vertices
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
     size_t size;
-    const float* vertices = GetVertices(size);
-    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
-
-    // element buffer
-    unsigned int EBO;
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m_indices), m_indices, GL_STATIC_DRAW);
-
-    VertexBufferLayout vertexBufferLayout(std::vector<int>{3, 2});
-    vertexBufferLayout.Process();
-    //GLsizei stride = 5 * sizeof(float);
-    //glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    //glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    //glEnableVertexAttribArray(0);
-    //glEnableVertexAttribArray(1);
+    // the merged cube's vertices are still the plain floats m_verticesCube is written in, which Quantize packs
+    const float* vertices = static_cast<const float*>(GetVertices(size));
+    VertexBufferLayout vertexBufferLayout(CubeVertexLayout::GetAttributes());
+    size_t vertexCount = size / (vertexBufferLayout.GetSourceFloatCount() * sizeof(float));
+    std::vector<unsigned char> quantizedVertices = vertexBufferLayout.Quantize(vertices, vertexCount);
+
+    if (!m_geometryPool.IsCreated())
+    {
+        m_geometryPool.Create(CubeVertexLayout::Stride, 4096, 16384, "CoordinateSystems");
+    }
+    m_cubeMeshId = m_geometryPool.Add(quantizedVertices.data(), vertexCount, m_cubeMesh.indices.data(), m_cubeMesh.indices.size());
+}
+
+/// <summary>
+/// Makes the buffer the per-instance model matrices (see CubeInstanceLayout) come from. Their divisor of 1 makes
+/// OpenGL advance to the next matrix once per instance rather than once per vertex.
+/// On the CPU path the matrices live in a ring buffer with room for 3 frames of them, and where this frame's are
+/// changes every frame, so the VAO gets pointed at them again per frame by BindCubeVertexArray. On the GPU culling
+/// path they're wherever the compute shader wrote them, which never moves.
+/// </summary>
+void CoordinateSystems::CreateInstanceBuffer()
+{
+    // the context exists by now, so this is the first point we can tell whether it can do the GPU path
+    if (m_gpuCullingRequested && !m_useGpuCulling && !m_instanceRing.GetBuffer())
+    {
+        m_useGpuCulling = GpuCulling::IsSupported();
+        if (!m_useGpuCulling)
+        {
+            std::cout << "GPU culling needs OpenGL 4.3, falling back to culling on the CPU" << std::endl;
+        }
+    }
+
+    if (m_useGpuCulling)
+    {
+        if (!m_gpuCulling.IsCreated())
+        {
+            // the same spin as TransformVisibleCubes gives every third cube
+            std::vector<float> spinDegreesPerSecond(m_cubes.Size());
+            for (size_t i = 0; i < m_cubes.Size(); ++i)
+            {
+                spinDegreesPerSecond[i] = i % 3 == 0 ? 5.0f : 0.0f;
+            }
+            const GeometryPool::Mesh& cubeMesh = m_geometryPool.GetMesh(m_cubeMeshId);
+            m_gpuCulling.Create(m_cubes, spinDegreesPerSecond, m_cubeBoundingRadius, s_cubeRotationAxis, cubeMesh.indexCount,
+                cubeMesh.firstIndex, cubeMesh.baseVertex);
+        }
+    }
+    else if (m_instanceRing.GetBuffer() == 0)
+    {
+        m_instanceRing.Create(GL_ARRAY_BUFFER, 3 * m_cubeTransforms.size() * sizeof(glm::mat4), "Instance matrices");
+    }
+}
+
+/// <summary>
+/// Binds the instanced cube's VAO with the model matrices starting instanceOffset bytes into the instance buffer, and
+/// returns it. With separate vertex formats that's just a glBindVertexBuffer, otherwise the matrix attribute pointers
+/// are set again
+/// </summary>
+GLuint CoordinateSystems::BindCubeVertexArray(GLintptr instanceOffset)
+{
+    GLuint instanceBuffer = m_useGpuCulling ? m_gpuCulling.GetMatrixBuffer() : m_instanceRing.GetBuffer();
+    GLuint buffers[InstancedCubeLayout::BufferCount] = { m_geometryPool.GetVertexBuffer(), instanceBuffer };
+    GLintptr offsets[InstancedCubeLayout::BufferCount] = { 0, instanceOffset };
+    return VertexArrayCache::Bind(InstancedCubeLayout::GetFormat(), buffers, offsets, m_geometryPool.GetIndexBuffer());
 }
 
 void CoordinateSystems::processInput(GLFWwindow *window) {
@@ -8,18 +8,27 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <stb/stb_image.h>
+#include <vector>
 
+#include "BoundingVolumeHierarchy.h"
+#include "CameraUniformBuffer.h"
+#include "Frustum.h"
 #include "GLFWUtilities.h"
+#include "GpuCulling.h"
 #include "IApplicationParamsProvider.h"
+#include "JobSystem.h"
+#include "MeshProcessing.h"
 #include "OpenGLUtilities.h"
+#include "StreamingRingBuffer.h"
 #include "Texturing.h"
+#include "TransformKernel.h"
 #include "VertexBufferLayout.h"
 
 class CoordinateSystems: public Texturing
 {
 private:
-    static constexpr const char* m_overriddenVertexShader = "\\vertex_textured_coordinate_system.glsl";
-    static constexpr const char* m_overriddenFragmentShader = "\\fragment_textured_coordinate_system.glsl";
+    // the fragment shader is the same one Texturing uses, just built without any of its keywords
+    static constexpr const char* m_overriddenVertexShader = "vertex_textured_coordinate_system.glsl";
     glm::vec3 m_cameraPos   = glm::vec3(0.0f, 0.0f, 3.0f); // start position
     glm::vec3 m_cameraFront = glm::vec3(0.0,  0.0, -1.0f); // looking down local negative z axis
     glm::vec3 m_cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f); // world up vec
@@ -32,6 +41,51 @@ private:
     static float lastX, lastY;
     static float fov;
     static constexpr float m_sensitivity = 0.1f;
+    static constexpr float m_farPlane = 100.0f;
+
+    // instancing: when enabled, the whole cube field is drawn with one glDrawArraysInstanced call, with the model
+    // matrices streamed into m_instanceRing every frame instead of being set one at a time through the "model" uniform
+    bool m_instanced;
+    StreamingRingBuffer m_instanceRing;
+
+    // GPU culling: with GL 4.3, a compute shader culls the field and builds the matrices, and one multi draw indirect
+    // call draws it, so the CPU does nothing per cube at all. Without 4.3 the instanced CPU path is used instead
+    bool m_gpuCullingRequested = false;
+    bool m_useGpuCulling = false;
+    GpuCulling m_gpuCulling;
+
+    // every cube rotates around the same axis, so one kernel does the whole field. The work is split across the job
+    // system's worker threads, while the main thread (the only one allowed to touch the GL context) gets on with the
+    // GL calls for the frame
+    TransformKernel m_transformKernel;
+    JobSystem m_jobSystem;
+    JobSystem::Counter m_transformJob;
+
+    // frustum culling. The field is split into fixed size chunks, and each chunk culls its cubes, packs the visible
+    // ones to the start of its slice of m_visibleCubes and computes their matrices into the same slice of
+    // m_cubeTransforms. So only the first m_chunkVisibleCounts[k] entries of chunk k's slice are valid
+    static constexpr size_t m_cubeChunkSize = 4096;
+    // a cube can spin any way it likes and still fit in this sphere (half the length of its diagonal)
+    static constexpr float m_cubeBoundingRadius = 0.8660254f;
+    TransformBatch m_visibleCubes;
+    std::vector<uint32_t> m_visibleIndices;
+    std::vector<glm::mat4> m_cubeTransforms;
+    std::vector<size_t> m_chunkVisibleCounts;
+    size_t m_visibleCubeCount = 0;
+    float m_lastCullingReportTime = 0.0f;
+    size_t m_uniformLookupsBeforeLoop = 0;
+
+    // view and projection go to every program through one uniform buffer, instead of a pair of glUniformMatrix4fv
+    // calls per program per frame
+    CameraUniformBuffer m_cameraBuffer;
+
+    // for big fields, testing every cube against the frustum costs more than the rest of the frame, so the cubes go in
+    // a BVH instead and only the branches that reach into the frustum get looked at. The cubes spin in place, and the
+    // bounding boxes are built around the bounding sphere, so they never need refitting. The main thread queries the
+    // tree into m_visibleIndices, and the chunks then split up that list instead of the whole field
+    static constexpr unsigned int m_bvhCubeThreshold = 16384;
+    bool m_useBvh = false;
+    BoundingVolumeHierarchy m_bvh;
 
 protected:
     const float m_verticesCube[180] = {
@@ -78,7 +132,16 @@ protected:
     -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
     };
     
-    glm::vec3 cubePositions[10] = {
+    static constexpr int m_cubeVertexCount = 36;
+    // m_verticesCube indexed and reordered by MeshProcessing, which is what actually gets drawn, from m_geometryPool.
+    // Built by CreateCubeBuffers
+    IndexedMesh m_cubeMesh;
+    GeometryPool::MeshId m_cubeMeshId = GeometryPool::InvalidMesh;
+
+    // the original hand-placed cubes. If more cubes are requested than this, the rest get scattered randomly
+    // around them (see CreateCubePositions)
+    static constexpr int m_presetCubeCount = 10;
+    const glm::vec3 m_presetCubePositions[m_presetCubeCount] = {
           glm::vec3(0.0f,  0.0f,  0.0f),
           glm::vec3(2.0f,  5.0f, -15.0f),
           glm::vec3(-1.5f, -2.2f, -2.5f),
@@ -90,6 +153,7 @@ protected:
           glm::vec3(1.5f,  0.2f, -1.5f),
           glm::vec3(-1.3f,  1.0f, -1.5f)
     };
+    TransformBatch m_cubes;
 
     const float m_verticesNormal[32] = {
         // positions          // colors           // texture coords
@@ -101,17 +165,26 @@ protected:
 
 private:
     void processInput(GLFWwindow* window);
+    void CreateCubePositions(unsigned int cubeCount);
+    void CreateCubeBuffers();
+    void CreateInstanceBuffer();
+    GLuint BindCubeVertexArray(GLintptr instanceOffset);
+    void BuildCubeBvh();
+    void StartCubeTransformUpdate(float time, const Frustum& frustum);
+    void TransformVisibleCubes(size_t first, size_t visibleCount, float time);
+    void ReportCullingStats(float time);
+    void DrawCpuCulledCubes(RenderQueue::Command cube, UniformHandle modelUniform);
     glm::mat4 lookAt(glm::vec3 cameraPosition, glm::vec3 lookDirection, glm::vec3 worldUpVector);
     static void mouse_callback(GLFWwindow* window, double xpos, double ypos); // callback function for OpenGL
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 protected:
     virtual int ExecuteWindow(GLFWwindow* window, Shader& shader, Shader& shader2, unsigned int VAO, unsigned int VAO2, unsigned int texture1, unsigned int texture2);
-    virtual const float* GetVertices(size_t& size);
-    virtual const char* GetVertexShaderPath();
-    virtual const char* GetFragmentShaderPath();
+    virtual const void* GetVertices(size_t& size);
+    virtual const char* GetVertexShaderName();
+    virtual std::vector<std::string> GetShaderKeywords();
     virtual void CreateRectangle(GLuint& VAO);
 
 public:
-    CoordinateSystems(IApplicationParamsProvider* appParamsProvider);
+    CoordinateSystems(IApplicationParamsProvider* appParamsProvider, unsigned int cubeCount = 10, bool instanced = false, bool gpuCulling = false);
 };
 
@@ -0,0 +1,995 @@
+#include "CpuBenchmarks.h"
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BoundingVolumeHierarchy.h"
+#include "FreeListAllocator.h"
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "GpuCulling.h"
+#include "JobSystem.h"
+#include "MeshProcessing.h"
+#include "RenderQueue.h"
+#include "RingAllocator.h"
+#include "Shader.h"
+#include "TransformKernel.h"
+#include "VertexBufferLayout.h"
+
+/// <summary>
+/// Runs func a few times and returns the fastest run in milliseconds. The fastest is less noisy than the average
+/// </summary>
+template<typename Function>
+static double TimeBestOf(int runs, Function func)
+{
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+/// <summary>
+/// Checks the kernel's matrices against glm::translate * glm::rotate done the plain way, one object at a time. The SIMD
+/// paths do the same operations in the same order, so they have to be bit-identical to that. Returns how many matrices
+/// differ
+/// </summary>
+static size_t CountGlmMismatches(const TransformBatch& cubes, glm::vec3 rotationAxis, const std::vector<glm::mat4>& results)
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < cubes.Size(); ++i)
+    {
+        glm::mat4 expected = glm::translate(glm::mat4(1.0f), glm::vec3(cubes.x[i], cubes.y[i], cubes.z[i]));
+        expected = glm::rotate(expected, glm::radians(cubes.angleDegrees[i]), rotationAxis);
+        mismatches += std::memcmp(&results[i], &expected, sizeof(glm::mat4)) == 0 ? 0 : 1;
+    }
+    return mismatches;
+}
+
+int CpuBenchmarks::RunTransformBenchmark()
+{
+    const size_t cubeCounts[] = { 10000, 100000, 500000 };
+    const size_t grainSize = 4096;
+    const float time = 12.34f;
+    bool allMatched = true;
+
+    const glm::vec3 rotationAxis(1.0f, 0.3f, 0.5f);
+    TransformKernel kernel(rotationAxis);
+    std::cout << "Transform kernel: " << TransformKernel::GetInstructionSetName(kernel.GetInstructionSet()) << std::endl;
+
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t cubeCount : cubeCounts)
+    {
+        TransformBatch cubes;
+        cubes.Resize(cubeCount);
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+        for (size_t i = 0; i < cubeCount; ++i)
+        {
+            cubes.x[i] = distribution(generator);
+            cubes.y[i] = distribution(generator);
+            cubes.z[i] = distribution(generator);
+            cubes.angleDegrees[i] = 20.0f * i + (i % 3 == 0 ? time * 5.0f : 0.0f);
+        }
+
+        std::vector<glm::mat4> reference(cubeCount);
+        double singleThreaded = TimeBestOf(5, [&]() {
+            kernel.ComputeModelMatrices(cubes, 0, cubeCount, reference.data());
+        });
+        std::cout << cubeCount << " cubes, 1 thread: " << singleThreaded << " ms" << std::endl;
+
+        // every path this CPU can run has to give exactly what glm does, not just the fastest one
+        for (int set = (int)TransformKernel::InstructionSet::Scalar; set <= (int)kernel.GetInstructionSet(); ++set)
+        {
+            TransformKernel::InstructionSet instructionSet = (TransformKernel::InstructionSet)set;
+            std::vector<glm::mat4> results(cubeCount);
+            TransformKernel(rotationAxis, instructionSet).ComputeModelMatrices(cubes, 0, cubeCount, results.data());
+            size_t glmMismatches = CountGlmMismatches(cubes, rotationAxis, results);
+            allMatched = allMatched && glmMismatches == 0;
+            if (glmMismatches > 0)
+            {
+                std::cout << TransformKernel::GetInstructionSetName(instructionSet) << ": " << glmMismatches << " matrices DIFFER FROM GLM" << std::endl;
+            }
+        }
+
+        // the thread that calls Wait also runs jobs, so N workers means N + 1 threads doing the work
+        for (unsigned int threads = 2; threads <= hardwareThreads; threads *= 2)
+        {
+            JobSystem jobSystem(threads - 1);
+            std::vector<glm::mat4> results(cubeCount);
+            double multiThreaded = TimeBestOf(5, [&]() {
+                jobSystem.ParallelFor(cubeCount, grainSize, [&](size_t begin, size_t end) {
+                    kernel.ComputeModelMatrices(cubes, begin, end - begin, results.data());
+                });
+            });
+
+            bool matched = std::memcmp(results.data(), reference.data(), cubeCount * sizeof(glm::mat4)) == 0;
+            allMatched = allMatched && matched;
+            std::cout << cubeCount << " cubes, " << threads << " threads: " << multiThreaded << " ms, "
+                << singleThreaded / multiThreaded << "x speedup" << (matched ? "" : " RESULTS DIFFER") << std::endl;
+        }
+    }
+
+    std::cout << (allMatched ? "All results matched" : "ERROR: some results did not match") << std::endl;
+    return allMatched ? 0 : 1;
+}
+
+/// <summary>
+/// Brute force culls every box with Frustum::IntersectsAABB, the same test the BVH's nodes and leaves use, and checks
+/// that Frustum::CullAABBs (the SSE path, which bruteForceResult came from) and the BVH found exactly the same boxes.
+/// Both paths add the plane distance up in the same order, so even a box sitting exactly on a plane has to agree. The
+/// BVH result comes back in tree order, so it gets sorted first
+/// </summary>
+static bool MatchesBruteForce(std::vector<uint32_t> bvhResult, const std::vector<uint32_t>& bruteForceResult, const Frustum& frustum, const std::vector<AABB>& bounds)
+{
+    std::vector<uint32_t> scalarResult;
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        if (frustum.IntersectsAABB(bounds[i].min, bounds[i].max))
+        {
+            scalarResult.push_back((uint32_t)i);
+        }
+    }
+    std::sort(bvhResult.begin(), bvhResult.end());
+    return bruteForceResult == scalarResult && bvhResult == scalarResult;
+}
+
+/// <summary>
+/// Same as the scalar half of MatchesBruteForce, for Frustum::CullSpheres against Frustum::IntersectsSphere, using the
+/// spheres that just enclose the boxes
+/// </summary>
+static bool SphereCullingMatches(const Frustum& frustum, const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, float radius)
+{
+    std::vector<uint32_t> simdResult(x.size());
+    simdResult.resize(frustum.CullSpheres(x.data(), y.data(), z.data(), radius, 0, x.size(), simdResult.data()));
+    std::vector<uint32_t> scalarResult;
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        if (frustum.IntersectsSphere(glm::vec3(x[i], y[i], z[i]), radius))
+        {
+            scalarResult.push_back((uint32_t)i);
+        }
+    }
+    return simdResult == scalarResult;
+}
+
+int CpuBenchmarks::RunBvhBenchmark()
+{
+    const size_t objectCounts[] = { 10000, 100000, 1000000 };
+    bool allMatched = true;
+
+    // the same camera CoordinateSystems starts with
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    Frustum frustum(projection * view);
+
+    for (size_t objectCount : objectCounts)
+    {
+        // same density as the cube field in CoordinateSystems
+        float halfExtent = 1.5f * std::cbrt((float)objectCount);
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> distribution(-halfExtent, halfExtent);
+        std::vector<AABB> bounds(objectCount);
+        std::vector<float> minX(objectCount), minY(objectCount), minZ(objectCount), maxX(objectCount), maxY(objectCount), maxZ(objectCount);
+        auto setBounds = [&](size_t i, const glm::vec3& center) {
+            bounds[i].min = center - glm::vec3(0.5f, 0.5f, 0.5f);
+            bounds[i].max = center + glm::vec3(0.5f, 0.5f, 0.5f);
+            minX[i] = bounds[i].min.x; minY[i] = bounds[i].min.y; minZ[i] = bounds[i].min.z;
+            maxX[i] = bounds[i].max.x; maxY[i] = bounds[i].max.y; maxZ[i] = bounds[i].max.z;
+        };
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            float x = distribution(generator);
+            float y = distribution(generator);
+            float z = distribution(generator);
+            setBounds(i, glm::vec3(x, y, z));
+        }
+
+        BoundingVolumeHierarchy bvh;
+        double buildTime = TimeBestOf(3, [&]() { bvh.Build(bounds); });
+
+        std::vector<uint32_t> bruteForce(objectCount);
+        size_t bruteForceCount = 0;
+        double bruteForceTime = TimeBestOf(5, [&]() {
+            bruteForceCount = frustum.CullAABBs(minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), 0, objectCount, bruteForce.data());
+        });
+        bruteForce.resize(bruteForceCount);
+
+        std::vector<uint32_t> visible;
+        visible.reserve(objectCount);
+        double queryTime = TimeBestOf(5, [&]() {
+            visible.clear();
+            bvh.QueryFrustum(frustum, visible);
+        });
+        bool matched = MatchesBruteForce(visible, bruteForce, frustum, bounds);
+
+        std::vector<float> centerX(objectCount), centerY(objectCount), centerZ(objectCount);
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            centerX[i] = bounds[i].Center().x; centerY[i] = bounds[i].Center().y; centerZ[i] = bounds[i].Center().z;
+        }
+        matched = matched && SphereCullingMatches(frustum, centerX, centerY, centerZ, std::sqrt(0.75f));
+
+        // move a third of the objects a little, like they would in an animated scene
+        std::uniform_real_distribution<float> nudge(-1.0f, 1.0f);
+        for (size_t i = 0; i < objectCount; i += 3)
+        {
+            glm::vec3 center = bounds[i].Center() + glm::vec3(nudge(generator), nudge(generator), nudge(generator));
+            setBounds(i, center);
+        }
+        auto refitStart = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < objectCount; i += 3)
+        {
+            bvh.UpdateObject((uint32_t)i, bounds[i]);
+        }
+        bvh.Refit();
+        std::chrono::duration<double, std::milli> refitTime = std::chrono::high_resolution_clock::now() - refitStart;
+
+        bruteForce.resize(objectCount);
+        bruteForce.resize(frustum.CullAABBs(minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), 0, objectCount, bruteForce.data()));
+        visible.clear();
+        double refittedQueryTime = TimeBestOf(5, [&]() {
+            visible.clear();
+            bvh.QueryFrustum(frustum, visible);
+        });
+        matched = matched && MatchesBruteForce(visible, bruteForce, frustum, bounds);
+        allMatched = allMatched && matched;
+
+        std::cout << objectCount << " objects, " << bvh.GetNodeCount() << " nodes, " << bruteForce.size() << " visible" << (matched ? "" : " RESULTS DIFFER") << std::endl;
+        std::cout << "  build: " << buildTime << " ms" << std::endl;
+        std::cout << "  query: " << queryTime << " ms (brute force: " << bruteForceTime << " ms)" << std::endl;
+        std::cout << "  refit after moving 1/3 of the objects: " << refitTime.count() << " ms, query after refit: " << refittedQueryTime << " ms" << std::endl;
+    }
+
+    std::cout << (allMatched ? "All results matched" : "ERROR: some results did not match") << std::endl;
+    return allMatched ? 0 : 1;
+}
+
+int CpuBenchmarks::RunRingAllocatorCheck()
+{
+    const size_t capacity = 64 * 1024;
+    const uint64_t frameCount = 5000;
+    // frame n's fence has passed once frame n + gpuLatency starts
+    const uint64_t gpuLatency = 2;
+    const size_t alignments[] = { 1, 4, 16, 256 };
+
+    RingAllocator ring(capacity);
+    std::mt19937 random(7);
+    std::uniform_int_distribution<size_t> sizeDistribution(1, 4000);
+    std::uniform_int_distribution<int> alignmentDistribution(0, 3);
+    std::uniform_int_distribution<int> allocationCountDistribution(0, 16);
+
+    // which bytes are handed out and not released yet, and the allocations in each submitted region
+    struct Range
+    {
+        size_t offset;
+        size_t size;
+    };
+    std::vector<unsigned char> inUse(capacity, 0);
+    std::deque<std::vector<Range>> submitted;
+    std::vector<Range> current;
+    bool passed = true;
+    uint64_t waits = 0;
+    size_t allocations = 0;
+
+    auto fail = [&](const char* message, uint64_t frame) {
+        if (passed)
+        {
+            std::cout << "ERROR: frame " << frame << ": " << message << std::endl;
+        }
+        passed = false;
+    };
+    auto releaseOldest = [&]() {
+        for (const Range& range : submitted.front())
+        {
+            std::memset(&inUse[range.offset], 0, range.size);
+        }
+        submitted.pop_front();
+        ring.ReleaseOldest();
+    };
+
+    for (uint64_t frame = 0; frame < frameCount && passed; ++frame)
+    {
+        while (ring.HasSubmittedRegions() && ring.GetOldestFence() + gpuLatency <= frame)
+        {
+            releaseOldest();
+        }
+
+        int allocationCount = allocationCountDistribution(random);
+        for (int i = 0; i < allocationCount; ++i)
+        {
+            size_t size = sizeDistribution(random);
+            size_t alignment = alignments[alignmentDistribution(random)];
+            size_t offset = ring.Allocate(size, alignment);
+            while (offset == RingAllocator::InvalidOffset)
+            {
+                // what StreamingRingBuffer does when it's full: wait for the oldest fence, fencing this frame's
+                // allocations first if there's nothing older
+                if (!ring.HasSubmittedRegions())
+                {
+                    ring.Submit(frame);
+                    submitted.push_back(current);
+                    current.clear();
+                }
+                waits++;
+                releaseOldest();
+                offset = ring.Allocate(size, alignment);
+            }
+
+            if (offset % alignment != 0)
+            {
+                fail("misaligned allocation", frame);
+            }
+            if (offset + size > capacity)
+            {
+                fail("allocation runs off the end of the buffer", frame);
+                break;
+            }
+            for (size_t b = offset; b < offset + size; ++b)
+            {
+                if (inUse[b])
+                {
+                    fail("allocation overlaps one that hasn't been released", frame);
+                    break;
+                }
+                inUse[b] = 1;
+            }
+            current.push_back(Range{ offset, size });
+            allocations++;
+        }
+
+        if (ring.GetUnsubmittedBytes() > 0)
+        {
+            ring.Submit(frame);
+            submitted.push_back(current);
+        }
+        else if (!current.empty())
+        {
+            fail("allocations made but nothing to submit", frame);
+        }
+        current.clear();
+
+        if (ring.GetUsedBytes() > capacity)
+        {
+            fail("more bytes in use than the buffer holds", frame);
+        }
+    }
+
+    if (ring.Allocate(capacity + 1) != RingAllocator::InvalidOffset)
+    {
+        fail("an allocation bigger than the buffer succeeded", frameCount);
+    }
+    if (ring.GetWrapCount() == 0)
+    {
+        fail("the ring never wrapped", frameCount);
+    }
+    while (ring.HasSubmittedRegions())
+    {
+        releaseOldest();
+    }
+    if (ring.GetUsedBytes() != 0)
+    {
+        fail("bytes still in use after releasing every region", frameCount);
+    }
+    // with everything released, the whole buffer has to be available again
+    if (ring.Allocate(capacity) != 0)
+    {
+        fail("couldn't allocate the whole buffer after releasing everything", frameCount);
+    }
+
+    std::cout << allocations << " allocations over " << frameCount << " frames, wrapped " << ring.GetWrapCount()
+        << " times, waited on the oldest fence " << waits << " times" << std::endl;
+    std::cout << (passed ? "All ring allocator checks passed" : "ERROR: a ring allocator check failed") << std::endl;
+    return passed ? 0 : 1;
+}
+
+int CpuBenchmarks::RunRenderQueueSortBenchmark()
+{
+    std::mt19937 random(11);
+    std::uniform_int_distribution<GLuint> nameDistribution(1, 8);
+    std::uniform_real_distribution<float> depthDistribution(0.0f, 1.0f);
+    bool allMatched = true;
+
+    for (size_t commandCount : { (size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000 })
+    {
+        std::vector<RenderQueue::SortEntry> keys(commandCount);
+        for (size_t i = 0; i < commandCount; ++i)
+        {
+            GLuint textures[RenderQueue::MaxTextures] = { nameDistribution(random), nameDistribution(random) };
+            uint64_t key = RenderQueue::MakeKey(nameDistribution(random), textures, RenderQueue::MaxTextures, nameDistribution(random), depthDistribution(random));
+            keys[i] = RenderQueue::SortEntry{ key, (uint32_t)i };
+        }
+
+        // both sorts start from the same unsorted keys every run
+        std::vector<RenderQueue::SortEntry> radixSorted;
+        std::vector<RenderQueue::SortEntry> scratch;
+        double radixTime = TimeBestOf(5, [&]() {
+            radixSorted = keys;
+            RenderQueue::RadixSort(radixSorted, scratch);
+        });
+        std::vector<RenderQueue::SortEntry> stdSorted;
+        double stdTime = TimeBestOf(5, [&]() {
+            stdSorted = keys;
+            std::stable_sort(stdSorted.begin(), stdSorted.end(),
+                [](const RenderQueue::SortEntry& a, const RenderQueue::SortEntry& b) { return a.key < b.key; });
+        });
+
+        bool matched = true;
+        for (size_t i = 0; i < commandCount; ++i)
+        {
+            if (radixSorted[i].key != stdSorted[i].key || radixSorted[i].index != stdSorted[i].index)
+            {
+                matched = false;
+                break;
+            }
+        }
+        allMatched = allMatched && matched;
+
+        std::cout << commandCount << " commands: radix sort " << radixTime << " ms, std::stable_sort " << stdTime << " ms"
+            << (matched ? "" : " RESULTS DIFFER") << std::endl;
+    }
+
+    std::cout << (allMatched ? "All results matched" : "ERROR: some results did not match") << std::endl;
+    return allMatched ? 0 : 1;
+}
+
+/// <summary>
+/// The vertex data of each triangle of a mesh, rotated so each triangle starts at its smallest vertex (which keeps
+/// the winding), and then sorted, so two meshes with the same triangles in any order give the same list
+/// </summary>
+static std::vector<std::vector<float>> GetSortedTriangles(const std::vector<float>& vertices, const std::vector<uint32_t>& indices, size_t floatsPerVertex)
+{
+    std::vector<std::vector<float>> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+        std::vector<float> corners[3];
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const float* vertex = &vertices[indices[t * 3 + corner] * floatsPerVertex];
+            corners[corner].assign(vertex, vertex + floatsPerVertex);
+        }
+        int first = (int)(std::min_element(corners, corners + 3) - corners);
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const std::vector<float>& vertex = corners[(first + corner) % 3];
+            triangles[t].insert(triangles[t].end(), vertex.begin(), vertex.end());
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int CpuBenchmarks::RunMeshProcessingBenchmark()
+{
+    const size_t floatsPerVertex = 5; // position and texture coordinates, like the cube
+    std::mt19937 random(19);
+    bool allMatched = true;
+
+    for (size_t gridSize : { (size_t)16, (size_t)128, (size_t)512 })
+    {
+        // two triangles per quad, every corner written out in full, then the triangles shuffled so the input has
+        // none of the locality a grid would have if it were built row by row
+        std::vector<std::vector<float>> soupTriangles;
+        soupTriangles.reserve(gridSize * gridSize * 2);
+        auto corner = [&](size_t x, size_t y, std::vector<float>& triangle) {
+            float u = (float)x / gridSize;
+            float v = (float)y / gridSize;
+            triangle.insert(triangle.end(), { u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f, u, v });
+        };
+        for (size_t y = 0; y < gridSize; ++y)
+        {
+            for (size_t x = 0; x < gridSize; ++x)
+            {
+                std::vector<float> lower;
+                corner(x, y, lower);
+                corner(x + 1, y, lower);
+                corner(x + 1, y + 1, lower);
+                std::vector<float> upper;
+                corner(x + 1, y + 1, upper);
+                corner(x, y + 1, upper);
+                corner(x, y, upper);
+                soupTriangles.push_back(lower);
+                soupTriangles.push_back(upper);
+            }
+        }
+        std::shuffle(soupTriangles.begin(), soupTriangles.end(), random);
+        std::vector<float> soup;
+        soup.reserve(soupTriangles.size() * 3 * floatsPerVertex);
+        for (const std::vector<float>& triangle : soupTriangles)
+        {
+            soup.insert(soup.end(), triangle.begin(), triangle.end());
+        }
+        size_t soupVertexCount = soup.size() / floatsPerVertex;
+
+        IndexedMesh mesh;
+        double deduplicateTime = TimeBestOf(1, [&]() { mesh = MeshProcessing::Deduplicate(soup.data(), soupVertexCount, floatsPerVertex); });
+        MeshProcessing::CacheStats before = MeshProcessing::AnalyzeVertexCache(mesh.indices, mesh.VertexCount());
+        double cacheTime = TimeBestOf(1, [&]() { MeshProcessing::OptimizeVertexCache(mesh.indices, mesh.VertexCount()); });
+        double fetchTime = TimeBestOf(1, [&]() { MeshProcessing::OptimizeVertexFetch(mesh); });
+        MeshProcessing::CacheStats after = MeshProcessing::AnalyzeVertexCache(mesh.indices, mesh.VertexCount());
+
+        bool matched = mesh.VertexCount() == (gridSize + 1) * (gridSize + 1) && mesh.indices.size() == soupVertexCount;
+        for (uint32_t index : mesh.indices)
+        {
+            matched = matched && index < mesh.VertexCount();
+        }
+        if (matched)
+        {
+            std::vector<uint32_t> soupIndices(soupVertexCount);
+            for (size_t i = 0; i < soupVertexCount; ++i)
+            {
+                soupIndices[i] = (uint32_t)i;
+            }
+            matched = GetSortedTriangles(soup, soupIndices, floatsPerVertex) == GetSortedTriangles(mesh.vertices, mesh.indices, floatsPerVertex);
+        }
+        allMatched = allMatched && matched;
+
+        std::cout << gridSize << "x" << gridSize << " grid, " << mesh.TriangleCount() << " triangles, " << soupVertexCount << " -> "
+            << mesh.VertexCount() << " vertices: deduplicate " << deduplicateTime << " ms, vertex cache " << cacheTime
+            << " ms, vertex fetch " << fetchTime << " ms. ACMR " << before.acmr << " -> " << after.acmr << ", ATVR "
+            << before.atvr << " -> " << after.atvr << (matched ? "" : " TRIANGLES DIFFER") << std::endl;
+    }
+
+    std::cout << (allMatched ? "All meshes kept their triangles" : "ERROR: some meshes lost or changed triangles") << std::endl;
+    return allMatched ? 0 : 1;
+}
+
+int CpuBenchmarks::RunVertexQuantizationCheck()
+{
+    bool allPassed = true;
+
+    // every half that isn't a NaN has to come back as exactly the same bits
+    int halfMismatches = 0;
+    for (uint32_t half = 0; half <= 0xFFFF; ++half)
+    {
+        bool isNaN = (half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0;
+        if (!isNaN && VertexBufferLayout::FloatToHalf(VertexBufferLayout::HalfToFloat((uint16_t)half)) != half)
+        {
+            halfMismatches++;
+        }
+    }
+    allPassed = allPassed && halfMismatches == 0;
+    std::cout << "Half float round trips: " << (halfMismatches == 0 ? "all matched" : "SOME DIFFER") << std::endl;
+
+    const size_t vertexCount = 1000000;
+    const int floatsPerVertex = 3 + 3 + 2 + 4;
+    std::mt19937 random(20);
+    std::uniform_real_distribution<float> positionDistribution(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unitDistribution(0.0f, 1.0f);
+    std::normal_distribution<float> normalDistribution;
+    std::vector<float> vertices(vertexCount * floatsPerVertex);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        float* vertex = &vertices[v * floatsPerVertex];
+        glm::vec3 normal = glm::normalize(glm::vec3(normalDistribution(random), normalDistribution(random), normalDistribution(random)));
+        float values[floatsPerVertex] = {
+            positionDistribution(random), positionDistribution(random), positionDistribution(random),
+            normal.x, normal.y, normal.z,
+            unitDistribution(random), unitDistribution(random),
+            unitDistribution(random), unitDistribution(random), unitDistribution(random), unitDistribution(random) };
+        memcpy(vertex, values, sizeof(values));
+    }
+
+    VertexBufferLayout floatLayout(std::vector<int>{ 3, 3, 2, 4 });
+    VertexBufferLayout quantizedLayout(std::vector<VertexBufferLayout::Attribute>{
+        VertexBufferLayout::Attribute::HalfFloat(3), VertexBufferLayout::Attribute::PackedNormal(),
+        VertexBufferLayout::Attribute::UnsignedShortNormalized(2), VertexBufferLayout::Attribute::UnsignedByteNormalized(4) });
+    std::vector<unsigned char> quantized;
+    double quantizeTime = TimeBestOf(3, [&]() { quantized = quantizedLayout.Quantize(vertices.data(), vertexCount, VertexBufferLayout::SignedNormalization::Gl42AndLater); });
+    // the normals again, for a context before 4.2, which decodes them differently (see VertexBufferLayout::SignedNormalization)
+    std::vector<unsigned char> quantizedBeforeGl42 = quantizedLayout.Quantize(vertices.data(), vertexCount, VertexBufferLayout::SignedNormalization::BeforeGl42);
+
+    // the worst error seen for each kind of attribute, relative to the format's precision, so anything over 1 is wrong
+    float positionError = 0.0f, normalError = 0.0f, normalErrorBeforeGl42 = 0.0f, texCoordError = 0.0f, colorError = 0.0f;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float* vertex = &vertices[v * floatsPerVertex];
+        const unsigned char* encoded = &quantized[v * quantizedLayout.GetStride()];
+        uint16_t halves[3];
+        uint32_t packed, packedBeforeGl42;
+        uint16_t texCoords[2];
+        memcpy(halves, encoded, sizeof(halves));
+        memcpy(&packed, encoded + 8, sizeof(packed));
+        memcpy(&packedBeforeGl42, &quantizedBeforeGl42[v * quantizedLayout.GetStride()] + 8, sizeof(packedBeforeGl42));
+        memcpy(texCoords, encoded + 12, sizeof(texCoords));
+        const unsigned char* color = encoded + 16;
+        for (int c = 0; c < 3; ++c)
+        {
+            // a half has 11 significant bits, so rounding is off by at most half of the last one
+            float position = VertexBufferLayout::HalfToFloat(halves[c]);
+            positionError = std::max(positionError, std::fabs(position - vertex[c]) / (std::fabs(vertex[c]) * std::ldexp(1.0f, -11)));
+            // sign extend the 10 bits, then decode the way 4.2 does, c / 511, and the way earlier versions do, (2c + 1) / 1023.
+            // A step is 1 / 511 for the first and 2 / 1023 for the second
+            int32_t component = (int32_t)(packed << (22 - c * 10)) >> 22;
+            normalError = std::max(normalError, (float)(std::fabs(std::max(component / 511.0, -1.0) - vertex[3 + c]) * 2.0 * 511.0));
+            int32_t componentBeforeGl42 = (int32_t)(packedBeforeGl42 << (22 - c * 10)) >> 22;
+            normalErrorBeforeGl42 = std::max(normalErrorBeforeGl42, (float)(std::fabs((2.0 * componentBeforeGl42 + 1.0) / 1023.0 - vertex[3 + c]) * 1023.0));
+        }
+        for (int c = 0; c < 2; ++c)
+        {
+            texCoordError = std::max(texCoordError, (float)(std::fabs(texCoords[c] / 65535.0 - vertex[6 + c]) * 2.0 * 65535.0));
+        }
+        for (int c = 0; c < 4; ++c)
+        {
+            colorError = std::max(colorError, (float)(std::fabs(color[c] / 255.0 - vertex[8 + c]) * 2.0 * 255.0));
+        }
+    }
+    // a little slack for rounding in the check itself
+    const float tolerance = 1.0001f;
+    bool withinPrecision = positionError <= tolerance && normalError <= tolerance && normalErrorBeforeGl42 <= tolerance
+        && texCoordError <= tolerance && colorError <= tolerance;
+    allPassed = allPassed && withinPrecision;
+
+    size_t floatBytes = vertexCount * floatLayout.GetStride();
+    std::cout << vertexCount << " vertices: " << floatLayout.GetStride() << " -> " << quantizedLayout.GetStride() << " bytes each, "
+        << floatBytes / (1024 * 1024) << " -> " << quantized.size() / (1024 * 1024) << " MB ("
+        << 100 - quantized.size() * 100 / floatBytes << "% smaller), quantized in " << quantizeTime << " ms" << std::endl;
+    std::cout << "Worst error as a fraction of the format's precision: position " << positionError << ", normal " << normalError
+        << " (" << normalErrorBeforeGl42 << " before GL 4.2), texture coordinate " << texCoordError << ", color " << colorError << (withinPrecision ? "" : " TOO BIG") << std::endl;
+
+    std::cout << (allPassed ? "All values within precision" : "ERROR: some values were quantized wrong") << std::endl;
+    return allPassed ? 0 : 1;
+}
+
+int CpuBenchmarks::RunFreeListAllocatorCheck()
+{
+    const size_t capacity = 1 << 20;
+    const int operationCount = 200000;
+
+    FreeListAllocator allocator(capacity);
+    std::mt19937 random(23);
+    // mostly small meshes with the odd big one, like a scene's worth of props and a few buildings
+    std::uniform_int_distribution<size_t> smallSize(1, 2000);
+    std::uniform_int_distribution<size_t> bigSize(2000, 40000);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    // which units are handed out, and the live allocations in no particular order
+    std::vector<unsigned char> inUse(capacity, 0);
+    std::vector<size_t> live;
+    bool passed = true;
+    size_t allocations = 0, failedAllocations = 0;
+    float worstFragmentation = 0.0f;
+
+    auto fail = [&](const char* message, int operation) {
+        if (passed)
+        {
+            std::cout << "ERROR: operation " << operation << ": " << message << std::endl;
+        }
+        passed = false;
+    };
+    auto freeAt = [&](size_t index) {
+        size_t offset = live[index];
+        std::memset(&inUse[offset], 0, allocator.GetSize(offset));
+        allocator.Free(offset);
+        live[index] = live.back();
+        live.pop_back();
+    };
+
+    for (int operation = 0; operation < operationCount && passed; ++operation)
+    {
+        // allocate a bit more often than free while there's room, so it fills up and has to fail some
+        if (live.empty() || percent(random) < 55)
+        {
+            size_t size = percent(random) < 5 ? bigSize(random) : smallSize(random);
+            size_t offset = allocator.Allocate(size);
+            if (offset == FreeListAllocator::InvalidOffset)
+            {
+                failedAllocations++;
+                continue;
+            }
+            if (offset + size > capacity)
+            {
+                fail("allocation runs off the end", operation);
+                break;
+            }
+            for (size_t u = offset; u < offset + size; ++u)
+            {
+                if (inUse[u])
+                {
+                    fail("allocation overlaps a live one", operation);
+                    break;
+                }
+                inUse[u] = 1;
+            }
+            live.push_back(offset);
+            allocations++;
+        }
+        else
+        {
+            freeAt(std::uniform_int_distribution<size_t>(0, live.size() - 1)(random));
+        }
+
+        if (operation % 1000 == 0)
+        {
+            FreeListAllocator::Stats stats = allocator.GetStats();
+            worstFragmentation = std::max(worstFragmentation, stats.fragmentation);
+            if (stats.allocationCount != live.size())
+            {
+                fail("allocation count doesn't match", operation);
+            }
+        }
+    }
+
+    FreeListAllocator::Stats before = allocator.GetStats();
+    std::cout << allocations << " allocations (" << failedAllocations << " didn't fit) over " << operationCount
+        << " operations, worst fragmentation " << 100.0f * worstFragmentation << "%" << std::endl;
+    std::cout << "Before compacting: " << before.used << "/" << before.capacity << " used by " << before.allocationCount
+        << " allocations, " << before.freeRangeCount << " free ranges, the largest " << before.largestFreeRange
+        << ", fragmentation " << 100.0f * before.fragmentation << "%" << std::endl;
+
+    // compacting has to pack the same allocations at the start, and moving them in the order given has to be safe
+    std::vector<size_t> sizesByOffset;
+    std::vector<size_t> sorted(live);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t offset : sorted)
+    {
+        sizesByOffset.push_back(allocator.GetSize(offset));
+    }
+    std::vector<FreeListAllocator::Move> moves = allocator.Compact();
+    for (size_t i = 1; i < moves.size(); ++i)
+    {
+        if (moves[i].from <= moves[i - 1].from)
+        {
+            fail("moves aren't in ascending order", operationCount);
+        }
+    }
+    for (const FreeListAllocator::Move& move : moves)
+    {
+        if (move.to > move.from)
+        {
+            fail("compacting moved an allocation up", operationCount);
+        }
+    }
+    size_t expectedOffset = 0;
+    for (size_t size : sizesByOffset)
+    {
+        if (allocator.GetSize(expectedOffset) != size)
+        {
+            fail("allocations aren't packed together in order after compacting", operationCount);
+            break;
+        }
+        expectedOffset += size;
+    }
+    FreeListAllocator::Stats after = allocator.GetStats();
+    if (after.freeRangeCount > 1 || after.fragmentation != 0.0f || after.largestFreeRange != capacity - before.used)
+    {
+        fail("free space isn't one range after compacting", operationCount);
+    }
+    std::cout << "After compacting: " << moves.size() << " allocations moved, " << after.freeRangeCount
+        << " free range of " << after.largestFreeRange << std::endl;
+
+    // freeing everything has to merge it all back into the one range
+    std::vector<size_t> offsets;
+    for (size_t i = 0, offset = 0; i < sizesByOffset.size(); offset += sizesByOffset[i++])
+    {
+        offsets.push_back(offset);
+    }
+    std::shuffle(offsets.begin(), offsets.end(), random);
+    for (size_t offset : offsets)
+    {
+        allocator.Free(offset);
+    }
+    FreeListAllocator::Stats empty = allocator.GetStats();
+    if (empty.used != 0 || empty.freeRangeCount != 1 || empty.largestFreeRange != capacity)
+    {
+        fail("freeing everything didn't merge it back into one range", operationCount);
+    }
+    if (allocator.Allocate(capacity) != 0 || allocator.Allocate(1) != FreeListAllocator::InvalidOffset)
+    {
+        fail("couldn't allocate exactly the whole space after freeing everything", operationCount);
+    }
+
+    std::cout << (passed ? "All free list allocator checks passed" : "ERROR: a free list allocator check failed") << std::endl;
+    return passed ? 0 : 1;
+}
+
+/// <summary>
+/// For the checks that need a GL context: makes a window that's never shown with a core context of the given version,
+/// makes it current and loads GL. Returns NULL (having said why) if that didn't work, with GLFW already terminated
+/// </summary>
+static GLFWwindow* CreateHiddenContext(int major, int minor, const char* title)
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, title, NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "ERROR: couldn't create a window for a GL " << major << "." << minor << " context" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "ERROR: couldn't load GL" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+    GLStateCache::Invalidate();
+    return window;
+}
+
+// the real glGetUniformLocation, and how many times it's been called through the counting one below
+static PFNGLGETUNIFORMLOCATIONPROC s_driverGetUniformLocation = nullptr;
+static size_t s_getUniformLocationCalls = 0;
+
+static GLint APIENTRY CountingGetUniformLocation(GLuint program, const GLchar* name)
+{
+    s_getUniformLocationCalls++;
+    return s_driverGetUniformLocation(program, name);
+}
+
+int CpuBenchmarks::RunUniformLookupCheck()
+{
+    if (CreateHiddenContext(3, 3, "Uniform lookup check") == NULL)
+    {
+        return 1;
+    }
+
+    // count every call that reaches the driver, whoever makes it, by swapping glad's function pointer for ours
+    s_driverGetUniformLocation = glad_glGetUniformLocation;
+    s_getUniformLocationCalls = 0;
+    glad_glGetUniformLocation = CountingGetUniformLocation;
+    bool passed = true;
+    {
+        // the non-instanced cube program, which has the per-cube "model" matrix the frame loop used to look up by name
+        Shader shader("vertex_textured_coordinate_system.glsl", "fragment_textured.glsl");
+        size_t linkCalls = s_getUniformLocationCalls;
+
+        size_t callsBefore = s_getUniformLocationCalls;
+        UniformHandle model = shader.getUniformHandle("model", GL_FLOAT_MAT4);
+        UniformHandle texture1 = shader.getUniformHandle("texture1");
+        UniformHandle texture2 = shader.getUniformHandle("texture2");
+        size_t handleCalls = s_getUniformLocationCalls - callsBefore;
+        bool handlesValid = model.isValid() && texture1.isValid() && texture2.isValid();
+
+        // a few frames' worth of what CoordinateSystems does per cube, through handles and through the string API
+        const int frameCount = 100;
+        const int cubesPerFrame = 1000;
+        glm::mat4 matrix(1.0f);
+        shader.use();
+        callsBefore = s_getUniformLocationCalls;
+        size_t lookupCountBefore = Shader::getUniformLocationLookupCount();
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            shader.setInt(texture1, 0);
+            shader.setInt(texture2, 1);
+            for (int cube = 0; cube < cubesPerFrame; ++cube)
+            {
+                shader.setMat4(model, &matrix[0][0]);
+            }
+            shader.setMat4("model", &matrix[0][0]);
+        }
+        size_t frameCalls = s_getUniformLocationCalls - callsBefore;
+        size_t frameLookups = Shader::getUniformLocationLookupCount() - lookupCountBefore;
+
+        // a name the program doesn't have is asked about once, and then remembered as missing
+        callsBefore = s_getUniformLocationCalls;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            shader.setFloat("notInTheShader", 1.0f);
+        }
+        size_t missingCalls = s_getUniformLocationCalls - callsBefore;
+
+        std::cout << "glGetUniformLocation calls: " << linkCalls << " while linking, " << handleCalls << " resolving handles, "
+            << frameCalls << " over " << frameCount << " frames of " << cubesPerFrame << " cubes, " << missingCalls
+            << " for a missing name set " << frameCount << " times" << std::endl;
+        passed = handlesValid && handleCalls == 0 && frameCalls == 0 && frameLookups == 0 && missingCalls == 1
+            && glGetError() == GL_NO_ERROR;
+        if (!handlesValid)
+        {
+            std::cout << "ERROR: the program's uniforms weren't all found" << std::endl;
+        }
+    }
+    glad_glGetUniformLocation = s_driverGetUniformLocation;
+    Shader::deletePlaceholder();
+    glfwTerminate();
+
+    std::cout << (passed ? "No driver lookups on the frame path" : "ERROR: unexpected glGetUniformLocation calls") << std::endl;
+    return passed ? 0 : 1;
+}
+
+int CpuBenchmarks::RunGpuCullingCheck()
+{
+    if (CreateHiddenContext(4, 3, "GPU culling check") == NULL)
+    {
+        return 1;
+    }
+    if (!GpuCulling::IsSupported())
+    {
+        std::cout << "ERROR: GPU culling needs GL 4.3" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    // a field like CoordinateSystems makes, one cube per 3x3x3 block of space
+    const size_t cubeCount = 100000;
+    const float boundingRadius = 0.8660254f;
+    float halfExtent = 1.5f * std::cbrt((float)cubeCount);
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> distribution(-halfExtent, halfExtent);
+    TransformBatch cubes;
+    cubes.Resize(cubeCount);
+    for (size_t i = 0; i < cubeCount; ++i)
+    {
+        cubes.x[i] = distribution(generator);
+        cubes.y[i] = distribution(generator);
+        cubes.z[i] = distribution(generator);
+        cubes.angleDegrees[i] = 20.0f * i;
+    }
+    std::vector<float> spinDegreesPerSecond(cubeCount, 0.0f);
+
+    // the camera CoordinateSystems starts with, then looking along each axis from inside and from outside the field
+    struct Camera
+    {
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    const Camera cameras[] = {
+        { glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f) },
+        { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) },
+        { glm::vec3(10.0f, -5.0f, 20.0f), glm::vec3(-30.0f, 10.0f, 0.0f) },
+        { glm::vec3(0.0f, 0.0f, -2.0f * halfExtent), glm::vec3(0.0f, 0.0f, 0.0f) },
+        { glm::vec3(2.0f * halfExtent, 2.0f * halfExtent, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f) },
+    };
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+    bool passed = true;
+    {
+        GpuCulling gpuCulling;
+        gpuCulling.Create(cubes, spinDegreesPerSecond, boundingRadius, glm::vec3(1.0f, 0.3f, 0.5f), 36, 0, 0);
+        std::vector<uint32_t> cpuVisible(cubeCount);
+        std::vector<DrawElementsIndirectCommand> commands;
+        for (const Camera& camera : cameras)
+        {
+            glm::mat4 view = glm::lookAt(camera.position, camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
+            Frustum frustum(projection * view);
+            gpuCulling.Cull(frustum, 0.0f);
+            gpuCulling.ReadCommands(commands);
+            GLuint gpuVisibleCount = gpuCulling.ReadVisibleCount();
+
+            // the same test the CPU path of CoordinateSystems culls the field with
+            size_t cpuVisibleCount = frustum.CullSpheres(cubes.x.data(), cubes.y.data(), cubes.z.data(), boundingRadius, 0, cubeCount, cpuVisible.data());
+            std::vector<GLuint> expectedInstanceCounts(cubeCount, 0);
+            for (size_t i = 0; i < cpuVisibleCount; ++i)
+            {
+                expectedInstanceCounts[cpuVisible[i]] = 1;
+            }
+            size_t differences = 0;
+            for (size_t i = 0; i < cubeCount; ++i)
+            {
+                differences += commands[i].instanceCount == expectedInstanceCounts[i] ? 0 : 1;
+            }
+
+            bool matched = differences == 0 && gpuVisibleCount == cpuVisibleCount;
+            passed = passed && matched;
+            std::cout << "Camera at (" << camera.position.x << ", " << camera.position.y << ", " << camera.position.z << "): "
+                << cpuVisibleCount << " visible on the CPU, " << gpuVisibleCount << " on the GPU";
+            if (differences > 0)
+            {
+                std::cout << ", " << differences << " cubes CULLED DIFFERENTLY";
+            }
+            std::cout << std::endl;
+        }
+        passed = passed && glGetError() == GL_NO_ERROR;
+    }
+    glfwTerminate();
+
+    std::cout << (passed ? "The GPU culled exactly the cubes the CPU did" : "ERROR: the GPU and CPU culling differ") << std::endl;
+    return passed ? 0 : 1;
+}
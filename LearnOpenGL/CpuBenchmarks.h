@@ -0,0 +1,90 @@
+#pragma once
+#include <iostream>
+#include <vector>
+
+/// <summary>
+/// Benchmarks and sanity checks for the CPU side of the renderer. None of these open a window or need an OpenGL
+/// context, so they can be run on a machine without a GPU, except RunUniformLookupCheck and RunGpuCullingCheck, which
+/// make a hidden window for one (Mesa's llvmpipe will do). Pick one in ApplicationRunner::RunMain.
+/// </summary>
+class CpuBenchmarks
+{
+public:
+    /// <summary>
+    /// Computes the model matrices of a cube field the same way CoordinateSystems does, once on a single thread and
+    /// then through the job system with more and more workers. Checks that every run produces exactly the same
+    /// matrices, that every instruction set the CPU has produces exactly the matrices glm does, and prints how long
+    /// each run took.
+    /// </summary>
+    /// <returns>0 if all the results matched, 1 otherwise</returns>
+    int RunTransformBenchmark();
+
+    /// <summary>
+    /// Builds a BoundingVolumeHierarchy over 10k, 100k and 1M randomly placed boxes and times the build, frustum
+    /// queries against it, and refitting it after a third of the boxes have moved. Every query result is checked
+    /// against brute force culling of every box, which is timed too for comparison, and the SSE batch culling is
+    /// checked against the scalar tests, for boxes and for spheres.
+    /// </summary>
+    /// <returns>0 if the BVH, the SSE and the scalar culling always found exactly the same objects, 1 otherwise</returns>
+    int RunBvhBenchmark();
+
+    /// <summary>
+    /// Runs the RingAllocator behind StreamingRingBuffer through a few thousand simulated frames of randomly sized and
+    /// aligned allocations, with fake fences that pass two frames after they're submitted (like a GPU running behind).
+    /// Checks that no allocation overlaps one that hasn't been released yet, that they're all aligned and inside the
+    /// buffer, that the ring actually wraps, that oversized requests fail, and that releasing everything frees it all.
+    /// </summary>
+    /// <returns>0 if every check passed, 1 otherwise</returns>
+    int RunRingAllocatorCheck();
+
+    /// <summary>
+    /// Sorts 1k to 1M random RenderQueue keys with RenderQueue::RadixSort and with std::stable_sort, and prints how
+    /// long each took. Keys are built like real ones, from a handful of programs, textures and VAOs plus a random depth.
+    /// </summary>
+    /// <returns>0 if the radix sort always put the entries in exactly the same order as std::stable_sort, 1 otherwise</returns>
+    int RunRenderQueueSortBenchmark();
+
+    /// <summary>
+    /// Builds grids of 16x16 to 512x512 quads as triangle soup with the triangles shuffled, and runs them through
+    /// MeshProcessing: deduplicating, reordering for the vertex cache and reordering for vertex fetch, timing each step
+    /// and printing the ACMR and ATVR after deduplicating and after reordering. Checks that the result still has
+    /// exactly the input's triangles, with the same winding, and that every index is in range.
+    /// </summary>
+    /// <returns>0 if every mesh came out with the same triangles, 1 otherwise</returns>
+    int RunMeshProcessingBenchmark();
+
+    /// <summary>
+    /// Quantizes a million random position, normal, texture coordinate and color vertices with VertexBufferLayout into
+    /// half float positions, packed 10 bit normals, 16 bit texture coordinates and 8 bit colors, and decodes them again.
+    /// Checks every value came back within the precision of its format, with the normals quantized and decoded by both
+    /// the GL 4.2 rule and the earlier one, that every half float survives a round trip through float, and prints the
+    /// size of both layouts and how long quantizing took.
+    /// </summary>
+    /// <returns>0 if every value was within its format's precision, 1 otherwise</returns>
+    int RunVertexQuantizationCheck();
+
+    /// <summary>
+    /// Runs the FreeListAllocator behind GeometryPool through a couple of hundred thousand random allocations and frees
+    /// of mostly small and a few big ranges, checking none of them overlap or run off the end. Then compacts it, checking
+    /// the allocations end up packed in order with the free space in one range and the moves are safe to copy in order,
+    /// and frees everything in random order, checking it all merges back together. Prints the fragmentation on the way.
+    /// </summary>
+    /// <returns>0 if every check passed, 1 otherwise</returns>
+    int RunFreeListAllocatorCheck();
+
+    /// <summary>
+    /// Counts the glGetUniformLocation calls that reach the driver while a cube program is used the way the frame loop
+    /// uses it: a thousand model matrices a frame through handles, plus a set by name of a uniform it has and one it
+    /// doesn't. Needs a GL context, so this one does open a (hidden) window.
+    /// </summary>
+    /// <returns>0 if resolving the handles and the frames made no calls and the missing name made exactly one, 1 otherwise</returns>
+    int RunUniformLookupCheck();
+
+    /// <summary>
+    /// Culls a fixed field of 100k cubes from a handful of fixed cameras with GpuCulling's compute shader and with
+    /// Frustum::CullSpheres, the test the CPU path uses, and reads back the instanceCount of every indirect draw
+    /// command the GPU wrote. Needs GL 4.3, and opens a hidden window for it.
+    /// </summary>
+    /// <returns>0 if the GPU drew exactly the cubes the CPU found visible from every camera, 1 otherwise</returns>
+    int RunGpuCullingCheck();
+};
@@ -0,0 +1,148 @@
+"""
+Generates a header with every shader in a directory embedded as a constexpr std::string_view, so release builds don't
+need to read any shader files at startup. Runs as a pre-build step of LearnOpenGL.vcxproj:
+
+    python EmbedShaders.py <shader directory> <output header>
+
+#include "file" lines are expanded here the same way ShaderSourceLoader expands them at runtime (relative to the
+including file), and the FNV-1a hash of the expanded source is worked out here too, so the runtime gets both for free.
+Because the hash is of the exact same bytes ShaderSourceLoader would produce from the files, a program keeps its
+ProgramBinaryCache entry whether it was loaded from the files or from the embedded copy.
+
+The header is only rewritten when its contents change, so an unchanged shader doesn't cause a rebuild.
+"""
+import os
+import re
+import sys
+
+FNV_OFFSET_BASIS = 0xCBF29CE484222325
+FNV_PRIME = 0x100000001B3
+MAX_INCLUDE_DEPTH = 16
+INCLUDE_PATTERN = re.compile(rb'^[ \t]*#[ \t]*include[^"\n]*"([^"\n]*)"')
+
+
+def fnv1a(data):
+    hash = FNV_OFFSET_BASIS
+    for byte in data:
+        hash ^= byte
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return hash
+
+
+def expand(path, depth=0):
+    """Returns the file's bytes with its includes expanded, matching ShaderSourceLoader: an include line is replaced by
+    the included file, and the newline that ended the include line is kept"""
+    if depth > MAX_INCLUDE_DEPTH:
+        raise RuntimeError('includes nested too deeply (is something including itself?): ' + path)
+    with open(path, 'rb') as file:
+        text = file.read()
+
+    directory = os.path.dirname(path)
+    result = bytearray()
+    line_start = 0
+    while line_start < len(text):
+        line_end = text.find(b'\n', line_start)
+        if line_end < 0:
+            line_end = len(text)
+        match = INCLUDE_PATTERN.match(text[line_start:line_end])
+        if match:
+            result += expand(os.path.join(directory, match.group(1).decode('utf-8')), depth + 1)
+        else:
+            result += text[line_start:line_end]
+        if line_end < len(text):
+            result += b'\n'
+        line_start = line_end + 1
+    return bytes(result)
+
+
+def to_identifier(file_name):
+    return re.sub(r'[^0-9A-Za-z_]', '_', file_name)
+
+
+def to_literals(data):
+    """One C++ string literal per line of the source. Everything outside printable ASCII is written as a 3 digit octal
+    escape (those can't run into the next character like hex escapes can), so the bytes come out exactly as they are
+    in the file, line endings included"""
+    lines = []
+    current = ''
+    for byte in data:
+        char = chr(byte)
+        if char == '\\' or char == '"':
+            current += '\\' + char
+        elif char == '\n':
+            current += '\\n'
+            lines.append(current)
+            current = ''
+        elif char == '\t':
+            current += '\\t'
+        elif 32 <= byte < 127:
+            current += char
+        else:
+            current += '\\%03o' % byte
+    if current or not lines:
+        lines.append(current)
+    return '\n'.join('\t\t"' + line + '"' for line in lines)
+
+
+def generate(shader_directory):
+    names = sorted(name for name in os.listdir(shader_directory) if name.endswith('.glsl'))
+    output = [
+        '#pragma once',
+        '// Generated by EmbedShaders.py from the shader directory, don\'t edit. It\'s regenerated before every build',
+        '#include <cstddef>',
+        '#include <cstdint>',
+        '#include <string_view>',
+        '',
+        'struct EmbeddedShader',
+        '{',
+        '\tstd::string_view name;',
+        '\tstd::string_view source;',
+        '\t// FNV-1a of source, the same hash ShaderSourceLoader::Source::hash would have for these files',
+        '\tuint64_t hash;',
+        '};',
+        '',
+        'class EmbeddedShaders',
+        '{',
+        'public:',
+    ]
+    entries = []
+    for name in names:
+        source = expand(os.path.join(shader_directory, name))
+        identifier = to_identifier(name)
+        output.append('\tstatic constexpr std::string_view %s = std::string_view(' % identifier)
+        output.append(to_literals(source) + ', %d);' % len(source))
+        output.append('')
+        entries.append('\t\t{ "%s", %s, 0x%016Xull },' % (name, identifier, fnv1a(source)))
+    output.append('\tstatic constexpr EmbeddedShader All[] = {')
+    output += entries
+    output.append('\t};')
+    output.append('\tstatic constexpr size_t Count = sizeof(All) / sizeof(All[0]);')
+    output.append('};')
+    output.append('')
+    return '\n'.join(output)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('usage: EmbedShaders.py <shader directory> <output header>')
+        return 1
+    shader_directory, output_path = sys.argv[1], sys.argv[2]
+    try:
+        header = generate(shader_directory)
+    except (OSError, RuntimeError) as error:
+        print('EmbedShaders.py: error: %s' % error)
+        return 1
+
+    if os.path.exists(output_path):
+        with open(output_path, 'r', newline='') as file:
+            if file.read() == header:
+                return 0
+    os.makedirs(os.path.dirname(os.path.abspath(output_path)), exist_ok=True)
+    with open(output_path, 'w', newline='') as file:
+        file.write(header)
+    print('EmbedShaders.py: wrote ' + output_path)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
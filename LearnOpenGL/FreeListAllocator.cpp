@@ -0,0 +1,156 @@
+#include "FreeListAllocator.h"
+#include <algorithm>
+
+FreeListAllocator::FreeListAllocator(size_t capacity)
+{
+    Reset(capacity);
+}
+
+void FreeListAllocator::Reset(size_t capacity)
+{
+    m_capacity = capacity;
+    m_used = 0;
+    m_freeByOffset.clear();
+    m_freeBySize.clear();
+    m_allocations.clear();
+    if (capacity > 0)
+    {
+        AddFreeRange(0, capacity);
+    }
+}
+
+void FreeListAllocator::Grow(size_t newCapacity)
+{
+    if (newCapacity <= m_capacity)
+    {
+        return;
+    }
+    size_t oldCapacity = m_capacity;
+    m_capacity = newCapacity;
+    AddFreeRange(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t FreeListAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+    {
+        return InvalidOffset;
+    }
+    // the smallest free range that's big enough
+    auto bySize = m_freeBySize.lower_bound(size);
+    if (bySize == m_freeBySize.end())
+    {
+        return InvalidOffset;
+    }
+    size_t offset = bySize->second;
+    size_t rangeSize = bySize->first;
+    RemoveFreeRange(m_freeByOffset.find(offset));
+    if (rangeSize > size)
+    {
+        // the rest stays free. It can't touch another free range, or they'd have been merged already
+        size_t restOffset = offset + size;
+        size_t restSize = rangeSize - size;
+        m_freeByOffset.emplace(restOffset, restSize);
+        m_freeBySize.emplace(restSize, restOffset);
+    }
+    m_allocations.emplace(offset, size);
+    m_used += size;
+    return offset;
+}
+
+void FreeListAllocator::Free(size_t offset)
+{
+    auto allocation = m_allocations.find(offset);
+    if (allocation == m_allocations.end())
+    {
+        return;
+    }
+    size_t size = allocation->second;
+    m_allocations.erase(allocation);
+    m_used -= size;
+    AddFreeRange(offset, size);
+}
+
+size_t FreeListAllocator::GetSize(size_t offset) const
+{
+    auto allocation = m_allocations.find(offset);
+    return allocation == m_allocations.end() ? 0 : allocation->second;
+}
+
+void FreeListAllocator::AddFreeRange(size_t offset, size_t size)
+{
+    // merge with the free range right after this one, then the one right before
+    auto next = m_freeByOffset.lower_bound(offset);
+    if (next != m_freeByOffset.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = std::next(next);
+        RemoveFreeRange(std::prev(next));
+    }
+    if (next != m_freeByOffset.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            RemoveFreeRange(previous);
+        }
+    }
+    m_freeByOffset.emplace(offset, size);
+    m_freeBySize.emplace(size, offset);
+}
+
+void FreeListAllocator::RemoveFreeRange(std::map<size_t, size_t>::iterator range)
+{
+    auto sameSize = m_freeBySize.equal_range(range->second);
+    for (auto it = sameSize.first; it != sameSize.second; ++it)
+    {
+        if (it->second == range->first)
+        {
+            m_freeBySize.erase(it);
+            break;
+        }
+    }
+    m_freeByOffset.erase(range);
+}
+
+std::vector<FreeListAllocator::Move> FreeListAllocator::Compact()
+{
+    std::vector<std::pair<size_t, size_t>> allocations(m_allocations.begin(), m_allocations.end());
+    std::sort(allocations.begin(), allocations.end());
+
+    std::vector<Move> moves;
+    m_allocations.clear();
+    size_t next = 0;
+    for (const auto& allocation : allocations)
+    {
+        if (allocation.first != next)
+        {
+            moves.push_back(Move{ allocation.first, next, allocation.second });
+        }
+        m_allocations.emplace(next, allocation.second);
+        next += allocation.second;
+    }
+
+    m_freeByOffset.clear();
+    m_freeBySize.clear();
+    if (next < m_capacity)
+    {
+        AddFreeRange(next, m_capacity - next);
+    }
+    return moves;
+}
+
+FreeListAllocator::Stats FreeListAllocator::GetStats() const
+{
+    Stats stats;
+    stats.capacity = m_capacity;
+    stats.used = m_used;
+    stats.allocationCount = m_allocations.size();
+    stats.freeRangeCount = m_freeByOffset.size();
+    stats.largestFreeRange = m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first;
+    size_t free = m_capacity - m_used;
+    stats.fragmentation = free > 0 ? 1.0f - (float)stats.largestFreeRange / free : 0.0f;
+    return stats;
+}
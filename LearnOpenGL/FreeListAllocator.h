@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// The bookkeeping half of GeometryPool, with no GL in it so it can be checked on the CPU (see
+/// CpuBenchmarks::RunFreeListAllocatorCheck).
+///
+/// Hands out ranges of a fixed size space (in whatever units the caller likes: GeometryPool uses vertices and
+/// indices) that can be freed in any order. The free ranges are kept both by offset, so a freed range merges with the
+/// free ones either side of it, and by size, so Allocate finds the smallest one that fits (best fit) in log time
+/// instead of walking the list. Best fit leaves the big ranges alone for big requests.
+///
+/// Freeing in random order still leaves holes between live allocations, so Compact slides everything down to the
+/// start and hands back the moves the caller has to make to its data
+/// </summary>
+class FreeListAllocator
+{
+public:
+	static constexpr size_t InvalidOffset = ~(size_t)0;
+
+	struct Move
+	{
+		size_t from;
+		size_t to;
+		size_t size;
+	};
+
+	struct Stats
+	{
+		size_t capacity = 0;
+		size_t used = 0;
+		size_t allocationCount = 0;
+		size_t freeRangeCount = 0;
+		size_t largestFreeRange = 0;
+		// how much of the free space can't be had in one piece: 0 when it's all one range, close to 1 when it's
+		// scattered in lots of small holes
+		float fragmentation = 0.0f;
+	};
+
+	FreeListAllocator(size_t capacity = 0);
+	/// <summary>
+	/// Forgets every allocation and makes the whole of capacity free
+	/// </summary>
+	void Reset(size_t capacity);
+	/// <summary>
+	/// Adds more space at the end, which joins the free range there if there is one
+	/// </summary>
+	void Grow(size_t newCapacity);
+
+	/// <summary>
+	/// Returns the offset of size free units, or InvalidOffset if there's no free range that big
+	/// </summary>
+	size_t Allocate(size_t size);
+	void Free(size_t offset);
+	size_t GetSize(size_t offset) const;
+
+	/// <summary>
+	/// Moves every allocation down as far as it'll go, in order, so they're all packed together at the start and the
+	/// free space is one range at the end. Returns where each allocation that moved went, lowest offset first, so
+	/// copying them in that order never overwrites one that hasn't been copied yet
+	/// </summary>
+	std::vector<Move> Compact();
+
+	Stats GetStats() const;
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetUsed() const { return m_used; }
+
+private:
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+	// offset -> size of every free range, and size -> offset of the same ranges
+	std::map<size_t, size_t> m_freeByOffset;
+	std::multimap<size_t, size_t> m_freeBySize;
+	// offset -> size of every allocation
+	std::unordered_map<size_t, size_t> m_allocations;
+
+	void AddFreeRange(size_t offset, size_t size);
+	void RemoveFreeRange(std::map<size_t, size_t>::iterator range);
+};
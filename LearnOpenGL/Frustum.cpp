@@ -0,0 +1,197 @@
+#include "Frustum.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_SSE
+#include <immintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+/// <summary>
+/// A point p is inside the view volume when -w <= x <= w (same for y and z) after it's been transformed to clip space,
+/// where (x, y, z, w) = viewProjection * p. Each of those 6 inequalities is a plane. e.g. the left one is x + w >= 0,
+/// and x and w are just the dot products of p with row 0 and row 3 of the matrix, so the left plane is row 3 + row 0.
+/// This is the Gribb/Hartmann method.
+/// </summary>
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    // glm matrices are column major, so m[column][row]
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; ++row)
+    {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+    }
+
+    m_planes[Left] = rows[3] + rows[0];
+    m_planes[Right] = rows[3] - rows[0];
+    m_planes[Bottom] = rows[3] + rows[1];
+    m_planes[Top] = rows[3] - rows[1];
+    m_planes[Near] = rows[3] + rows[2];
+    m_planes[Far] = rows[3] - rows[2];
+
+    // normalize so the plane equation gives actual distances, which the sphere test needs to compare against the radius
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        float length = glm::length(glm::vec3(m_planes[i].x, m_planes[i].y, m_planes[i].z));
+        m_planes[i] = m_planes[i] / length;
+    }
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        const glm::vec4& plane = m_planes[i];
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const
+{
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        // the corner of the box furthest along the plane normal. If even that one is behind the plane, the whole box is
+        const glm::vec4& plane = m_planes[i];
+        float x = plane.x >= 0.0f ? max.x : min.x;
+        float y = plane.y >= 0.0f ? max.y : min.y;
+        float z = plane.z >= 0.0f ? max.z : min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef FRUSTUM_SSE
+
+/// <summary>
+/// Appends first + lane for every lane whose bit is set in mask
+/// </summary>
+static inline size_t AppendVisible(int mask, size_t first, uint32_t* visibleIndices, size_t visibleCount)
+{
+    while (mask != 0)
+    {
+        int lane = 0;
+        while ((mask & (1 << lane)) == 0)
+        {
+            ++lane;
+        }
+        visibleIndices[visibleCount++] = (uint32_t)(first + lane);
+        mask &= mask - 1; // clear the lowest set bit
+    }
+    return visibleCount;
+}
+
+size_t Frustum::CullSpheres(const float* x, const float* y, const float* z, float radius, size_t first, size_t count, uint32_t* visibleIndices) const
+{
+    const size_t end = first + count;
+    const __m128 negativeRadius = _mm_set1_ps(-radius);
+    size_t visibleCount = 0;
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+
+        // all lanes start visible, and each plane can knock some out
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < PlaneCount; ++p)
+        {
+            const glm::vec4& plane = m_planes[p];
+            // added up in the same order as IntersectsSphere, so an object exactly on a plane gets the same answer here
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                _mm_mul_ps(_mm_set1_ps(plane.z), cz)), _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        visibleCount = AppendVisible(_mm_movemask_ps(inside), i, visibleIndices, visibleCount);
+    }
+
+    for (; i < end; ++i)
+    {
+        if (IntersectsSphere(glm::vec3(x[i], y[i], z[i]), radius))
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+    }
+    return visibleCount;
+}
+
+size_t Frustum::CullAABBs(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ,
+    size_t first, size_t count, uint32_t* visibleIndices) const
+{
+    const size_t end = first + count;
+    const __m128 zero = _mm_setzero_ps();
+    size_t visibleCount = 0;
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < PlaneCount; ++p)
+        {
+            // the normal is the same for all 4 boxes, so picking the furthest corner is just picking which array to load
+            const glm::vec4& plane = m_planes[p];
+            __m128 cx = _mm_loadu_ps((plane.x >= 0.0f ? maxX : minX) + i);
+            __m128 cy = _mm_loadu_ps((plane.y >= 0.0f ? maxY : minY) + i);
+            __m128 cz = _mm_loadu_ps((plane.z >= 0.0f ? maxZ : minZ) + i);
+            // added up in the same order as IntersectsAABB, so an object exactly on a plane gets the same answer here
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                _mm_mul_ps(_mm_set1_ps(plane.z), cz)), _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+        }
+        visibleCount = AppendVisible(_mm_movemask_ps(inside), i, visibleIndices, visibleCount);
+    }
+
+    for (; i < end; ++i)
+    {
+        if (IntersectsAABB(glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i])))
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+    }
+    return visibleCount;
+}
+
+#else
+
+size_t Frustum::CullSpheres(const float* x, const float* y, const float* z, float radius, size_t first, size_t count, uint32_t* visibleIndices) const
+{
+    size_t visibleCount = 0;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        if (IntersectsSphere(glm::vec3(x[i], y[i], z[i]), radius))
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+    }
+    return visibleCount;
+}
+
+size_t Frustum::CullAABBs(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ,
+    size_t first, size_t count, uint32_t* visibleIndices) const
+{
+    size_t visibleCount = 0;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        if (IntersectsAABB(glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i])))
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+    }
+    return visibleCount;
+}
+
+#endif
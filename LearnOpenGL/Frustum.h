@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/// <summary>
+/// The 6 planes of a camera's view volume, pulled straight out of a view-projection matrix, and tests for whether
+/// bounding volumes are (at least partly) inside them.
+///
+/// The batch tests take structure-of-arrays input and test 4 objects per iteration with SSE, writing out the indices
+/// of the objects that passed. Anything that can't be rejected against a single plane counts as visible, so a few
+/// objects near the corners of the frustum will be let through even though they're just outside. That's the usual
+/// tradeoff: it's conservative, so nothing visible ever gets culled.
+/// </summary>
+class Frustum
+{
+public:
+    enum PlaneIndex { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+    Frustum();
+    Frustum(const glm::mat4& viewProjection);
+
+    /// <summary>
+    /// Plane i is (normal.x, normal.y, normal.z, d), with the normal pointing into the frustum and normalized, so that
+    /// dot(normal, point) + d is the signed distance of point from the plane
+    /// </summary>
+    const glm::vec4& GetPlane(int i) const { return m_planes[i]; }
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+    bool IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const;
+
+    /// <summary>
+    /// Tests spheres first to first + count - 1, which all have the same radius. Writes the indices of the ones that
+    /// are visible to visibleIndices, which needs room for count entries, and returns how many there were.
+    /// </summary>
+    size_t CullSpheres(const float* x, const float* y, const float* z, float radius, size_t first, size_t count, uint32_t* visibleIndices) const;
+
+    /// <summary>
+    /// Same as CullSpheres, but for axis aligned boxes given by their min and max corners
+    /// </summary>
+    size_t CullAABBs(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ,
+        size_t first, size_t count, uint32_t* visibleIndices) const;
+
+private:
+    glm::vec4 m_planes[PlaneCount];
+};
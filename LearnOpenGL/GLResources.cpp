@@ -0,0 +1,116 @@
+#include "GLResources.h"
+#include <algorithm>
+#include <iostream>
+
+std::unordered_map<GLuint, GLResourceRegistry::Entry> GLResourceRegistry::s_objects[m_typeCount];
+GLResourceRegistry::Counts GLResourceRegistry::s_counts[m_typeCount];
+
+GLuint GLResourceRegistry::Track(GLResourceType type, GLuint name, const char* label)
+{
+	if (name == 0)
+	{
+		return name;
+	}
+	auto inserted = s_objects[(int)type].emplace(name, Entry{ label, 0 });
+	if (!inserted.second)
+	{
+		inserted.first->second.label = label;
+		return name;
+	}
+	Counts& counts = s_counts[(int)type];
+	counts.live++;
+	counts.created++;
+	return name;
+}
+
+void GLResourceRegistry::Untrack(GLResourceType type, GLuint name)
+{
+	auto found = s_objects[(int)type].find(name);
+	if (found == s_objects[(int)type].end())
+	{
+		return;
+	}
+	Counts& counts = s_counts[(int)type];
+	counts.live--;
+	counts.deleted++;
+	counts.bytes -= found->second.bytes;
+	s_objects[(int)type].erase(found);
+}
+
+void GLResourceRegistry::SetBytes(GLResourceType type, GLuint name, size_t bytes)
+{
+	auto found = s_objects[(int)type].find(name);
+	if (found == s_objects[(int)type].end())
+	{
+		return;
+	}
+	Counts& counts = s_counts[(int)type];
+	counts.bytes = counts.bytes - found->second.bytes + bytes;
+	counts.peakBytes = std::max(counts.peakBytes, counts.bytes);
+	found->second.bytes = bytes;
+}
+
+size_t GLResourceRegistry::GetLiveCount()
+{
+	size_t live = 0;
+	for (const Counts& counts : s_counts)
+	{
+		live += counts.live;
+	}
+	return live;
+}
+
+size_t GLResourceRegistry::GetTotalBytes()
+{
+	size_t bytes = 0;
+	for (const Counts& counts : s_counts)
+	{
+		bytes += counts.bytes;
+	}
+	return bytes;
+}
+
+const char* GLResourceRegistry::GetTypeName(GLResourceType type)
+{
+	switch (type)
+	{
+	case GLResourceType::Buffer: return "buffer";
+	case GLResourceType::Texture: return "texture";
+	case GLResourceType::VertexArray: return "vertex array";
+	case GLResourceType::Program: return "program";
+	case GLResourceType::Shader: return "shader";
+	default: return "unknown";
+	}
+}
+
+void GLResourceRegistry::PrintStats()
+{
+	std::cout << "GL objects: " << GetLiveCount() << " live, ~" << GetTotalBytes() / 1024 << " KB" << std::endl;
+	for (int type = 0; type < m_typeCount; ++type)
+	{
+		const Counts& counts = s_counts[type];
+		std::cout << "  " << GetTypeName((GLResourceType)type) << "s: " << counts.live << " live (" << counts.created
+			<< " created, " << counts.deleted << " deleted), ~" << counts.bytes / 1024 << " KB, peak ~"
+			<< counts.peakBytes / 1024 << " KB" << std::endl;
+	}
+}
+
+size_t GLResourceRegistry::ReportLeaks()
+{
+	size_t leaks = GetLiveCount();
+	if (leaks == 0)
+	{
+		std::cout << "No GL objects leaked" << std::endl;
+		return 0;
+	}
+	std::cout << "LEAK: " << leaks << " GL objects still alive, ~" << GetTotalBytes() / 1024 << " KB:" << std::endl;
+	for (int type = 0; type < m_typeCount; ++type)
+	{
+		for (const auto& nameAndEntry : s_objects[type])
+		{
+			std::cout << "  " << GetTypeName((GLResourceType)type) << " " << nameAndEntry.first << " (" << nameAndEntry.second.label
+				<< "), " << nameAndEntry.second.bytes << " bytes" << std::endl;
+		}
+	}
+	return leaks;
+}
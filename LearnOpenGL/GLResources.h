@@ -0,0 +1,204 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "GLStateCache.h"
+
+/// <summary>
+/// The kinds of GL object the project makes. Sync objects aren't here: fences only live for a frame or two and are
+/// owned by RingAllocator (see StreamingRingBuffer)
+/// </summary>
+enum class GLResourceType
+{
+	Buffer,
+	Texture,
+	VertexArray,
+	Program,
+	Shader,
+	Count
+};
+
+/// <summary>
+/// Keeps a list of every live GL object with what it was made for and roughly how much GPU memory it takes, so the
+/// totals can be printed while running and anything still alive at shutdown reported as a leak. Long sessions that
+/// load and unload scenes should see the live counts and bytes come back to where they were, and PrintStats shows the
+/// peak too.
+///
+/// Objects get in here through Track, which GLObject calls when it creates one (code that makes its own names, like
+/// ShaderLoader, calls it directly), and leave when they're deleted through GLStateCache, which every deletion already
+/// goes through. Byte counts are estimates: what was asked for in glBufferData and friends, not what the driver really
+/// allocated (which GL has no way to ask), so padding, mip chains and driver copies are guesses or left out.
+///
+/// Only touch this from the thread with the context, like everything else GL. All static, like the other caches
+/// </summary>
+class GLResourceRegistry
+{
+public:
+	struct Counts
+	{
+		size_t live = 0;
+		uint64_t created = 0;
+		uint64_t deleted = 0;
+		size_t bytes = 0;
+		size_t peakBytes = 0;
+	};
+
+	/// <summary>
+	/// Starts tracking name, made for label (which has to outlive it, so a string literal or a member name). Tracking one
+	/// that's already tracked just relabels it. Returns name, so it can wrap a glCreate* call
+	/// </summary>
+	static GLuint Track(GLResourceType type, GLuint name, const char* label);
+	/// <summary>
+	/// Stops tracking name. Names that were never tracked (from code that doesn't use this, or 0) are ignored
+	/// </summary>
+	static void Untrack(GLResourceType type, GLuint name);
+	/// <summary>
+	/// Sets how many bytes of GPU memory name is thought to take, replacing what was set before
+	/// </summary>
+	static void SetBytes(GLResourceType type, GLuint name, size_t bytes);
+
+	static const Counts& GetCounts(GLResourceType type) { return s_counts[(int)type]; }
+	static size_t GetLiveCount();
+	static size_t GetTotalBytes();
+	static const char* GetTypeName(GLResourceType type);
+
+	static void PrintStats();
+	/// <summary>
+	/// Prints every object that's still alive, and returns how many there are. Call at shutdown, after everything has
+	/// been released, but while there's still a context
+	/// </summary>
+	static size_t ReportLeaks();
+
+private:
+	struct Entry
+	{
+		const char* label;
+		size_t bytes;
+	};
+
+	static constexpr int m_typeCount = (int)GLResourceType::Count;
+	static std::unordered_map<GLuint, Entry> s_objects[m_typeCount];
+	static Counts s_counts[m_typeCount];
+};
+
+/// <summary>
+/// Owns one GL object of Type, deleting it when it goes out of scope or is reset. Move-only, so there's always exactly
+/// one owner. Deletes buffers, textures, VAOs and programs through GLStateCache, so the cache forgets them and the
+/// registry stops tracking them.
+///
+/// Like everything GL these have to be destroyed while the context is still alive: members of an app that outlives
+/// glfwTerminate need resetting before it
+/// </summary>
+template<GLResourceType Type>
+class GLObject
+{
+public:
+	GLObject() = default;
+	~GLObject() { Reset(); }
+	GLObject(const GLObject&) = delete;
+	GLObject& operator=(const GLObject&) = delete;
+	GLObject(GLObject&& other) noexcept : m_name(std::exchange(other.m_name, 0)) {}
+	GLObject& operator=(GLObject&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			m_name = std::exchange(other.m_name, 0);
+		}
+		return *this;
+	}
+
+	/// <summary>
+	/// Makes a new object (deleting the one held before, if any). shaderType is only for shader objects, which need to
+	/// know what stage they're for up front
+	/// </summary>
+	void Create(const char* label, GLenum shaderType = GL_NONE)
+	{
+		Reset();
+		if constexpr (Type == GLResourceType::Buffer)
+		{
+			glGenBuffers(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::Texture)
+		{
+			glGenTextures(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::VertexArray)
+		{
+			glGenVertexArrays(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::Program)
+		{
+			m_name = glCreateProgram();
+		}
+		else
+		{
+			m_name = glCreateShader(shaderType);
+		}
+		GLResourceRegistry::Track(Type, m_name, label);
+	}
+
+	/// <summary>
+	/// Takes ownership of an object made elsewhere (e.g. a program from ShaderLoader), tracking it as label
+	/// </summary>
+	void Adopt(GLuint name, const char* label)
+	{
+		Reset();
+		m_name = name;
+		GLResourceRegistry::Track(Type, m_name, label);
+	}
+
+	/// <summary>
+	/// Hands the object over to code that deletes it itself (through GLStateCache, so it still gets untracked), and
+	/// forgets it
+	/// </summary>
+	GLuint Release() { return std::exchange(m_name, 0); }
+
+	void Reset()
+	{
+		if (m_name == 0)
+		{
+			return;
+		}
+		if constexpr (Type == GLResourceType::Buffer)
+		{
+			GLStateCache::DeleteBuffers(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::Texture)
+		{
+			GLStateCache::DeleteTextures(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::VertexArray)
+		{
+			GLStateCache::DeleteVertexArrays(1, &m_name);
+		}
+		else if constexpr (Type == GLResourceType::Program)
+		{
+			GLStateCache::DeleteProgram(m_name);
+		}
+		else
+		{
+			// shaders aren't bound to anything, so the state cache doesn't need to know
+			glDeleteShader(m_name);
+			GLResourceRegistry::Untrack(Type, m_name);
+		}
+		m_name = 0;
+	}
+
+	void SetBytes(size_t bytes) const { GLResourceRegistry::SetBytes(Type, m_name, bytes); }
+	GLuint Get() const { return m_name; }
+	bool IsValid() const { return m_name != 0; }
+
+private:
+	GLuint m_name = 0;
+};
+
+using GLBuffer = GLObject<GLResourceType::Buffer>;
+using GLTexture = GLObject<GLResourceType::Texture>;
+using GLVertexArray = GLObject<GLResourceType::VertexArray>;
+using GLProgram = GLObject<GLResourceType::Program>;
+using GLShaderObject = GLObject<GLResourceType::Shader>;
@@ -0,0 +1,423 @@
+#include "GLStateCache.h"
+#include <iostream>
+
+#include "GLResources.h"
+
+// GL_ELEMENT_ARRAY_BUFFER has to stay in this list: it's part of the VAO, so BindVertexArray forgets it
+const GLenum GLStateCache::s_bufferTargets[m_bufferTargetCount] = {
+	GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+	GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+	GL_DISPATCH_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER
+};
+const GLenum GLStateCache::s_bufferBindingQueries[m_bufferTargetCount] = {
+	GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING,
+	GL_COPY_WRITE_BUFFER_BINDING, GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_TEXTURE_BUFFER_BINDING,
+	GL_DRAW_INDIRECT_BUFFER_BINDING, GL_DISPATCH_INDIRECT_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING
+};
+const GLenum GLStateCache::s_textureTargets[m_textureTargetCount] = {
+	GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY
+};
+const GLenum GLStateCache::s_textureBindingQueries[m_textureTargetCount] = {
+	GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_2D_ARRAY
+};
+const GLenum GLStateCache::s_capabilities[m_capabilityCount] = {
+	GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_PRIMITIVE_RESTART
+};
+
+GLuint GLStateCache::s_program = GLStateCache::m_unknown;
+GLuint GLStateCache::s_vertexArray = GLStateCache::m_unknown;
+GLuint GLStateCache::s_buffers[m_bufferTargetCount];
+GLuint GLStateCache::s_activeTexture = GLStateCache::m_unknown;
+GLuint GLStateCache::s_textures[m_textureUnitCount][m_textureTargetCount];
+int8_t GLStateCache::s_capabilityStates[m_capabilityCount];
+GLenum GLStateCache::s_polygonMode = GLStateCache::m_unknown;
+#ifndef NDEBUG
+bool GLStateCache::s_validate = true;
+#else
+bool GLStateCache::s_validate = false;
+#endif
+GLStateCache::Counters GLStateCache::s_frame;
+GLStateCache::Counters GLStateCache::s_lastFrame;
+GLStateCache::Counters GLStateCache::s_total;
+
+void GLStateCache::Invalidate()
+{
+	s_program = m_unknown;
+	s_vertexArray = m_unknown;
+	for (GLuint& buffer : s_buffers)
+	{
+		buffer = m_unknown;
+	}
+	s_activeTexture = m_unknown;
+	for (auto& unit : s_textures)
+	{
+		for (GLuint& texture : unit)
+		{
+			texture = m_unknown;
+		}
+	}
+	for (int8_t& state : s_capabilityStates)
+	{
+		state = -1;
+	}
+	s_polygonMode = m_unknown;
+}
+
+void GLStateCache::Issued()
+{
+	s_frame.issued++;
+	s_total.issued++;
+}
+
+void GLStateCache::Skipped()
+{
+	s_frame.skipped++;
+	s_total.skipped++;
+}
+
+bool GLStateCache::Update(GLuint& shadow, GLuint value)
+{
+	if (shadow == value)
+	{
+		Skipped();
+		return false;
+	}
+	shadow = value;
+	Issued();
+	return true;
+}
+
+int GLStateCache::FindBufferTarget(GLenum target)
+{
+	for (int i = 0; i < m_bufferTargetCount; ++i)
+	{
+		if (s_bufferTargets[i] == target)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int GLStateCache::FindTextureTarget(GLenum target)
+{
+	for (int i = 0; i < m_textureTargetCount; ++i)
+	{
+		if (s_textureTargets[i] == target)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int GLStateCache::FindCapability(GLenum capability)
+{
+	for (int i = 0; i < m_capabilityCount; ++i)
+	{
+		if (s_capabilities[i] == capability)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (Update(s_program, program))
+	{
+		glUseProgram(program);
+	}
+}
+
+GLuint GLStateCache::GetProgram()
+{
+	if (s_program == m_unknown)
+	{
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		s_program = (GLuint)program;
+	}
+	return s_program;
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (Update(s_vertexArray, vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+		s_frame.vertexArraySwitches++;
+		s_total.vertexArraySwitches++;
+		// the element buffer binding belongs to the VAO, so whatever it is now, we don't know it
+		s_buffers[FindBufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = m_unknown;
+	}
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int index = FindBufferTarget(target);
+	if (index < 0)
+	{
+		Issued();
+		glBindBuffer(target, buffer);
+	}
+	else if (Update(s_buffers[index], buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	Issued();
+	glBindBufferRange(target, index, buffer, offset, size);
+	int targetIndex = FindBufferTarget(target);
+	if (targetIndex >= 0)
+	{
+		s_buffers[targetIndex] = buffer;
+	}
+}
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	Issued();
+	glBindBufferBase(target, index, buffer);
+	int targetIndex = FindBufferTarget(target);
+	if (targetIndex >= 0)
+	{
+		s_buffers[targetIndex] = buffer;
+	}
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	if (Update(s_activeTexture, unit - GL_TEXTURE0))
+	{
+		glActiveTexture(unit);
+	}
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int targetIndex = FindTextureTarget(target);
+	if (targetIndex < 0 || s_activeTexture >= (GLuint)m_textureUnitCount)
+	{
+		// an untracked target or unit, or we don't know which unit is active. Either way, just pass it on
+		Issued();
+		glBindTexture(target, texture);
+		if (targetIndex >= 0)
+		{
+			// it went to whatever unit is active, and since we don't know which, we don't know any of them
+			for (auto& unit : s_textures)
+			{
+				unit[targetIndex] = m_unknown;
+			}
+		}
+		return;
+	}
+	if (Update(s_textures[s_activeTexture][targetIndex], texture))
+	{
+		glBindTexture(target, texture);
+	}
+}
+
+void GLStateCache::BindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+{
+	int targetIndex = FindTextureTarget(target);
+	if (targetIndex >= 0 && unit < (GLuint)m_textureUnitCount && s_textures[unit][targetIndex] == texture)
+	{
+		// already there, so there's no need to switch units either
+		Skipped();
+		return;
+	}
+	ActiveTexture(GL_TEXTURE0 + unit);
+	BindTexture(target, texture);
+}
+
+void GLStateCache::SetCapability(GLenum capability, bool enabled)
+{
+	int index = FindCapability(capability);
+	if (index >= 0 && s_capabilityStates[index] == (enabled ? 1 : 0))
+	{
+		Skipped();
+		return;
+	}
+	if (index >= 0)
+	{
+		s_capabilityStates[index] = enabled ? 1 : 0;
+	}
+	Issued();
+	if (enabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+void GLStateCache::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+void GLStateCache::PolygonMode(GLenum mode)
+{
+	if (Update(s_polygonMode, mode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+}
+
+void GLStateCache::DeleteProgram(GLuint program)
+{
+	glDeleteProgram(program);
+	GLResourceRegistry::Untrack(GLResourceType::Program, program);
+	// a deleted program stays in use until something else is, but once it's gone its name can be handed out again,
+	// and a new program with the same name would look like it's already in use
+	if (s_program == program)
+	{
+		s_program = m_unknown;
+	}
+}
+
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+	glDeleteVertexArrays(count, vertexArrays);
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		GLResourceRegistry::Untrack(GLResourceType::VertexArray, vertexArrays[i]);
+		// deleting the bound VAO binds 0 instead
+		if (s_vertexArray == vertexArrays[i])
+		{
+			s_vertexArray = 0;
+			s_buffers[FindBufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = 0;
+		}
+	}
+}
+
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	glDeleteBuffers(count, buffers);
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		GLResourceRegistry::Untrack(GLResourceType::Buffer, buffers[i]);
+		for (GLuint& bound : s_buffers)
+		{
+			if (bound == buffers[i])
+			{
+				bound = 0;
+			}
+		}
+	}
+}
+
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* textures)
+{
+	glDeleteTextures(count, textures);
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		GLResourceRegistry::Untrack(GLResourceType::Texture, textures[i]);
+		for (auto& unit : s_textures)
+		{
+			for (GLuint& bound : unit)
+			{
+				if (bound == textures[i])
+				{
+					bound = 0;
+				}
+			}
+		}
+	}
+}
+
+void GLStateCache::EndFrame()
+{
+	if (s_validate)
+	{
+		Validate();
+	}
+	s_lastFrame = s_frame;
+	s_frame = Counters();
+}
+
+int GLStateCache::Check(const char* what, GLuint& shadow, GLuint actual)
+{
+	if (shadow == m_unknown || shadow == actual)
+	{
+		return 0;
+	}
+	std::cout << "ERROR::GL_STATE_CACHE " << what << " is " << actual << " but the cache thought it was " << shadow << std::endl;
+	shadow = actual;
+	return 1;
+}
+
+int GLStateCache::Validate()
+{
+	int mismatches = 0;
+	GLint value = 0;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+	mismatches += Check("the current program", s_program, (GLuint)value);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+	mismatches += Check("the bound VAO", s_vertexArray, (GLuint)value);
+
+	// only ask about targets something was bound to, since some of them don't exist before GL 4.3
+	for (int i = 0; i < m_bufferTargetCount; ++i)
+	{
+		if (s_buffers[i] != m_unknown)
+		{
+			glGetIntegerv(s_bufferBindingQueries[i], &value);
+			mismatches += Check("a buffer binding", s_buffers[i], (GLuint)value);
+		}
+	}
+
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &value);
+	GLuint activeTexture = (GLuint)value - GL_TEXTURE0;
+	mismatches += Check("the active texture unit", s_activeTexture, activeTexture);
+	for (GLuint unit = 0; unit < (GLuint)m_textureUnitCount; ++unit)
+	{
+		for (int target = 0; target < m_textureTargetCount; ++target)
+		{
+			if (s_textures[unit][target] != m_unknown)
+			{
+				// only switch units when there's something to check on this one
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glGetIntegerv(s_textureBindingQueries[target], &value);
+				mismatches += Check("a texture binding", s_textures[unit][target], (GLuint)value);
+			}
+		}
+	}
+	glActiveTexture(GL_TEXTURE0 + activeTexture);
+
+	for (int i = 0; i < m_capabilityCount; ++i)
+	{
+		if (s_capabilityStates[i] >= 0)
+		{
+			int8_t enabled = glIsEnabled(s_capabilities[i]) ? 1 : 0;
+			if (enabled != s_capabilityStates[i])
+			{
+				std::cout << "ERROR::GL_STATE_CACHE capability 0x" << std::hex << s_capabilities[i] << std::dec
+					<< " is " << (enabled ? "enabled" : "disabled") << " but the cache thought otherwise" << std::endl;
+				s_capabilityStates[i] = enabled;
+				mismatches++;
+			}
+		}
+	}
+
+	if (s_polygonMode != m_unknown)
+	{
+		// front and back, which we always set together
+		GLint modes[2] = {};
+		glGetIntegerv(GL_POLYGON_MODE, modes);
+		mismatches += Check("the polygon mode", s_polygonMode, (GLuint)modes[0]);
+	}
+	return mismatches;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+/// <summary>
+/// Shadows the bits of GL state the renderer keeps changing (the program, VAO, buffer bindings, texture units, a few
+/// capabilities and the polygon mode) and drops calls that wouldn't change anything. Every one of those calls goes
+/// through the driver's validation even when it's a no-op, and the frame loops set the same textures, program and VAO
+/// every frame whether they changed or not.
+///
+/// This only works if everything that changes this state goes through here. Code that calls GL directly (the older
+/// tutorials in TrianglesAndShaders, say) has to call Invalidate afterwards, so the next call of each kind is issued no
+/// matter what. Deleting objects has to go through here too, since GL quietly unbinds deleted buffers, textures and VAOs.
+/// That's also where GLResourceRegistry finds out they're gone.
+///
+/// With validation on (the default in debug builds), EndFrame reads everything back with glGet* and complains about
+/// anything that doesn't match the shadow, which means someone changed it behind the cache's back.
+///
+/// There's only one context, so this is all static, like the other caches
+/// </summary>
+class GLStateCache
+{
+public:
+	struct Counters
+	{
+		// calls that actually reached GL, and ones dropped because they wouldn't have changed anything
+		uint64_t issued = 0;
+		uint64_t skipped = 0;
+		// of the issued ones, how many bound a different VAO
+		uint64_t vertexArraySwitches = 0;
+	};
+
+	/// <summary>
+	/// Forgets everything. Call once a new context is made current, or after code that changed state without going
+	/// through here. Doesn't touch the counters
+	/// </summary>
+	static void Invalidate();
+
+	static void UseProgram(GLuint program);
+	/// <summary>
+	/// The program that's in use, asking GL for it if the cache doesn't know. For code that has to switch programs for
+	/// a moment and put the old one back
+	/// </summary>
+	static GLuint GetProgram();
+	static void BindVertexArray(GLuint vertexArray);
+	static void BindBuffer(GLenum target, GLuint buffer);
+	/// <summary>
+	/// Always issued (the ranges handed out by the ring buffers move every frame anyway), but it also binds the generic
+	/// target, so the shadow of that is updated
+	/// </summary>
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void ActiveTexture(GLenum unit);
+	/// <summary>
+	/// Binds texture to target on the active unit, like glBindTexture
+	/// </summary>
+	static void BindTexture(GLenum target, GLuint texture);
+	/// <summary>
+	/// Binds texture to target on unit (0 for GL_TEXTURE0), only switching the active unit if the binding changes
+	/// </summary>
+	static void BindTextureUnit(GLuint unit, GLenum target, GLuint texture);
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	/// <summary>
+	/// Core profile only has GL_FRONT_AND_BACK, so that's all this tracks
+	/// </summary>
+	static void PolygonMode(GLenum mode);
+
+	static void DeleteProgram(GLuint program);
+	static void DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+	static void DeleteBuffers(GLsizei count, const GLuint* buffers);
+	static void DeleteTextures(GLsizei count, const GLuint* textures);
+
+	/// <summary>
+	/// Call once per frame: closes the frame's counters (see GetLastFrameCounters) and, with validation on, checks the
+	/// shadow against the real state
+	/// </summary>
+	static void EndFrame();
+
+	/// <summary>
+	/// Reads back every piece of state the cache thinks it knows and prints any that differ, then takes the real value.
+	/// Returns how many differed. Slow, it's a pile of glGet* calls that each make the driver sync up
+	/// </summary>
+	static int Validate();
+	static void SetValidation(bool enabled) { s_validate = enabled; }
+
+	static const Counters& GetLastFrameCounters() { return s_lastFrame; }
+	static const Counters& GetTotalCounters() { return s_total; }
+
+private:
+	// not a valid name for anything, so a shadow holding it always differs from what's being bound
+	static constexpr GLuint m_unknown = ~0u;
+	static constexpr int m_bufferTargetCount = 11;
+	static constexpr int m_textureUnitCount = 32;
+	static constexpr int m_textureTargetCount = 4;
+	static constexpr int m_capabilityCount = 6;
+
+	static const GLenum s_bufferTargets[m_bufferTargetCount];
+	static const GLenum s_bufferBindingQueries[m_bufferTargetCount];
+	static const GLenum s_textureTargets[m_textureTargetCount];
+	static const GLenum s_textureBindingQueries[m_textureTargetCount];
+	static const GLenum s_capabilities[m_capabilityCount];
+
+	static GLuint s_program;
+	static GLuint s_vertexArray;
+	static GLuint s_buffers[m_bufferTargetCount];
+	static GLuint s_activeTexture;
+	static GLuint s_textures[m_textureUnitCount][m_textureTargetCount];
+	// -1 unknown, 0 disabled, 1 enabled
+	static int8_t s_capabilityStates[m_capabilityCount];
+	static GLenum s_polygonMode;
+
+	static bool s_validate;
+	static Counters s_frame;
+	static Counters s_lastFrame;
+	static Counters s_total;
+
+	static int FindBufferTarget(GLenum target);
+	static int FindTextureTarget(GLenum target);
+	static int FindCapability(GLenum capability);
+	static void SetCapability(GLenum capability, bool enabled);
+	// returns true if the call should go through, and updates the shadow and counters either way
+	static bool Update(GLuint& shadow, GLuint value);
+	static void Issued();
+	static void Skipped();
+	static int Check(const char* what, GLuint& shadow, GLuint actual);
+};
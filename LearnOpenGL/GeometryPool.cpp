@@ -0,0 +1,214 @@
+#include "GeometryPool.h"
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+#include "GLStateCache.h"
+#include "VertexArrayCache.h"
+
+GeometryPool::~GeometryPool()
+{
+	Destroy();
+}
+
+void GeometryPool::Create(GLsizei vertexStride, size_t vertexCapacity, size_t indexCapacity, const char* name)
+{
+	Destroy();
+	m_name = name;
+	m_vertexStride = vertexStride;
+	m_vertexAllocator.Reset(vertexCapacity);
+	m_indexAllocator.Reset(indexCapacity);
+	m_vertexBuffer = CreateBuffer(vertexCapacity * vertexStride);
+	m_indexBuffer = CreateBuffer(indexCapacity * sizeof(uint32_t));
+}
+
+void GeometryPool::Destroy()
+{
+	if (!m_vertexBuffer.IsValid())
+	{
+		return;
+	}
+	DeleteBuffers();
+	m_meshes.clear();
+	m_freeIds.clear();
+	m_vertexAllocator.Reset(0);
+	m_indexAllocator.Reset(0);
+}
+
+GLBuffer GeometryPool::CreateBuffer(GLsizeiptr size)
+{
+	// these are only ever written by copies, so bind them to the copy target, which isn't part of any VAO
+	GLBuffer buffer;
+	buffer.Create(m_name);
+	GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, buffer.Get());
+	glBufferData(GL_COPY_WRITE_BUFFER, std::max<GLsizeiptr>(size, 1), NULL, GL_STATIC_DRAW);
+	buffer.SetBytes(size);
+	return buffer;
+}
+
+void GeometryPool::DeleteBuffers()
+{
+	VertexArrayCache::RemoveBuffer(m_vertexBuffer.Get());
+	VertexArrayCache::RemoveBuffer(m_indexBuffer.Get());
+	m_vertexBuffer.Reset();
+	m_indexBuffer.Reset();
+}
+
+GeometryPool::MeshId GeometryPool::Add(const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+{
+	if (vertexCount == 0 || indexCount == 0)
+	{
+		return InvalidMesh;
+	}
+
+	size_t vertexOffset = m_vertexAllocator.Allocate(vertexCount);
+	size_t indexOffset = m_indexAllocator.Allocate(indexCount);
+	if (vertexOffset == FreeListAllocator::InvalidOffset || indexOffset == FreeListAllocator::InvalidOffset)
+	{
+		if (vertexOffset != FreeListAllocator::InvalidOffset)
+		{
+			m_vertexAllocator.Free(vertexOffset);
+		}
+		if (indexOffset != FreeListAllocator::InvalidOffset)
+		{
+			m_indexAllocator.Free(indexOffset);
+		}
+
+		// if there's enough free space in total, it's just in too many pieces. Otherwise make the buffers at least twice
+		// as big, so adding lots of meshes one by one only copies everything a few times
+		size_t vertexCapacity = m_vertexAllocator.GetCapacity();
+		size_t indexCapacity = m_indexAllocator.GetCapacity();
+		bool fitsWhenPacked = m_vertexAllocator.GetUsed() + vertexCount <= vertexCapacity
+			&& m_indexAllocator.GetUsed() + indexCount <= indexCapacity;
+		if (fitsWhenPacked)
+		{
+			Defragment();
+		}
+		else
+		{
+			Rebuild(std::max(vertexCapacity * 2, m_vertexAllocator.GetUsed() + vertexCount),
+				std::max(indexCapacity * 2, m_indexAllocator.GetUsed() + indexCount));
+			m_grows++;
+		}
+		vertexOffset = m_vertexAllocator.Allocate(vertexCount);
+		indexOffset = m_indexAllocator.Allocate(indexCount);
+	}
+
+	GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer.Get());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * m_vertexStride, vertexCount * m_vertexStride, vertices);
+	GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer.Get());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(uint32_t), indexCount * sizeof(uint32_t), indices);
+
+	MeshId id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = (MeshId)m_meshes.size();
+		m_meshes.emplace_back();
+	}
+	Slot& slot = m_meshes[id];
+	slot.used = true;
+	slot.mesh.baseVertex = (GLint)vertexOffset;
+	slot.mesh.firstIndex = (GLuint)indexOffset;
+	slot.mesh.vertexCount = (GLsizei)vertexCount;
+	slot.mesh.indexCount = (GLsizei)indexCount;
+	return id;
+}
+
+void GeometryPool::Remove(MeshId mesh)
+{
+	if (mesh >= m_meshes.size() || !m_meshes[mesh].used)
+	{
+		return;
+	}
+	Slot& slot = m_meshes[mesh];
+	// the data is left where it is, the space just gets handed out again
+	m_vertexAllocator.Free(slot.mesh.baseVertex);
+	m_indexAllocator.Free(slot.mesh.firstIndex);
+	slot = Slot();
+	m_freeIds.push_back(mesh);
+}
+
+void GeometryPool::Defragment()
+{
+	Rebuild(m_vertexAllocator.GetCapacity(), m_indexAllocator.GetCapacity());
+	m_defragmentations++;
+}
+
+void GeometryPool::Rebuild(size_t vertexCapacity, size_t indexCapacity)
+{
+	// where the allocators say each range goes once everything is packed together. Ranges that didn't move aren't in
+	// the list
+	std::unordered_map<size_t, size_t> vertexMoves;
+	for (const FreeListAllocator::Move& move : m_vertexAllocator.Compact())
+	{
+		vertexMoves[move.from] = move.to;
+	}
+	std::unordered_map<size_t, size_t> indexMoves;
+	for (const FreeListAllocator::Move& move : m_indexAllocator.Compact())
+	{
+		indexMoves[move.from] = move.to;
+	}
+	m_vertexAllocator.Grow(vertexCapacity);
+	m_indexAllocator.Grow(indexCapacity);
+
+	// copy into new buffers rather than within the old ones, since glCopyBufferSubData can't copy between overlapping
+	// ranges of the same buffer, which sliding a mesh down by less than its own size would be
+	GLBuffer vertexBuffer = CreateBuffer(vertexCapacity * m_vertexStride);
+	GLBuffer indexBuffer = CreateBuffer(indexCapacity * sizeof(uint32_t));
+	for (Slot& slot : m_meshes)
+	{
+		if (!slot.used)
+		{
+			continue;
+		}
+		Mesh& mesh = slot.mesh;
+		auto vertexMove = vertexMoves.find(mesh.baseVertex);
+		size_t newBaseVertex = vertexMove == vertexMoves.end() ? mesh.baseVertex : vertexMove->second;
+		auto indexMove = indexMoves.find(mesh.firstIndex);
+		size_t newFirstIndex = indexMove == indexMoves.end() ? mesh.firstIndex : indexMove->second;
+
+		GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, m_vertexBuffer.Get());
+		GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.Get());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh.baseVertex * m_vertexStride,
+			newBaseVertex * m_vertexStride, (GLsizeiptr)mesh.vertexCount * m_vertexStride);
+		GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, m_indexBuffer.Get());
+		GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.Get());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh.firstIndex * sizeof(uint32_t),
+			newFirstIndex * sizeof(uint32_t), (GLsizeiptr)mesh.indexCount * sizeof(uint32_t));
+
+		mesh.baseVertex = (GLint)newBaseVertex;
+		mesh.firstIndex = (GLuint)newFirstIndex;
+	}
+
+	DeleteBuffers();
+	m_vertexBuffer = std::move(vertexBuffer);
+	m_indexBuffer = std::move(indexBuffer);
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const
+{
+	Stats stats;
+	stats.vertices = m_vertexAllocator.GetStats();
+	stats.indices = m_indexAllocator.GetStats();
+	stats.meshCount = m_meshes.size() - m_freeIds.size();
+	stats.defragmentations = m_defragmentations;
+	stats.grows = m_grows;
+	return stats;
+}
+
+void GeometryPool::PrintStats() const
+{
+	Stats stats = GetStats();
+	auto percent = [](size_t part, size_t whole) { return whole ? 100.0f * part / whole : 0.0f; };
+	std::cout << "Geometry pool " << m_name << ": " << stats.meshCount << " meshes, vertices " << stats.vertices.used << "/"
+		<< stats.vertices.capacity << " (" << percent(stats.vertices.used, stats.vertices.capacity) << "% used, "
+		<< stats.vertices.freeRangeCount << " free ranges, " << 100.0f * stats.vertices.fragmentation << "% fragmented), indices "
+		<< stats.indices.used << "/" << stats.indices.capacity << " (" << percent(stats.indices.used, stats.indices.capacity)
+		<< "% used, " << stats.indices.freeRangeCount << " free ranges, " << 100.0f * stats.indices.fragmentation
+		<< "% fragmented), " << stats.defragmentations << " defragmentations, " << stats.grows << " grows" << std::endl;
+}
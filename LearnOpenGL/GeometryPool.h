@@ -0,0 +1,103 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FreeListAllocator.h"
+#include "GLResources.h"
+
+/// <summary>
+/// One big vertex buffer and one big index buffer that every static mesh of a vertex format lives in, instead of a
+/// VBO and EBO each. Meshes get their ranges from a FreeListAllocator, and are drawn with glDrawElementsBaseVertex:
+/// the indices of each mesh start from 0, and baseVertex is added to them to find its vertices. So switching from one
+/// mesh to another doesn't bind anything, it's just different numbers in the draw call, and meshes of different
+/// shapes can go in the same batch.
+///
+/// When a mesh doesn't fit, the pool is defragmented if that makes enough room, and grown otherwise. Both copy every
+/// mesh into new, packed buffers on the GPU with glCopyBufferSubData, so the buffer names change: anything holding on
+/// to them (VAOs, mostly, see VertexArrayCache) has to get them again afterwards. Mesh ids and GetMesh stay valid,
+/// but where the mesh is doesn't, so look it up again too
+/// </summary>
+class GeometryPool
+{
+public:
+	using MeshId = uint32_t;
+	static constexpr MeshId InvalidMesh = ~0u;
+
+	struct Mesh
+	{
+		// added to every index (see glDrawElementsBaseVertex)
+		GLint baseVertex = 0;
+		// in indices from the start of the index buffer, which are always GL_UNSIGNED_INT
+		GLuint firstIndex = 0;
+		GLsizei vertexCount = 0;
+		GLsizei indexCount = 0;
+	};
+
+	struct Stats
+	{
+		// in vertices and indices
+		FreeListAllocator::Stats vertices;
+		FreeListAllocator::Stats indices;
+		size_t meshCount = 0;
+		uint64_t defragmentations = 0;
+		uint64_t grows = 0;
+	};
+
+	GeometryPool() = default;
+	~GeometryPool();
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	/// <summary>
+	/// Room for vertexCapacity vertices of vertexStride bytes and indexCapacity indices to start with. Needs a current
+	/// context
+	/// </summary>
+	void Create(GLsizei vertexStride, size_t vertexCapacity, size_t indexCapacity, const char* name);
+	void Destroy();
+	bool IsCreated() const { return m_vertexBuffer.IsValid(); }
+
+	/// <summary>
+	/// Copies a mesh in. indices count from 0 within vertices. Returns InvalidMesh if there's nothing to add
+	/// </summary>
+	MeshId Add(const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+	void Remove(MeshId mesh);
+	const Mesh& GetMesh(MeshId mesh) const { return m_meshes[mesh].mesh; }
+
+	/// <summary>
+	/// Packs every mesh together at the start of the buffers, so the free space is in one piece. Changes the buffers
+	/// </summary>
+	void Defragment();
+
+	GLuint GetVertexBuffer() const { return m_vertexBuffer.Get(); }
+	GLuint GetIndexBuffer() const { return m_indexBuffer.Get(); }
+	GLsizei GetVertexStride() const { return m_vertexStride; }
+	Stats GetStats() const;
+	void PrintStats() const;
+
+private:
+	struct Slot
+	{
+		Mesh mesh;
+		bool used = false;
+	};
+
+	const char* m_name = "";
+	GLsizei m_vertexStride = 0;
+	GLBuffer m_vertexBuffer;
+	GLBuffer m_indexBuffer;
+	FreeListAllocator m_vertexAllocator;
+	FreeListAllocator m_indexAllocator;
+	std::vector<Slot> m_meshes;
+	std::vector<MeshId> m_freeIds;
+	uint64_t m_defragmentations = 0;
+	uint64_t m_grows = 0;
+
+	/// <summary>
+	/// Moves everything into new buffers with these capacities, packed together
+	/// </summary>
+	void Rebuild(size_t vertexCapacity, size_t indexCapacity);
+	GLBuffer CreateBuffer(GLsizeiptr size);
+	void DeleteBuffers();
+};
@@ -0,0 +1,124 @@
+#include "GpuCulling.h"
+#include <iostream>
+
+#include "GLStateCache.h"
+#include "ShaderLoader.h"
+#include "VertexArrayCache.h"
+
+GpuCulling::~GpuCulling()
+{
+	Destroy();
+}
+
+bool GpuCulling::IsSupported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void GpuCulling::Create(const TransformBatch& objects, const std::vector<float>& spinDegreesPerSecond, float boundingRadius,
+	glm::vec3 rotationAxis, GLuint indexCount, GLuint firstIndex, GLint baseVertex)
+{
+	m_objectCount = objects.Size();
+	m_indexCount = indexCount;
+
+	ShaderLoader loader;
+	m_program.Adopt(loader.createComputeProgram("compute_cull_cubes.glsl"), "GPU culling");
+	m_planesLocation = glGetUniformLocation(m_program.Get(), "planes");
+	m_rotationAxisLocation = glGetUniformLocation(m_program.Get(), "rotationAxis");
+	m_timeLocation = glGetUniformLocation(m_program.Get(), "time");
+	m_objectCountLocation = glGetUniformLocation(m_program.Get(), "objectCount");
+	m_indexCountLocation = glGetUniformLocation(m_program.Get(), "indexCount");
+	m_firstIndexLocation = glGetUniformLocation(m_program.Get(), "firstIndex");
+	m_baseVertexLocation = glGetUniformLocation(m_program.Get(), "baseVertex");
+
+	// these never change, so set them once
+	GLStateCache::UseProgram(m_program.Get());
+	glm::vec3 axis = glm::normalize(rotationAxis);
+	glUniform3f(m_rotationAxisLocation, axis.x, axis.y, axis.z);
+	glUniform1ui(m_objectCountLocation, (GLuint)m_objectCount);
+	glUniform1ui(m_indexCountLocation, m_indexCount);
+	glUniform1ui(m_firstIndexLocation, firstIndex);
+	glUniform1i(m_baseVertexLocation, baseVertex);
+
+	std::vector<GpuObject> gpuObjects(m_objectCount);
+	for (size_t i = 0; i < m_objectCount; ++i)
+	{
+		gpuObjects[i].positionRadius = glm::vec4(objects.x[i], objects.y[i], objects.z[i], boundingRadius);
+		gpuObjects[i].rotation = glm::vec4(objects.angleDegrees[i], spinDegreesPerSecond[i], 0.0f, 0.0f);
+	}
+
+	// only the GPU writes the matrices, commands and stats, so they get no data, and DYNAMIC_COPY says just that
+	m_objectBuffer.Create("GPU culling objects");
+	m_matrixBuffer.Create("GPU culling matrices");
+	m_commandBuffer.Create("GPU culling commands");
+	m_statsBuffer.Create("GPU culling stats");
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, gpuObjects.size() * sizeof(GpuObject), gpuObjects.data(), GL_STATIC_DRAW);
+	m_objectBuffer.SetBytes(gpuObjects.size() * sizeof(GpuObject));
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_matrixBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_objectCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+	m_matrixBuffer.SetBytes(m_objectCount * sizeof(glm::mat4));
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_objectCount * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+	m_commandBuffer.SetBytes(m_objectCount * sizeof(DrawElementsIndirectCommand));
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffer.Get());
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+	m_statsBuffer.SetBytes(sizeof(GLuint));
+
+	std::cout << "GPU culling: " << m_objectCount << " objects, culled by a compute shader and drawn with one glMultiDrawElementsIndirect" << std::endl;
+}
+
+void GpuCulling::Destroy()
+{
+	// the matrices are an instanced attribute of the cube's VAO
+	VertexArrayCache::RemoveBuffer(m_matrixBuffer.Get());
+	m_objectBuffer.Reset();
+	m_matrixBuffer.Reset();
+	m_commandBuffer.Reset();
+	m_statsBuffer.Reset();
+	m_program.Reset();
+}
+
+void GpuCulling::Cull(const Frustum& frustum, float time)
+{
+	GLStateCache::UseProgram(m_program.Get());
+	glUniform4fv(m_planesLocation, Frustum::PlaneCount, &frustum.GetPlane(0).x);
+	glUniform1f(m_timeLocation, time);
+
+	GLuint zero = 0;
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffer.Get());
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer.Get());
+	GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_matrixBuffer.Get());
+	GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer.Get());
+	GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_statsBuffer.Get());
+	glDispatchCompute((GLuint)((m_objectCount + m_workGroupSize - 1) / m_workGroupSize), 1, 1);
+
+	// the compute shader's writes aren't guaranteed to be visible to the draw's command fetch or vertex attribute
+	// fetch without this
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCulling::Draw(GLenum mode)
+{
+	GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.Get());
+	glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, 0, (GLsizei)m_objectCount, 0);
+}
+
+GLuint GpuCulling::ReadVisibleCount()
+{
+	GLuint visibleCount = 0;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffer.Get());
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &visibleCount);
+	return visibleCount;
+}
+
+void GpuCulling::ReadCommands(std::vector<DrawElementsIndirectCommand>& commands)
+{
+	commands.resize(m_objectCount);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer.Get());
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_objectCount * sizeof(DrawElementsIndirectCommand), commands.data());
+}
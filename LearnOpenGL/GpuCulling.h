@@ -0,0 +1,108 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "GLResources.h"
+#include "TransformKernel.h"
+
+/// <summary>
+/// One draw as glMultiDrawElementsIndirect reads it out of the GL_DRAW_INDIRECT_BUFFER. The compute shader writes
+/// these (DrawCommand in compute_cull_cubes.glsl), so the two have to match
+/// </summary>
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "glMultiDrawElementsIndirect expects tightly packed commands");
+
+/// <summary>
+/// Culls and draws a whole field of objects without the CPU looking at any of them per frame. The objects' bounding
+/// spheres and rotations go into a shader storage buffer once, and every frame a compute shader
+/// (compute_cull_cubes.glsl) tests each one against the frustum and writes its model matrix and a
+/// DrawElementsIndirectCommand. Then a single glMultiDrawElementsIndirect draws the lot, with the culled ones'
+/// commands asking for 0 instances.
+///
+/// Each command's baseInstance is its object's index, and baseInstance offsets instanced attributes, so the model
+/// matrix attribute of the INSTANCED vertex shader can point straight at the matrix buffer: the graphics shaders stay
+/// GLSL 3.30 and are shared with the CPU path.
+///
+/// Needs GL 4.3 for compute shaders, shader storage buffers and multi draw indirect. Check IsSupported and fall back
+/// to culling on the CPU otherwise. Nothing in here is beyond what Mesa's llvmpipe does, so it also runs without a GPU
+/// </summary>
+class GpuCulling
+{
+public:
+	GpuCulling() = default;
+	~GpuCulling();
+	GpuCulling(const GpuCulling&) = delete;
+	GpuCulling& operator=(const GpuCulling&) = delete;
+
+	static bool IsSupported();
+
+	/// <summary>
+	/// objects are the positions and starting angles, spinDegreesPerSecond how fast each one turns around
+	/// rotationAxis. Every object is the same mesh: indexCount indices starting at firstIndex in the element buffer,
+	/// which count from baseVertex (see GeometryPool::Mesh)
+	/// </summary>
+	void Create(const TransformBatch& objects, const std::vector<float>& spinDegreesPerSecond, float boundingRadius,
+		glm::vec3 rotationAxis, GLuint indexCount, GLuint firstIndex, GLint baseVertex);
+	void Destroy();
+	bool IsCreated() const { return m_program.IsValid(); }
+
+	/// <summary>
+	/// Runs the compute shader for this frame. Changes the bound program, so use the drawing one again after
+	/// </summary>
+	void Cull(const Frustum& frustum, float time);
+	/// <summary>
+	/// Draws every object with the program and VAO that are bound. The VAO needs the mesh's element buffer and its
+	/// instanced model matrix attribute reading from GetMatrixBuffer
+	/// </summary>
+	void Draw(GLenum mode);
+
+	GLuint GetMatrixBuffer() const { return m_matrixBuffer.Get(); }
+	size_t GetObjectCount() const { return m_objectCount; }
+
+	/// <summary>
+	/// How many objects passed the last Cull. This reads back from the GPU, so it waits for the culling to finish.
+	/// Fine for stats once a second, not every frame
+	/// </summary>
+	GLuint ReadVisibleCount();
+	/// <summary>
+	/// Copies every draw command the last Cull wrote into commands, one per object. Waits for the GPU too, so it's for
+	/// checking the culling against the CPU, not for the frame loop
+	/// </summary>
+	void ReadCommands(std::vector<DrawElementsIndirectCommand>& commands);
+
+private:
+	static constexpr GLuint m_workGroupSize = 64; // local_size_x in the compute shader
+
+	// has to match Object in compute_cull_cubes.glsl
+	struct GpuObject
+	{
+		glm::vec4 positionRadius;
+		glm::vec4 rotation;
+	};
+
+	GLProgram m_program;
+	GLBuffer m_objectBuffer;
+	GLBuffer m_matrixBuffer;
+	GLBuffer m_commandBuffer;
+	GLBuffer m_statsBuffer;
+	size_t m_objectCount = 0;
+	GLuint m_indexCount = 0;
+
+	GLint m_planesLocation = -1;
+	GLint m_rotationAxisLocation = -1;
+	GLint m_timeLocation = -1;
+	GLint m_objectCountLocation = -1;
+	GLint m_indexCountLocation = -1;
+	GLint m_firstIndexLocation = -1;
+	GLint m_baseVertexLocation = -1;
+};
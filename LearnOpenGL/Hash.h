@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// 64 bit FNV-1a. It's not a cryptographic hash, but it's tiny, fast enough for shader sized strings, and collisions
+/// between a handful of shader sources aren't a concern. It's constexpr, so hashes of strings known at compile time
+/// don't cost anything at runtime
+/// </summary>
+class Hash
+{
+public:
+	static constexpr uint64_t FnvOffsetBasis = 0xCBF29CE484222325ull;
+	static constexpr uint64_t FnvPrime = 0x100000001B3ull;
+
+	/// <summary>
+	/// Hashes length bytes of data, carrying on from hash so several strings can be hashed together
+	/// </summary>
+	static constexpr uint64_t Fnv1a(const char* data, size_t length, uint64_t hash = FnvOffsetBasis)
+	{
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= FnvPrime;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Same as Fnv1a, but also mixes in a separator afterwards, so hashing "ab" then "c" doesn't give the same result as
+	/// "a" then "bc"
+	/// </summary>
+	static constexpr uint64_t Fnv1aPart(const char* data, size_t length, uint64_t hash = FnvOffsetBasis)
+	{
+		hash = Fnv1a(data, length, hash);
+		hash ^= 0xFF;
+		hash *= FnvPrime;
+		return hash;
+	}
+
+	/// <summary>
+	/// Mixes two hashes into one, e.g. to get a hash for a program out of the hashes of its shaders
+	/// </summary>
+	static constexpr uint64_t Combine(uint64_t first, uint64_t second)
+	{
+		uint64_t hash = FnvOffsetBasis;
+		for (int i = 0; i < 8; ++i)
+		{
+			hash = (hash ^ ((first >> (i * 8)) & 0xFF)) * FnvPrime;
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			hash = (hash ^ ((second >> (i * 8)) & 0xFF)) * FnvPrime;
+		}
+		return hash;
+	}
+};
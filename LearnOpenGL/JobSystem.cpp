@@ -0,0 +1,171 @@
+#include "JobSystem.h"
+
+// which job system (if any) the current thread is a worker of, and which queue it owns
+static thread_local const JobSystem* t_jobSystem = nullptr;
+static thread_local size_t t_queueIndex = 0;
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+    if (workerCount == 0)
+    {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for (unsigned int i = 0; i < workerCount + 1; ++i)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        m_workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+unsigned int JobSystem::GetWorkerCount() const
+{
+    return (unsigned int)m_workers.size();
+}
+
+void JobSystem::Dispatch(Counter& counter, size_t count, size_t grainSize, RangeFunction body)
+{
+    counter.m_body = std::move(body);
+    counter.m_remaining.store(count, std::memory_order_release);
+    if (count == 0)
+    {
+        return;
+    }
+    if (grainSize == 0)
+    {
+        grainSize = 1;
+    }
+
+    // just one job for the whole range. It gets split up by whoever picks it up
+    Push(GetCurrentQueueIndex(), Job{ &counter, 0, count, grainSize });
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+    size_t queueIndex = GetCurrentQueueIndex();
+    while (!counter.IsDone())
+    {
+        Job job;
+        if (PopOrSteal(queueIndex, job))
+        {
+            Run(queueIndex, job);
+        }
+        else
+        {
+            // the last few jobs are running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grainSize, RangeFunction body)
+{
+    Counter counter;
+    Dispatch(counter, count, grainSize, std::move(body));
+    Wait(counter);
+}
+
+size_t JobSystem::GetCurrentQueueIndex() const
+{
+    return t_jobSystem == this ? t_queueIndex : 0;
+}
+
+void JobSystem::WorkerLoop(size_t queueIndex)
+{
+    t_jobSystem = this;
+    t_queueIndex = queueIndex;
+    while (true)
+    {
+        Job job;
+        if (PopOrSteal(queueIndex, job))
+        {
+            Run(queueIndex, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeCondition.wait(lock, [this] { return m_stopping || m_queuedJobCount.load() > 0; });
+        if (m_stopping)
+        {
+            return;
+        }
+    }
+}
+
+void JobSystem::Push(size_t queueIndex, const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queueIndex]->mutex);
+        m_queues[queueIndex]->jobs.push_back(job);
+    }
+    m_queuedJobCount.fetch_add(1);
+
+    // taking the lock here makes sure a worker that just saw an empty queue is either already waiting (and gets the
+    // notification) or hasn't checked the job count yet (and will see the new job)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wakeCondition.notify_one();
+}
+
+bool JobSystem::PopOrSteal(size_t queueIndex, Job& job)
+{
+    // newest job from our own queue first
+    {
+        WorkQueue& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+            m_queuedJobCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // then the oldest job of everyone else, starting from our neighbour so the thieves don't all pile onto queue 0
+    for (size_t offset = 1; offset < m_queues.size(); ++offset)
+    {
+        WorkQueue& victim = *m_queues[(queueIndex + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            m_queuedJobCount.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::Run(size_t queueIndex, Job job)
+{
+    // keep the front half, and leave the back half for us (or a thief) to pick up later
+    while (job.end - job.begin > job.grainSize)
+    {
+        size_t middle = job.begin + (job.end - job.begin) / 2;
+        Push(queueIndex, Job{ job.counter, middle, job.end, job.grainSize });
+        job.end = middle;
+    }
+
+    job.counter->m_body(job.begin, job.end);
+    job.counter->m_remaining.fetch_sub(job.end - job.begin, std::memory_order_acq_rel);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A small job system for splitting loops over lots of objects across CPU cores. It has a fixed pool of worker
+/// threads, and every thread (including the one that submits work) owns a deque of jobs.
+///
+/// A job is a range of loop indices. Whoever runs a job that's bigger than the grain size splits it in half, pushes
+/// one half onto the back of its own deque and keeps going with the other half. Threads take work from the back of
+/// their own deque (the most recently split, so the data is probably still in cache), and when they run out they
+/// steal from the front of someone else's deque, which is where the biggest unsplit ranges are. This way the work
+/// evens itself out across threads without having to guess chunk sizes up front.
+///
+/// Nothing in here touches OpenGL, so it's safe to use for pure CPU work like computing transforms, as long as the
+/// results are handed back to the thread that owns the GL context for uploading.
+/// </summary>
+class JobSystem
+{
+public:
+    using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+    /// <summary>
+    /// Tracks one batch of work from Dispatch. It must stay alive until Wait has returned for it.
+    /// </summary>
+    class Counter
+    {
+    public:
+        bool IsDone() const { return m_remaining.load(std::memory_order_acquire) == 0; }
+    private:
+        friend class JobSystem;
+        std::atomic<size_t> m_remaining{ 0 };
+        RangeFunction m_body;
+    };
+
+    /// <summary>
+    /// workerCount of 0 means one worker per hardware thread, minus one for the thread that submits the work
+    /// (since it helps out while it waits)
+    /// </summary>
+    JobSystem(unsigned int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /// <summary>
+    /// Starts running body over [0, count) on the workers, in ranges of at most grainSize indices, and returns
+    /// straight away. Call Wait with the same counter before using the results.
+    /// </summary>
+    void Dispatch(Counter& counter, size_t count, size_t grainSize, RangeFunction body);
+
+    /// <summary>
+    /// Blocks until all the work of the counter is done. The calling thread runs jobs itself while it waits.
+    /// </summary>
+    void Wait(Counter& counter);
+
+    /// <summary>
+    /// Dispatch + Wait
+    /// </summary>
+    void ParallelFor(size_t count, size_t grainSize, RangeFunction body);
+
+    unsigned int GetWorkerCount() const;
+
+private:
+    struct Job
+    {
+        Counter* counter;
+        size_t begin;
+        size_t end;
+        size_t grainSize;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // slot 0 is shared by every thread that isn't one of our workers. Worker i uses slot i + 1
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // lets idle workers sleep instead of spinning when there's nothing to steal
+    std::atomic<size_t> m_queuedJobCount{ 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    bool m_stopping = false;
+
+    void WorkerLoop(size_t queueIndex);
+    size_t GetCurrentQueueIndex() const;
+    void Push(size_t queueIndex, const Job& job);
+    bool PopOrSteal(size_t queueIndex, Job& job);
+    void Run(size_t queueIndex, Job job);
+};
@@ -4,12 +4,17 @@
 
 int main(int argc, char* argv[])
 {
-	// This isn't platform safe, but for some reason this VS project doesn't have proper filesystem support despite
-	// being c++17, and the latest boost libs are not compiling properly for me. So I'm just going to manually
-	// handle paths. This is going to be used to get the vertex and fragment shader files, which I've configured
-	// to be copied into the output directory in the LearnOpenGL.vsxproj file.
-	std::string fullPathToExe = argv[0];
-	std::string appPath = fullPathToExe.substr(0, fullPathToExe.find_last_of("\\"));
+	// For some reason this VS project doesn't have proper filesystem support despite being c++17, and the latest
+	// boost libs are not compiling properly for me. So I'm just going to manually handle paths (see PathUtilities,
+	// which takes either kind of separator). This is used to find the textures, the program binary cache, and in
+	// debug builds the shader files, which I've configured to be copied into the output directory in the
+	// LearnOpenGL.vsxproj file. If the exe was started without a directory in front of its name, that's just the
+	// working directory
+	std::string appPath = PathUtilities::GetDirectory(argv[0]);
+	if (appPath.empty())
+	{
+		appPath = ".";
+	}
 	ApplicationRunner appRunner(appPath);
 	return appRunner.RunMain();
 }
@@ -17,6 +22,8 @@ int main(int argc, char* argv[])
 ApplicationRunner::ApplicationRunner(std::string appPath)
 {
 	m_appPath = appPath;
+	ShaderSourceLoader::Configure(m_appPath);
+	ProgramBinaryCache::SetDirectory(m_appPath);
 }
 
 /// <summary>
@@ -37,10 +44,31 @@ int ApplicationRunner::RunMain()
 	CoordinateSystems app(this);
 	int ret = app.Run();
 
+	// COORDS, INSTANCED (whole cube field in a single draw call, culled through a BVH since it's this big)
+	//CoordinateSystems app(this, 100000, true);
+	//int ret = app.Run();
+
+	// COORDS, GPU CULLED (a compute shader culls the field and one glMultiDrawElementsIndirect draws it. Needs GL 4.3,
+	// otherwise it's the instanced one above)
+	//CoordinateSystems app(this, 100000, true, true);
+	//int ret = app.Run();
+
 	//Transforms t;
 	//t.SomeVectorShenanigans();
 	//int ret = 0;
 
+	// CPU BENCHMARKS (no window or GL context needed, apart from the uniform lookup check)
+	//CpuBenchmarks benchmarks;
+	//int ret = benchmarks.RunTransformBenchmark();
+	//int ret = benchmarks.RunBvhBenchmark();
+	//int ret = benchmarks.RunRingAllocatorCheck();
+	//int ret = benchmarks.RunRenderQueueSortBenchmark();
+	//int ret = benchmarks.RunMeshProcessingBenchmark();
+	//int ret = benchmarks.RunVertexQuantizationCheck();
+	//int ret = benchmarks.RunFreeListAllocatorCheck();
+	//int ret = benchmarks.RunUniformLookupCheck();
+	//int ret = benchmarks.RunGpuCullingCheck();
+
 	return ret;
 }
 
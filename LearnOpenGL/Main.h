@@ -5,6 +5,10 @@
 #include "TrianglesAndShaders.h"
 #include "Transforms.h"
 #include "CoordinateSystems.h"
+#include "CpuBenchmarks.h"
+#include "PathUtilities.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderSourceLoader.h"
 class ApplicationRunner: IApplicationParamsProvider
 {
 public:
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// <summary>
+/// A read only memory mapping of a whole file. The OS pages the file in as it's read, so there's no copy into a buffer
+/// of our own. The view stays good for as long as this object is alive. Empty files map to an empty view
+/// </summary>
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	// each mapping has exactly one owner
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Maps path. Returns false (and leaves this empty) if it couldn't be opened
+	/// </summary>
+	bool Open(const std::string& path);
+	void Close();
+
+	std::string_view GetView() const { return std::string_view(m_data, m_size); }
+
+	/// <summary>
+	/// The file's last modified time (in whatever units the OS uses, only good for comparing) and size, without opening it.
+	/// Returns false if the file doesn't exist
+	/// </summary>
+	static bool GetFileInfo(const std::string& path, uint64_t& modifiedTime, uint64_t& size);
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,218 @@
+#include "MeshProcessing.h"
+#include <cstring>
+#include <iostream>
+
+#include "Hash.h"
+
+IndexedMesh MeshProcessing::Deduplicate(const float* vertices, size_t vertexCount, size_t floatsPerVertex)
+{
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+    mesh.indices.reserve(vertexCount);
+    const size_t vertexBytes = floatsPerVertex * sizeof(float);
+
+    // an open addressing table of unique vertex indices (+ 1, so 0 means empty), at most half full. Hashes can
+    // collide, so a vertex only matches one with exactly the same bytes
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+    {
+        tableSize *= 2;
+    }
+    std::vector<uint32_t> table(tableSize, 0);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const float* vertex = vertices + i * floatsPerVertex;
+        size_t slot = (size_t)Hash::Fnv1a((const char*)vertex, vertexBytes) & (tableSize - 1);
+        while (table[slot] != 0 && std::memcmp(&mesh.vertices[(table[slot] - 1) * floatsPerVertex], vertex, vertexBytes) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == 0)
+        {
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + floatsPerVertex);
+            table[slot] = (uint32_t)mesh.VertexCount();
+        }
+        mesh.indices.push_back(table[slot] - 1);
+    }
+    return mesh;
+}
+
+void MeshProcessing::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // the triangles using each vertex, packed into one array: vertex v's are adjacency[offsets[v]] up to
+    // adjacency[offsets[v + 1]]. liveCount is how many of them haven't been emitted yet
+    std::vector<uint32_t> liveCount(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        liveCount[index]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        offsets[v + 1] = offsets[v] + liveCount[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    // a vertex is in the cache if fewer than cacheSize vertices have been added since it was. Starting the clock at
+    // cacheSize + 1 makes every vertex's time of 0 count as not in the cache
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<bool> emitted(triangleCount, false);
+    // vertices of recently emitted triangles, to go back to when the current fan runs out of neighbours in the cache
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    size_t cursor = 0;
+
+    int64_t fanVertex = 0;
+    while (fanVertex >= 0)
+    {
+        // emit every triangle around the fan vertex that hasn't been yet
+        candidates.clear();
+        for (uint32_t a = offsets[fanVertex]; a < offsets[fanVertex + 1]; ++a)
+        {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveCount[v]--;
+                if (time - cacheTime[v] > (uint32_t)cacheSize)
+                {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // next, the candidate that's been in the cache longest but will still be there after its own triangles have
+        // been emitted (each of which can push in up to 2 new vertices)
+        fanVertex = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (liveCount[v] == 0)
+            {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveCount[v] <= (uint32_t)cacheSize)
+            {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanVertex = v;
+            }
+        }
+
+        if (fanVertex < 0)
+        {
+            // dead end. Back up to the most recent vertex with triangles left, or failing that, the next one in order
+            while (!deadEnds.empty() && fanVertex < 0)
+            {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveCount[v] > 0)
+                {
+                    fanVertex = v;
+                }
+            }
+            while (fanVertex < 0 && cursor < vertexCount)
+            {
+                if (liveCount[cursor] > 0)
+                {
+                    fanVertex = (int64_t)cursor;
+                }
+                cursor++;
+            }
+        }
+    }
+    indices.swap(output);
+}
+
+void MeshProcessing::OptimizeVertexFetch(IndexedMesh& mesh)
+{
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(mesh.VertexCount(), unused);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    uint32_t nextIndex = 0;
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = nextIndex++;
+            const float* vertex = &mesh.vertices[index * mesh.floatsPerVertex];
+            vertices.insert(vertices.end(), vertex, vertex + mesh.floatsPerVertex);
+        }
+        index = remap[index];
+    }
+    // any vertex no triangle used is dropped
+    mesh.vertices.swap(vertices);
+}
+
+MeshProcessing::CacheStats MeshProcessing::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+    CacheStats stats;
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    size_t usedVertices = 0;
+    for (uint32_t index : indices)
+    {
+        if (cacheTime[index] == 0)
+        {
+            usedVertices++;
+        }
+        if (time - cacheTime[index] > (uint32_t)cacheSize)
+        {
+            cacheTime[index] = time++;
+            stats.transforms++;
+        }
+    }
+    size_t triangleCount = indices.size() / 3;
+    stats.acmr = triangleCount ? (float)stats.transforms / triangleCount : 0.0f;
+    stats.atvr = usedVertices ? (float)stats.transforms / usedVertices : 0.0f;
+    return stats;
+}
+
+IndexedMesh MeshProcessing::Optimize(const float* vertices, size_t vertexCount, size_t floatsPerVertex, const char* name)
+{
+    // as triangle soup, every corner is its own vertex
+    std::vector<uint32_t> soupIndices(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        soupIndices[i] = (uint32_t)i;
+    }
+    CacheStats before = AnalyzeVertexCache(soupIndices, vertexCount);
+
+    IndexedMesh mesh = Deduplicate(vertices, vertexCount, floatsPerVertex);
+    CacheStats deduplicated = AnalyzeVertexCache(mesh.indices, mesh.VertexCount());
+    OptimizeVertexCache(mesh.indices, mesh.VertexCount());
+    OptimizeVertexFetch(mesh);
+    CacheStats after = AnalyzeVertexCache(mesh.indices, mesh.VertexCount());
+
+    std::cout << "Mesh " << name << ": " << vertexCount << " vertices -> " << mesh.VertexCount() << " unique, "
+        << mesh.TriangleCount() << " triangles. ACMR " << before.acmr << " -> " << deduplicated.acmr << " (deduplicated) -> "
+        << after.acmr << " (reordered), ATVR " << before.atvr << " -> " << deduplicated.atvr << " -> " << after.atvr << std::endl;
+    return mesh;
+}
@@ -0,0 +1,27 @@
+#include "PathUtilities.h"
+
+std::string PathUtilities::Join(const std::string& directory, const std::string& name)
+{
+	if (directory.empty())
+	{
+		return name;
+	}
+	char last = directory.back();
+	if (last == '/' || last == '\\')
+	{
+		return directory + name;
+	}
+	return directory + '/' + name;
+}
+
+std::string PathUtilities::GetDirectory(const std::string& path)
+{
+	size_t separator = path.find_last_of("\\/");
+	return separator == std::string::npos ? std::string() : path.substr(0, separator);
+}
+
+std::string PathUtilities::GetFileName(const std::string& path)
+{
+	size_t separator = path.find_last_of("\\/");
+	return separator == std::string::npos ? path : path.substr(separator + 1);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+/// <summary>
+/// The few bits of path handling the app needs, since this project doesn't get std::filesystem. '/' works as a
+/// separator on Windows too, so that's what Join uses, and both kinds are accepted when taking paths apart
+/// </summary>
+class PathUtilities
+{
+public:
+	/// <summary>
+	/// directory + name with exactly one separator between them. An empty directory gives back name as it is
+	/// </summary>
+	static std::string Join(const std::string& directory, const std::string& name);
+
+	/// <summary>
+	/// Everything before the last separator, or an empty string if there isn't one
+	/// </summary>
+	static std::string GetDirectory(const std::string& path);
+
+	/// <summary>
+	/// Everything after the last separator
+	/// </summary>
+	static std::string GetFileName(const std::string& path);
+};
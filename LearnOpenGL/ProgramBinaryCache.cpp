@@ -0,0 +1,180 @@
+#include "ProgramBinaryCache.h"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Hash.h"
+#include "PathUtilities.h"
+
+std::string ProgramBinaryCache::s_directory;
+int ProgramBinaryCache::s_cachedLoads = 0;
+int ProgramBinaryCache::s_compiledLoads = 0;
+double ProgramBinaryCache::s_cachedMilliseconds = 0.0;
+double ProgramBinaryCache::s_compiledMilliseconds = 0.0;
+
+bool ProgramBinaryCache::IsSupported()
+{
+	// only need to ask once, the answer doesn't change for the life of the context
+	static int supported = -1;
+	if (supported == -1)
+	{
+		GLint formatCount = 0;
+		if (glGetProgramBinary != NULL && glProgramBinary != NULL)
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+			// drivers without program binaries reject the enum, so clear that error out of the way
+			while (glGetError() != GL_NO_ERROR) {}
+		}
+		supported = formatCount > 0 ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+uint64_t ProgramBinaryCache::ComputeKey(uint64_t vertexSourceHash, uint64_t fragmentSourceHash)
+{
+	uint64_t hash = Hash::Combine(vertexSourceHash, fragmentSourceHash);
+
+	const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : driverStrings)
+	{
+		const char* value = (const char*)glGetString(name);
+		if (value != NULL)
+		{
+			hash = Hash::Fnv1aPart(value, strlen(value), hash);
+		}
+	}
+	return hash;
+}
+
+void ProgramBinaryCache::SetDirectory(const std::string& directory)
+{
+	s_directory = directory;
+}
+
+std::string ProgramBinaryCache::GetCachePath(uint64_t key)
+{
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "shader_cache_%016llx.bin", (unsigned long long)key);
+	return PathUtilities::Join(s_directory, fileName);
+}
+
+bool ProgramBinaryCache::TryLoad(GLuint program, uint64_t key)
+{
+	if (!IsSupported())
+	{
+		return false;
+	}
+
+	std::string path = GetCachePath(key);
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false; // not cached yet
+	}
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0);
+
+	// the length comes from the file, so check it fits what's actually there before allocating anything for it. A
+	// truncated or corrupt file is just a miss, and gets overwritten once the program's been compiled again
+	FileHeader header;
+	std::vector<char> binary;
+	if (file.read((char*)&header, sizeof(header)) && header.magic == m_fileMagic && header.length <= m_maxBinaryLength
+		&& (std::streamoff)header.length == fileSize - (std::streamoff)sizeof(header))
+	{
+		binary.resize(header.length);
+		file.read(binary.data(), header.length);
+	}
+	if (!file || binary.empty())
+	{
+		std::cout << "WARNING::PROGRAM_BINARY_CACHE::BAD_FILE " << path << std::endl;
+		return false;
+	}
+	file.close();
+
+	glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		// the driver didn't like it, most likely because it was updated since the binary was saved. Get rid of the
+		// file so we don't try it again, and the caller will compile from source and store a fresh one
+		std::cout << "WARNING::PROGRAM_BINARY_CACHE::BINARY_REJECTED " << path << std::endl;
+		std::remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void ProgramBinaryCache::PrepareForStore(GLuint program)
+{
+	if (IsSupported())
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+void ProgramBinaryCache::Store(GLuint program, uint64_t key)
+{
+	if (!IsSupported())
+	{
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+	{
+		return;
+	}
+
+	FileHeader header = { m_fileMagic, (uint32_t)format, (uint32_t)written, 0 };
+	std::string path = GetCachePath(key);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), written);
+	if (!file)
+	{
+		// not the end of the world, we'll just compile again next time
+		std::cout << "WARNING::PROGRAM_BINARY_CACHE::WRITE_FAILED " << path << std::endl;
+	}
+}
+
+void ProgramBinaryCache::RecordProgramLoad(bool fromCache, double milliseconds)
+{
+	if (fromCache)
+	{
+		s_cachedLoads++;
+		s_cachedMilliseconds += milliseconds;
+	}
+	else
+	{
+		s_compiledLoads++;
+		s_compiledMilliseconds += milliseconds;
+	}
+}
+
+void ProgramBinaryCache::PrintStats()
+{
+	std::cout << "Shader programs: " << s_cachedLoads << " from binary cache";
+	if (s_cachedLoads > 0)
+	{
+		std::cout << " (" << s_cachedMilliseconds / s_cachedLoads << " ms each)";
+	}
+	std::cout << ", " << s_compiledLoads << " compiled from source";
+	if (s_compiledLoads > 0)
+	{
+		std::cout << " (" << s_compiledMilliseconds / s_compiledLoads << " ms each)";
+	}
+	std::cout << (IsSupported() ? "" : ", program binaries not supported by this driver") << std::endl;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Saves linked shader programs to disk with glGetProgramBinary, so later launches can skip compiling and linking GLSL
+/// and just hand the driver back its own compiled program with glProgramBinary.
+///
+/// The cache key is a hash of the shader sources plus the GL vendor, renderer and version strings, since a binary is
+/// only good for the exact driver that made it. Even with a matching key the driver is allowed to reject a binary
+/// (e.g. after a driver update that didn't change the version string), so TryLoad checks the link status and the
+/// caller should fall back to compiling from source when it returns false.
+///
+/// Cache files go in the directory given to SetDirectory (the app's directory) as shader_cache_[key].bin
+/// </summary>
+class ProgramBinaryCache
+{
+public:
+	/// <summary>
+	/// Whether the driver can give us program binaries at all. Program binaries are core in GL 4.1, but plenty of
+	/// 3.3 contexts support them too, so this asks for the number of binary formats rather than checking the version
+	/// </summary>
+	static bool IsSupported();
+
+	/// <summary>
+	/// The cache key for a program made from sources with these hashes, on this driver
+	/// </summary>
+	static uint64_t ComputeKey(uint64_t vertexSourceHash, uint64_t fragmentSourceHash);
+
+	/// <summary>
+	/// Loads the cached binary for key into program (which should be freshly created, with nothing attached).
+	/// Returns true if program is now linked and ready to use
+	/// </summary>
+	static bool TryLoad(GLuint program, uint64_t key);
+
+	/// <summary>
+	/// Call before glLinkProgram on a program that's going to be stored. Without it some drivers don't keep the binary around
+	/// </summary>
+	static void PrepareForStore(GLuint program);
+	static void Store(GLuint program, uint64_t key);
+
+	/// <summary>
+	/// Where cache files are read from and written to. Until this is called, that's the working directory
+	/// </summary>
+	static void SetDirectory(const std::string& directory);
+
+	/// <summary>
+	/// Prints how many programs came from the cache vs were compiled, and how long each took on average.
+	/// Run twice to compare: the first (cold) run compiles everything and fills the cache, the second (warm) run shouldn't compile anything
+	/// </summary>
+	static void PrintStats();
+	static void RecordProgramLoad(bool fromCache, double milliseconds);
+
+private:
+	static std::string GetCachePath(uint64_t key);
+
+	// what's at the start of every cache file, so truncated or foreign files get ignored instead of handed to the driver
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t format;
+		uint32_t length;
+		uint32_t reserved;
+	};
+	static constexpr uint32_t m_fileMagic = 0x42505347; // "GSPB"
+	// real binaries are well under a megabyte. Anything claiming to be bigger than this is a broken file
+	static constexpr uint32_t m_maxBinaryLength = 64 * 1024 * 1024;
+
+	static std::string s_directory;
+	static int s_cachedLoads;
+	static int s_compiledLoads;
+	static double s_cachedMilliseconds;
+	static double s_compiledMilliseconds;
+};
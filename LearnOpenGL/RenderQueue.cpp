@@ -0,0 +1,187 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+#include "GLStateCache.h"
+
+uint64_t RenderQueue::MakeKey(GLuint program, const GLuint* textures, int textureCount, GLuint vertexArray, float depth)
+{
+	// FNV-1a over the names, folded down to 16 bits
+	uint32_t textureHash = 2166136261u;
+	for (int i = 0; i < textureCount; ++i)
+	{
+		textureHash = (textureHash ^ textures[i]) * 16777619u;
+	}
+	textureHash = (textureHash >> 16) ^ (textureHash & 0xFFFF);
+
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+	uint64_t depthBits = (uint64_t)(depth * (float)0xFFFFFF);
+
+	return ((uint64_t)(program & 0xFFF) << 52)
+		| ((uint64_t)textureHash << 36)
+		| ((uint64_t)(vertexArray & 0xFFF) << 24)
+		| depthBits;
+}
+
+void RenderQueue::Submit(Command command, float depth)
+{
+	command.key = MakeKey(command.shader->ID, command.textures, MaxTextures, command.vertexArray, depth);
+	m_commands.push_back(command);
+}
+
+void RenderQueue::Clear()
+{
+	m_commands.clear();
+}
+
+size_t RenderQueue::GetIndexSize(GLenum indexType)
+{
+	switch (indexType)
+	{
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	case GL_UNSIGNED_INT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+size_t RenderQueue::CountStateChanges(const Command& previous, const Command& next)
+{
+	size_t changes = 0;
+	if (previous.shader->ID != next.shader->ID) changes++;
+	if (previous.vertexArray != next.vertexArray) changes++;
+	for (int i = 0; i < MaxTextures; ++i)
+	{
+		if (previous.textures[i] != next.textures[i]) changes++;
+	}
+	return changes;
+}
+
+void RenderQueue::RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+{
+	const size_t count = entries.size();
+	scratch.resize(count);
+
+	// count every byte of every key in one go, so each pass below only has to move entries
+	static thread_local size_t histograms[8][256];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (const SortEntry& entry : entries)
+	{
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	SortEntry* source = entries.data();
+	SortEntry* destination = scratch.data();
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		size_t* histogram = histograms[pass];
+		// if every key has the same byte here, this pass wouldn't move anything
+		if (count == 0 || histogram[(source[0].key >> (pass * 8)) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// turn the counts into where each bucket starts
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; ++bucket)
+		{
+			size_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	// an odd number of passes leaves the result in scratch
+	if (source != entries.data())
+	{
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::Execute()
+{
+	m_lastStats = Stats();
+	m_lastStats.commands = m_commands.size();
+	if (m_commands.empty())
+	{
+		return;
+	}
+
+	m_order.resize(m_commands.size());
+	for (size_t i = 0; i < m_commands.size(); ++i)
+	{
+		m_order[i] = SortEntry{ m_commands[i].key, (uint32_t)i };
+		if (i > 0)
+		{
+			m_lastStats.stateChangesUnsorted += CountStateChanges(m_commands[i - 1], m_commands[i]);
+		}
+	}
+	RadixSort(m_order, m_scratch);
+
+	const Command* previous = nullptr;
+	for (const SortEntry& entry : m_order)
+	{
+		const Command& command = m_commands[entry.index];
+		if (previous)
+		{
+			m_lastStats.stateChangesSorted += CountStateChanges(*previous, command);
+		}
+		previous = &command;
+
+		// the state cache skips whatever's already set, which after sorting is most of it
+		command.shader->use();
+		for (int i = 0; i < MaxTextures; ++i)
+		{
+			if (command.textures[i] != 0)
+			{
+				GLStateCache::BindTextureUnit(i, GL_TEXTURE_2D, command.textures[i]);
+			}
+		}
+		GLStateCache::BindVertexArray(command.vertexArray);
+		if (command.matrix && command.matrixUniform.isValid())
+		{
+			command.shader->setMat4(command.matrixUniform, command.matrix);
+		}
+		if (command.floatUniform.isValid())
+		{
+			command.shader->setFloat(command.floatUniform, command.floatValue);
+		}
+
+		if (command.indexType == GL_NONE)
+		{
+			if (command.instanceCount == 1)
+			{
+				glDrawArrays(command.mode, command.first, command.count);
+			}
+			else
+			{
+				glDrawArraysInstanced(command.mode, command.first, command.count, command.instanceCount);
+			}
+		}
+		else
+		{
+			const void* indexOffset = (const void*)((size_t)command.first * GetIndexSize(command.indexType));
+			if (command.instanceCount == 1)
+			{
+				glDrawElementsBaseVertex(command.mode, command.count, command.indexType, indexOffset, command.baseVertex);
+			}
+			else
+			{
+				glDrawElementsInstancedBaseVertex(command.mode, command.count, command.indexType, indexOffset, command.instanceCount, command.baseVertex);
+			}
+		}
+	}
+	m_commands.clear();
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+#include "Shader.h"
+
+/// <summary>
+/// Collects a frame's draws as small commands instead of issuing them as the code gets to them, sorts them by a 64 bit
+/// key so draws that share a program, textures and VAO end up next to each other, and then issues them in that order
+/// through GLStateCache, so only the state that actually changes between neighbours gets set.
+///
+/// The key, from the most significant bits down (see MakeKey):
+///   program  12 bits: switching programs is the most expensive change, so it's what everything is grouped by first
+///   textures 16 bits: a hash of the texture names, since there can be more than one
+///   VAO      12 bits
+///   depth    24 bits: front to back within the same state, so the depth test throws away more hidden fragments
+/// GL names are small numbers handed out in order, so they're just masked to fit. Two names that collide only means
+/// those draws might not be grouped together, the state each command sets is still its own.
+///
+/// The keys are radix sorted, which is linear in the number of commands rather than n log n, and skips any byte all
+/// the keys agree on (the program byte, in a scene with one program)
+/// </summary>
+class RenderQueue
+{
+public:
+	static constexpr int MaxTextures = 2;
+
+	struct Command
+	{
+		uint64_t key = 0;
+		Shader* shader = nullptr;
+		// only the name, so every command drawing from one VAO reads the same buffers, whatever VertexArrayCache last
+		// attached to it. That's why every mesh of a vertex format has to come from one GeometryPool
+		GLuint vertexArray = 0;
+		// bound to units 0 and up. 0 means leave that unit alone
+		GLuint textures[MaxTextures] = {};
+		GLenum mode = GL_TRIANGLES;
+		// GL_NONE for glDrawArrays, otherwise the type of the indices in the VAO's element buffer
+		GLenum indexType = GL_NONE;
+		GLsizei count = 0;
+		GLsizei instanceCount = 1;
+		// the first index in the element buffer (or the first vertex, for glDrawArrays), and what's added to every
+		// index. Lets meshes that share buffers (see GeometryPool) be drawn without binding anything else
+		GLuint first = 0;
+		GLint baseVertex = 0;
+		// set on the program before the draw if valid. The matrix isn't copied, so it has to stay put until Execute
+		UniformHandle matrixUniform;
+		const GLfloat* matrix = nullptr;
+		// same for one float. Draws that share a program can still each have their own value this way
+		UniformHandle floatUniform;
+		GLfloat floatValue = 0.0f;
+	};
+
+	// a key and where its command is, which is all the sort moves around
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	struct Stats
+	{
+		size_t commands = 0;
+		// how many times the program, textures or VAO would change from one command to the next, in the order the
+		// commands were submitted and in sorted order
+		size_t stateChangesUnsorted = 0;
+		size_t stateChangesSorted = 0;
+	};
+
+	/// <summary>
+	/// depth is the distance from the camera divided by the far plane distance, and gets clamped to [0, 1]
+	/// </summary>
+	static uint64_t MakeKey(GLuint program, const GLuint* textures, int textureCount, GLuint vertexArray, float depth);
+
+	/// <summary>
+	/// Fills in the key from the command's own state, so commands only need to say how far away they are
+	/// </summary>
+	void Submit(Command command, float depth);
+	/// <summary>
+	/// Sorts and issues everything submitted since the last Execute, then empties the queue
+	/// </summary>
+	void Execute();
+	void Clear();
+
+	size_t Size() const { return m_commands.size(); }
+	const Stats& GetLastStats() const { return m_lastStats; }
+
+	/// <summary>
+	/// Least significant byte first radix sort of entries by key. Stable, and only uses scratch as temporary storage.
+	/// Public so CpuBenchmarks can check it against std::sort
+	/// </summary>
+	static void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+private:
+	std::vector<Command> m_commands;
+	std::vector<SortEntry> m_order;
+	std::vector<SortEntry> m_scratch;
+	Stats m_lastStats;
+
+	static size_t CountStateChanges(const Command& previous, const Command& next);
+	/// <summary>
+	/// Bytes per index for the three types glDrawElements takes, 0 for anything else (which the draw then rejects)
+	/// </summary>
+	static size_t GetIndexSize(GLenum indexType);
+};
@@ -0,0 +1,69 @@
+#include "RingAllocator.h"
+
+RingAllocator::RingAllocator(size_t capacity)
+{
+	Reset(capacity);
+}
+
+void RingAllocator::Reset(size_t capacity)
+{
+	m_capacity = capacity;
+	m_head = 0;
+	m_used = 0;
+	m_unsubmitted = 0;
+	m_wraps = 0;
+	m_regions.clear();
+}
+
+size_t RingAllocator::Allocate(size_t size, size_t alignment)
+{
+	size_t start = (m_head + alignment - 1) & ~(alignment - 1);
+	bool wraps = start + size > m_capacity;
+	if (wraps)
+	{
+		start = 0;
+	}
+
+	// everything in use is one run ending at m_head, so what's free is one run starting there. The new allocation
+	// needs everything from m_head up to its end (skipping to the start of the ring if it wraps)
+	size_t needed = wraps ? (m_capacity - m_head) + size : start + size - m_head;
+	if (size > m_capacity || needed > m_capacity - m_used)
+	{
+		return InvalidOffset;
+	}
+
+	if (wraps)
+	{
+		m_wraps++;
+	}
+	m_head = start + size;
+	if (m_head == m_capacity)
+	{
+		m_head = 0;
+	}
+	m_used += needed;
+	m_unsubmitted += needed;
+	return start;
+}
+
+void RingAllocator::Submit(uint64_t fence)
+{
+	if (m_unsubmitted == 0)
+	{
+		return;
+	}
+	m_regions.push_back(Region{ m_unsubmitted, fence });
+	m_unsubmitted = 0;
+}
+
+void RingAllocator::ReleaseOldest()
+{
+	m_used -= m_regions.front().bytes;
+	m_regions.pop_front();
+	if (m_used == 0)
+	{
+		// nothing is in use, so start again from the beginning rather than leave a gap at the end that a big allocation
+		// would have to skip
+		m_head = 0;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+/// <summary>
+/// The bookkeeping half of a streaming ring buffer, with no GL in it so it can be checked on the CPU (see
+/// CpuBenchmarks::RunRingAllocatorCheck).
+///
+/// Allocations are handed out one after another from a fixed size range, wrapping back to the start when they reach
+/// the end. An allocation never straddles the end: if it doesn't fit in what's left, that bit is skipped. Nothing is
+/// freed on its own. Instead, everything allocated between two calls to Submit forms one region, tagged with a fence
+/// (any value the caller likes, e.g. a GLsync), and regions are given back oldest first with ReleaseOldest once the
+/// caller knows their fence has passed. So memory is only reused after whoever was reading it is done
+/// </summary>
+class RingAllocator
+{
+public:
+	static constexpr size_t InvalidOffset = ~(size_t)0;
+
+	RingAllocator(size_t capacity = 0);
+	void Reset(size_t capacity);
+
+	/// <summary>
+	/// Returns the offset of size free bytes aligned to alignment (a power of two), or InvalidOffset if there isn't
+	/// room until more regions are released
+	/// </summary>
+	size_t Allocate(size_t size, size_t alignment = 1);
+
+	/// <summary>
+	/// Closes the current region: everything allocated since the last Submit stays in use until this fence is released.
+	/// Does nothing (and keeps nothing) if nothing was allocated since, so check GetUnsubmittedBytes before making a fence
+	/// </summary>
+	void Submit(uint64_t fence);
+
+	bool HasSubmittedRegions() const { return !m_regions.empty(); }
+	uint64_t GetOldestFence() const { return m_regions.front().fence; }
+	void ReleaseOldest();
+
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetUsedBytes() const { return m_used; }
+	// bytes allocated since the last Submit, including alignment padding and anything skipped at the end
+	size_t GetUnsubmittedBytes() const { return m_unsubmitted; }
+	uint64_t GetWrapCount() const { return m_wraps; }
+
+private:
+	struct Region
+	{
+		size_t bytes;
+		uint64_t fence;
+	};
+
+	size_t m_capacity = 0;
+	// where the next allocation starts
+	size_t m_head = 0;
+	// bytes between the start of the oldest unreleased region and m_head, going around the ring
+	size_t m_used = 0;
+	size_t m_unsubmitted = 0;
+	uint64_t m_wraps = 0;
+	std::deque<Region> m_regions;
+};
@@ -1,116 +1,743 @@
 #include "Shader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <GLFW/glfw3.h>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#include "CameraUniformBuffer.h"
+#include "GLStateCache.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderLoader.h"
+
+// GL_KHR_parallel_shader_compile isn't part of core GL, so glad doesn't know about it. The ARB version of the
+// extension has the same values
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (*MaxShaderCompilerThreadsFunction)(GLuint count);
+
+size_t Shader::s_uniformLocationLookups = 0;
+bool Shader::s_parallelCompileChecked = false;
+bool Shader::s_parallelCompileSupported = false;
+int Shader::s_pendingPrograms = 0;
+int Shader::s_asyncPrograms = 0;
+double Shader::s_firstSubmitTime = 0.0;
+bool Shader::s_startupStatsPrinted = false;
+unsigned int Shader::s_placeholderProgram = 0;
+bool Shader::s_keepUniformValues = false;
+
+// shown in place of programs that are still compiling. The uniforms default to identity so that it still draws in
+// roughly the right place whichever of them the real shader uses
+static const char* s_placeholderVertexSource = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 model = mat4(1.0);
+uniform mat4 view = mat4(1.0);
+uniform mat4 projection = mat4(1.0);
+uniform mat4 transform = mat4(1.0);
+void main()
+{
+	gl_Position = projection * view * model * transform * vec4(aPos, 1.0);
+}
+)";
+static const char* s_placeholderFragmentSource = R"(#version 330 core
+out vec4 FragColor;
+void main()
+{
+	FragColor = vec4(1.0, 0.0, 1.0, 1.0);
+}
+)";
+// the placeholder's uniforms, and where they are. Matrices set on a pending program with these names get passed on
+static const char* s_placeholderUniformNames[] = { "model", "view", "projection", "transform" };
+static GLint s_placeholderUniformLocations[] = { -1, -1, -1, -1 };
+
+Shader::Shader(const char* vertexName, const char* fragmentName, bool async)
 {
-	std::string vertexCode;
-	std::string fragmentCode;
+	init(readSource(vertexName, fragmentName), async);
+}
 
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
+Shader::Shader(const ShaderSource& source, bool async)
+{
+	init(source, async);
+}
 
-	// allow the input file streams to throw exceptions 
-	// failbit is for errors that don't necessarily mean further operations will fail
-	// badbit is for errors that do
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
+Shader::~Shader()
+{
+	if (m_pending)
 	{
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		vShaderStream << vShaderFile.rdbuf(); // rdbuf gives pointer to the buffer object associated w/ the stream
-		fShaderStream << fShaderFile.rdbuf();
-		vShaderFile.close();
-		fShaderFile.close();
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		// destroyed before anyone waited for it. The compile may still be going, but deleting the shader objects (which
+		// the members do on their own) is fine either way
+		s_pendingPrograms--;
 	}
-	catch(std::ifstream::failure e)
+	GLStateCache::DeleteProgram(ID);
+}
+
+ShaderSource Shader::readSource(const char* vertexName, const char* fragmentName, const std::vector<std::string>& defines)
+{
+	ShaderSource source;
+	source.vertex = ShaderSourceLoader::AddDefines(ShaderSourceLoader::Load(vertexName), defines);
+	source.fragment = ShaderSourceLoader::AddDefines(ShaderSourceLoader::Load(fragmentName), defines);
+	return source;
+}
+
+void Shader::init(const ShaderSource& source, bool async)
+{
+	if (!source.isValid())
+	{
+		// the loader already said what went wrong. Leave an empty program behind, same as a failed compile would
+		ID = createProgram();
+		return;
+	}
+
+	// a binary from a previous run is much faster to load than compiling and linking the GLSL again
+	double start = getTimeMilliseconds();
+	m_cacheKey = ProgramBinaryCache::ComputeKey(source.vertex->hash, source.fragment->hash);
+	if (async && s_asyncPrograms == 0)
 	{
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << e.what() << std::endl;
+		s_firstSubmitTime = start;
 	}
+	ID = createProgram();
+	if (ProgramBinaryCache::TryLoad(ID, m_cacheKey))
+	{
+		reflectUniforms();
+		m_loadMilliseconds = getTimeMilliseconds() - start;
+		ProgramBinaryCache::RecordProgramLoad(true, m_loadMilliseconds);
+		if (async)
+		{
+			s_asyncPrograms++;
+		}
+		return;
+	}
+
+	// a rejected binary can leave the program in a bad state, so start again with a fresh one
+	GLStateCache::DeleteProgram(ID);
+	ID = createProgram();
+	if (async)
+	{
+		// just hand it to the driver. Nothing here waits for the compile, that happens when the program is first needed
+		initParallelCompile();
+		s_asyncPrograms++;
+		s_pendingPrograms++;
+		submitCompile(source);
+		m_pending = true;
+		m_submitTime = start;
+		return;
+	}
+
+	submitCompile(source);
+	finishCompile();
+	reflectUniforms();
+	m_loadMilliseconds = getTimeMilliseconds() - start;
+	ProgramBinaryCache::RecordProgramLoad(false, m_loadMilliseconds);
+}
+
+/// <summary>
+/// Starts compiling both shaders and linking them into ID. None of this needs to wait for the driver: nothing here asks
+/// for a result, so the driver is free to do the actual work later or on another thread
+/// </summary>
+void Shader::submitCompile(const ShaderSource& source)
+{
+	m_vertexShader.Create("Shader vertex shader", GL_VERTEX_SHADER);
+	ShaderLoader::SetSource(m_vertexShader.Get(), *source.vertex);
+	glCompileShader(m_vertexShader.Get());
+
+	m_fragmentShader.Create("Shader fragment shader", GL_FRAGMENT_SHADER);
+	ShaderLoader::SetSource(m_fragmentShader.Get(), *source.fragment);
+	glCompileShader(m_fragmentShader.Get());
+
+	glAttachShader(ID, m_vertexShader.Get());
+	glAttachShader(ID, m_fragmentShader.Get());
+	ProgramBinaryCache::PrepareForStore(ID);
+	glLinkProgram(ID);
+}
 
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
-	
-	unsigned int vertex, fragment;
+/// <summary>
+/// Waits for the link to finish (if it hasn't already), prints any errors and saves the binary. Returns whether the link worked
+/// </summary>
+bool Shader::finishCompile()
+{
 	int success;
 	char infoLog[512];
 
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(m_vertexShader.Get(), GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(m_vertexShader.Get(), 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
 	};
-	
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    };
-
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
+
+	glGetShaderiv(m_fragmentShader.Get(), GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(m_fragmentShader.Get(), 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+	};
+
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
 	if (!success)
 	{
 		glGetProgramInfoLog(ID, 512, NULL, infoLog);
 		std::cout << "ERROR:SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 	}
+	else
+	{
+		ProgramBinaryCache::Store(ID, m_cacheKey);
+	}
 
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-	
+	m_vertexShader.Reset();
+	m_fragmentShader.Reset();
+	return success != 0;
+}
+
+/// <summary>
+/// Finishes an async program off: gets the results, works out where the uniforms are, and applies everything that was
+/// set on it while it was compiling
+/// </summary>
+void Shader::finishPending()
+{
+	finishCompile();
+	reflectUniforms();
+	m_pending = false;
+
+	applyStoredUniforms();
+	if (!s_keepUniformValues)
+	{
+		m_uniformValues.clear();
+	}
+
+	// this counts the time the program spent waiting to be used as well, since that's when we find out it's done
+	s_pendingPrograms--;
+	m_loadMilliseconds = getTimeMilliseconds() - m_submitTime;
+	ProgramBinaryCache::RecordProgramLoad(false, m_loadMilliseconds);
+}
+
+bool Shader::isReady()
+{
+	if (!m_pending)
+	{
+		return true;
+	}
+	if (s_parallelCompileSupported)
+	{
+		// the one query that's guaranteed not to wait for the compiler
+		GLint complete = GL_FALSE;
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+		if (!complete)
+		{
+			return false;
+		}
+	}
+	finishPending();
+	return true;
+}
+
+void Shader::waitUntilReady()
+{
+	if (m_pending)
+	{
+		finishPending();
+	}
+}
+
+bool Shader::reload(const ShaderSource& source)
+{
+	waitUntilReady();
+	if (!source.isValid())
+	{
+		std::cout << "ERROR::SHADER::RELOAD_FAILED keeping the previous program" << std::endl;
+		return false;
+	}
+	double start = getTimeMilliseconds();
+
+	// build the new program off to the side, so if it doesn't work nothing has changed
+	unsigned int oldID = ID;
+	m_cacheKey = ProgramBinaryCache::ComputeKey(source.vertex->hash, source.fragment->hash);
+	ID = createProgram();
+	bool fromCache = ProgramBinaryCache::TryLoad(ID, m_cacheKey);
+	bool linked = fromCache;
+	if (!fromCache)
+	{
+		GLStateCache::DeleteProgram(ID);
+		ID = createProgram();
+		submitCompile(source);
+		linked = finishCompile();
+	}
+	if (!linked)
+	{
+		std::cout << "ERROR::SHADER::RELOAD_FAILED keeping the previous program" << std::endl;
+		GLStateCache::DeleteProgram(ID);
+		ID = oldID;
+		return false;
+	}
+	GLStateCache::DeleteProgram(oldID);
+
+	// forget everything about the old program's uniforms except their names, so they keep their indices
+	for (UniformInfo& info : m_uniforms)
+	{
+		info.location = -1;
+		info.type = GL_NONE;
+	}
+	reflectUniforms();
+	applyStoredUniforms();
+
+	m_loadMilliseconds = getTimeMilliseconds() - start;
+	ProgramBinaryCache::RecordProgramLoad(fromCache, m_loadMilliseconds);
+	return true;
+}
+
+/// <summary>
+/// Turns on GL_KHR_parallel_shader_compile (or the ARB version) if the driver has it. By default drivers are allowed
+/// to compile on a single thread even with the extension, so this also asks for as many compiler threads as it likes
+/// </summary>
+void Shader::initParallelCompile()
+{
+	if (s_parallelCompileChecked)
+	{
+		return;
+	}
+	s_parallelCompileChecked = true;
+
+	MaxShaderCompilerThreadsFunction maxShaderCompilerThreads = NULL;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+	{
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+	{
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	if (maxShaderCompilerThreads != NULL)
+	{
+		maxShaderCompilerThreads(0xFFFFFFFF);
+		s_parallelCompileSupported = true;
+	}
+	std::cout << "Parallel shader compile: " << (s_parallelCompileSupported ? "supported" : "not supported, programs will be finished on first use") << std::endl;
+}
+
+unsigned int Shader::createProgram()
+{
+	return GLResourceRegistry::Track(GLResourceType::Program, glCreateProgram(), "Shader");
+}
+
+void Shader::deletePlaceholder()
+{
+	if (s_placeholderProgram != 0)
+	{
+		GLStateCache::DeleteProgram(s_placeholderProgram);
+		s_placeholderProgram = 0;
+	}
+}
+
+/// <summary>
+/// Binds the placeholder program, making it first if this is the first time it's needed. It's tiny, so compiling it
+/// right here doesn't hold anything up for long
+/// </summary>
+void Shader::usePlaceholder()
+{
+	if (s_placeholderProgram == 0)
+	{
+		// the shader objects only need to live until the program is linked
+		GLShaderObject vertex;
+		vertex.Create("Shader placeholder vertex shader", GL_VERTEX_SHADER);
+		glShaderSource(vertex.Get(), 1, &s_placeholderVertexSource, NULL);
+		glCompileShader(vertex.Get());
+		GLShaderObject fragment;
+		fragment.Create("Shader placeholder fragment shader", GL_FRAGMENT_SHADER);
+		glShaderSource(fragment.Get(), 1, &s_placeholderFragmentSource, NULL);
+		glCompileShader(fragment.Get());
+
+		s_placeholderProgram = GLResourceRegistry::Track(GLResourceType::Program, glCreateProgram(), "Shader placeholder");
+		glAttachShader(s_placeholderProgram, vertex.Get());
+		glAttachShader(s_placeholderProgram, fragment.Get());
+		glLinkProgram(s_placeholderProgram);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			s_placeholderUniformLocations[i] = glGetUniformLocation(s_placeholderProgram, s_placeholderUniformNames[i]);
+		}
+	}
+	GLStateCache::UseProgram(s_placeholderProgram);
+}
+
+/// <summary>
+/// Prints how long it took from submitting the first async program to all of them being ready, once they all are.
+/// With parallel compiles that should be about as long as the slowest one takes, rather than all of them added up
+/// </summary>
+void Shader::printStartupStats()
+{
+	if (s_startupStatsPrinted || s_asyncPrograms == 0 || s_pendingPrograms > 0)
+	{
+		return;
+	}
+	s_startupStatsPrinted = true;
+	std::cout << "All " << s_asyncPrograms << " shader programs ready " << getTimeMilliseconds() - s_firstSubmitTime
+		<< " ms after the first was submitted" << std::endl;
+	ProgramBinaryCache::PrintStats();
+}
+
+double Shader::getTimeMilliseconds()
+{
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now().time_since_epoch();
+	return time.count();
+}
+
+/// <summary>
+/// Uniform blocks shared between programs each get a fixed binding point, so their buffers can be bound once for every
+/// program. GLSL 3.30 can't say layout(binding = N) in the shader, so it has to be done here, every time the program
+/// is (re)linked. Programs without the block just don't find it
+/// </summary>
+void Shader::bindUniformBlocks()
+{
+	static const std::pair<const char*, GLuint> sharedBlocks[] = {
+		{ CameraUniforms::BlockName, CameraUniforms::BindingPoint },
+	};
+	for (const auto& block : sharedBlocks)
+	{
+		GLuint blockIndex = glGetUniformBlockIndex(ID, block.first);
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(ID, blockIndex, block.second);
+		}
+	}
+}
+
+/// <summary>
+/// Asks the linked program for all of its active uniforms and puts them in m_uniforms, so that none of the set functions
+/// ever have to ask the driver for a location by name. That lookup is a string compare inside the driver, and it was being
+/// done once per cube per frame for "model".
+///
+/// If the program was compiled async, handles may have been given out for names before this ran. Those entries keep
+/// their index and just get filled in here, so the handles stay good
+/// </summary>
+void Shader::reflectUniforms()
+{
+	bindUniformBlocks();
+	size_t requestedCount = m_uniforms.size();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+	for (GLint i = 0; i < uniformCount; ++i)
+	{
+		GLsizei nameLength = 0;
+		UniformInfo info;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &info.size, &info.type, nameBuffer.data());
+		info.name.assign(nameBuffer.data(), nameLength);
+
+		// the index of an active uniform isn't its location, so this one lookup per uniform is still needed.
+		// Uniforms inside uniform blocks come back as -1, which is fine since they aren't set this way anyway
+		info.location = glGetUniformLocation(ID, info.name.c_str());
+		info.expectedType = GL_NONE;
+
+		// arrays are reported as "name[0]", but people usually set them with just "name"
+		std::string arrayName;
+		size_t bracket = info.name.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == info.name.size())
+		{
+			arrayName = info.name.substr(0, bracket);
+		}
+
+		bool requested = false;
+		for (const std::string& name : { info.name, arrayName })
+		{
+			auto found = name.empty() ? m_uniformIndices.end() : m_uniformIndices.find(name);
+			if (found != m_uniformIndices.end() && found->second >= 0)
+			{
+				UniformInfo& entry = m_uniforms[found->second];
+				entry.location = info.location;
+				entry.type = info.type;
+				entry.size = info.size;
+				checkUniformType(found->second);
+				requested = true;
+			}
+		}
+		if (!requested)
+		{
+			int index = (int)m_uniforms.size();
+			m_uniforms.push_back(info);
+			m_uniformIndices[info.name] = index;
+			if (!arrayName.empty())
+			{
+				m_uniformIndices[arrayName] = index;
+			}
+		}
+	}
+
+	// anything asked for early that still isn't filled in is either an array element or something the program
+	// doesn't have, same as the getUniformHandle fallback
+	for (size_t i = 0; i < requestedCount; ++i)
+	{
+		UniformInfo& entry = m_uniforms[i];
+		if (entry.type == GL_NONE && entry.location == -1)
+		{
+			entry.location = glGetUniformLocation(ID, entry.name.c_str());
+			s_uniformLocationLookups++;
+		}
+	}
+}
+
+UniformHandle Shader::getUniformHandle(const std::string& name, GLenum expectedType) const
+{
+	UniformHandle handle;
+	auto found = m_uniformIndices.find(name);
+	if (found != m_uniformIndices.end())
+	{
+		handle.index = found->second;
+		if (handle.isValid() && expectedType != GL_NONE)
+		{
+			m_uniforms[handle.index].expectedType = expectedType;
+			checkUniformType(handle.index);
+		}
+		return handle;
+	}
+
+	if (m_pending)
+	{
+		// we don't know anything about the uniforms yet. Give out a handle now, and reflectUniforms fills it in later
+		handle.index = (int)m_uniforms.size();
+		m_uniforms.push_back(UniformInfo{ name, -1, GL_NONE, 0, expectedType });
+		m_uniformIndices[name] = handle.index;
+		return handle;
+	}
+
+	// not in the table. Either it's an element of an array other than the first (those aren't listed by
+	// glGetActiveUniform), or the program doesn't have it. Ask the driver once and remember the answer either way
+	GLint location = glGetUniformLocation(ID, name.c_str());
+	s_uniformLocationLookups++;
+	if (location != -1)
+	{
+		handle.index = (int)m_uniforms.size();
+		m_uniforms.push_back(UniformInfo{ name, location, GL_NONE, 1, expectedType });
+	}
+	m_uniformIndices[name] = handle.index;
+	return handle;
+}
+
+void Shader::checkUniformType(int index) const
+{
+	const UniformInfo& info = m_uniforms[index];
+	if (info.expectedType != GL_NONE && info.type != GL_NONE && info.type != info.expectedType)
+	{
+		std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH " << info.name << " is 0x" << std::hex << info.type
+			<< ", expected 0x" << info.expectedType << std::dec << std::endl;
+	}
+}
+
+GLint Shader::getLocation(UniformHandle handle) const
+{
+	return handle.isValid() ? m_uniforms[handle.index].location : -1;
+}
+
+size_t Shader::getUniformLocationLookupCount()
+{
+	return s_uniformLocationLookups;
 }
 
 void Shader::use()
 {
-	glUseProgram(ID);
+	if (isReady())
+	{
+		GLStateCache::UseProgram(ID);
+		printStartupStats();
+	}
+	else
+	{
+		usePlaceholder();
+	}
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+/// <summary>
+/// Remembers the value just set on a uniform, replacing whatever was set on it before. While the program is compiling,
+/// matrices that the placeholder also has are passed on to it too, so things still move around while it's showing.
+/// Whatever program is bound right now might not be the placeholder, so those go straight to it with
+/// glProgramUniform on 4.1 and up, and otherwise by binding it just for the upload
+/// </summary>
+void Shader::storeUniform(const UniformValue& value) const
+{
+	if (value.index < 0)
+	{
+		return;
+	}
+
+	auto existing = std::find_if(m_uniformValues.begin(), m_uniformValues.end(),
+		[&](const UniformValue& other) { return other.index == value.index; });
+	if (existing != m_uniformValues.end())
+	{
+		*existing = value;
+	}
+	else
+	{
+		m_uniformValues.push_back(value);
+	}
+
+	if (m_pending && value.type == GL_FLOAT_MAT4 && s_placeholderProgram != 0)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			if (m_uniforms[value.index].name != s_placeholderUniformNames[i])
+			{
+				continue;
+			}
+			if (GLAD_GL_VERSION_4_1)
+			{
+				glProgramUniformMatrix4fv(s_placeholderProgram, s_placeholderUniformLocations[i], 1, GL_FALSE, value.floatValues);
+			}
+			else
+			{
+				GLuint previousProgram = GLStateCache::GetProgram();
+				GLStateCache::UseProgram(s_placeholderProgram);
+				applyUniform(s_placeholderUniformLocations[i], value);
+				GLStateCache::UseProgram(previousProgram);
+			}
+		}
+	}
+}
+
+void Shader::applyStoredUniforms()
 {
-	// this thing will return -1 if the uniform is optimized away or you spelt it incorrectly
-	int loc = glGetUniformLocation(ID, name.c_str());
+	if (m_uniformValues.empty())
+	{
+		return;
+	}
+	GLStateCache::UseProgram(ID);
+	for (const UniformValue& value : m_uniformValues)
+	{
+		applyUniform(getLocation(UniformHandle{ value.index }), value);
+	}
+}
+
+void Shader::setKeepUniformValues(bool keep)
+{
+	s_keepUniformValues = keep;
+}
 
-	glUniform1i(loc, (int) value); // I guess there's no uniform set for bool, you just have to use int?
+void Shader::applyUniform(GLint location, const UniformValue& value)
+{
+	switch (value.type)
+	{
+	case GL_INT:
+		glUniform1i(location, value.intValue);
+		break;
+	case GL_FLOAT:
+		glUniform1f(location, value.floatValues[0]);
+		break;
+	case GL_FLOAT_VEC2:
+		glUniform2f(location, value.floatValues[0], value.floatValues[1]);
+		break;
+	case GL_FLOAT_VEC4:
+		glUniform4f(location, value.floatValues[0], value.floatValues[1], value.floatValues[2], value.floatValues[3]);
+		break;
+	case GL_FLOAT_MAT4:
+		glUniformMatrix4fv(location, 1, GL_FALSE, value.floatValues);
+		break;
+	}
+}
+
+void Shader::setBool(const std::string& name, bool value) const
+{
+	// this will be -1 if the uniform is optimized away or you spelt it incorrectly
+	setBool(getUniformHandle(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-	int loc = glGetUniformLocation(ID, name.c_str());
-	glUniform1i(loc, value);
+	setInt(getUniformHandle(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-	int loc = glGetUniformLocation(ID, name.c_str());
-	glUniform1f(loc, value);
+	setFloat(getUniformHandle(name), value);
 }
 
 void Shader::setFloat2(const std::string& name, float value1, float value2)
 {
-	int loc = glGetUniformLocation(ID, name.c_str());
-	glUniform2f(loc, value1, value2);
+	setFloat2(getUniformHandle(name), value1, value2);
 }
 
 void Shader::setFloat4(const std::string& name, float value1, float value2, float value3, float value4)
 {
-	int loc = glGetUniformLocation(ID, name.c_str());
-	glUniform4f(loc, value1, value2, value3, value4);
+	setFloat4(getUniformHandle(name), value1, value2, value3, value4);
 }
 
 void Shader::setMat4(const std::string& name, const GLfloat* matrix)
 {
-	unsigned int loc = glGetUniformLocation(ID, name.c_str());
-	glUniformMatrix4fv(loc, 1, GL_FALSE, matrix);
+	setMat4(getUniformHandle(name), matrix);
+}
+
+void Shader::setBool(UniformHandle handle, bool value) const
+{
+	setInt(handle, (int) value); // I guess there's no uniform set for bool, you just have to use int?
+}
+
+void Shader::setInt(UniformHandle handle, int value) const
+{
+	if (m_pending || s_keepUniformValues)
+	{
+		storeUniform(UniformValue{ handle.index, GL_INT, value });
+		if (m_pending)
+		{
+			return;
+		}
+	}
+	glUniform1i(getLocation(handle), value);
+}
+
+void Shader::setFloat(UniformHandle handle, float value) const
+{
+	if (m_pending || s_keepUniformValues)
+	{
+		storeUniform(UniformValue{ handle.index, GL_FLOAT, 0, { value } });
+		if (m_pending)
+		{
+			return;
+		}
+	}
+	glUniform1f(getLocation(handle), value);
+}
+
+void Shader::setFloat2(UniformHandle handle, float value1, float value2)
+{
+	if (m_pending || s_keepUniformValues)
+	{
+		storeUniform(UniformValue{ handle.index, GL_FLOAT_VEC2, 0, { value1, value2 } });
+		if (m_pending)
+		{
+			return;
+		}
+	}
+	glUniform2f(getLocation(handle), value1, value2);
+}
+
+void Shader::setFloat4(UniformHandle handle, float value1, float value2, float value3, float value4)
+{
+	if (m_pending || s_keepUniformValues)
+	{
+		storeUniform(UniformValue{ handle.index, GL_FLOAT_VEC4, 0, { value1, value2, value3, value4 } });
+		if (m_pending)
+		{
+			return;
+		}
+	}
+	glUniform4f(getLocation(handle), value1, value2, value3, value4);
+}
+
+void Shader::setMat4(UniformHandle handle, const GLfloat* matrix)
+{
+	if (m_pending || s_keepUniformValues)
+	{
+		UniformValue value = { handle.index, GL_FLOAT_MAT4 };
+		memcpy(value.floatValues, matrix, sizeof(value.floatValues));
+		storeUniform(value);
+		if (m_pending)
+		{
+			return;
+		}
+	}
+	glUniformMatrix4fv(getLocation(handle), 1, GL_FALSE, matrix);
 }
@@ -1,21 +1,199 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cstdint>
 #include <string>
-#include <fstream> // file stream
-#include <sstream> // string stream
 #include <iostream> // input/output stream
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "GLResources.h"
+#include "Hash.h"
+#include "ShaderSourceLoader.h"
+
+/// <summary>
+/// Refers to one of a shader's uniforms. Get one with Shader::getUniformHandle once (e.g. right after creating the shader),
+/// then pass it to the set functions every frame instead of the name, so there's no string hashing or driver lookup at all.
+/// A handle that didn't resolve (the uniform was spelt wrong, or the compiler optimized it away) is still safe to set, it
+/// just does nothing, same as setting location -1 does in plain OpenGL
+/// </summary>
+struct UniformHandle
+{
+	int index = -1;
+	bool isValid() const { return index >= 0; }
+};
+
+/// <summary>
+/// The GLSL for a program, with includes expanded (see ShaderSourceLoader). Either source is null if it couldn't be found
+/// </summary>
+struct ShaderSource
+{
+	std::shared_ptr<const ShaderSourceLoader::Source> vertex;
+	std::shared_ptr<const ShaderSourceLoader::Source> fragment;
+
+	bool isValid() const { return vertex && fragment; }
+
+	/// <summary>
+	/// Identifies the exact code of both shaders
+	/// </summary>
+	uint64_t getHash() const { return isValid() ? Hash::Combine(vertex->hash, fragment->hash) : 0; }
+};
+
+/// <summary>
+/// A vertex + fragment shader program. It owns its GL program and deletes it when destroyed, so it can't be copied.
+/// Use ShaderRegistry to share one program between several users instead.
+///
+/// With async set, the constructor only hands the sources to the driver and returns without waiting for anything, so
+/// all the programs can be submitted up front and compiled at the same time. If the driver has
+/// GL_KHR_parallel_shader_compile, it compiles them on its own threads and isReady can check on them without blocking.
+/// Until a program is ready, use binds a plain magenta placeholder program instead, and uniforms set on it are saved
+/// and applied once it's ready. Without the extension, the first use just waits for that program to finish
+/// </summary>
 class Shader
 {
 public:
 	unsigned int ID;
-	Shader(const char* vertexPath, const char* fragmentPath);
+	Shader(const char* vertexName, const char* fragmentName, bool async = false);
+	Shader(const ShaderSource& source, bool async = false);
+	~Shader();
+
+	// copying would mean two objects deleting the same program
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	/// <summary>
+	/// Loads both shader files through ShaderSourceLoader, adding defines (see ShaderSourceLoader::AddDefines) to both
+	/// </summary>
+	static ShaderSource readSource(const char* vertexName, const char* fragmentName, const std::vector<std::string>& defines = {});
+
+	/// <summary>
+	/// Binds the program, or the placeholder if it's still compiling
+	/// </summary>
 	void use();
+
+	/// <summary>
+	/// Whether the program has finished compiling and linking. Never blocks when the driver supports parallel shader
+	/// compiles. Without it, there's no way to ask without blocking, so this waits for it to finish
+	/// </summary>
+	bool isReady();
+	void waitUntilReady();
+
+	/// <summary>
+	/// Compiles source into a new program and swaps it in for the current one. The uniform table is refreshed without
+	/// moving anything, so handles already given out keep working, and every uniform value set so far is applied to the new
+	/// program (see setKeepUniformValues). If the new source doesn't compile, the old program is kept and this returns false
+	/// </summary>
+	bool reload(const ShaderSource& source);
+
+	/// <summary>
+	/// When on, every Shader remembers the last value set on each of its uniforms, so a reload can put them back. Off by
+	/// default, since it costs a copy on every set
+	/// </summary>
+	static void setKeepUniformValues(bool keep);
+
+	/// <summary>
+	/// How long it took to get this program ready, from the binary cache or by compiling. For async programs that's
+	/// from submitting it to it first being used after it finished. 0 until it's ready
+	/// </summary>
+	double getLoadMilliseconds() const { return m_loadMilliseconds; }
+
+	/// <summary>
+	/// Looks a uniform up in the table made when the program was linked. If expectedType is given (e.g. GL_FLOAT_MAT4),
+	/// a warning gets printed when the uniform in the shader has a different type, since the glUniform call would fail
+	/// </summary>
+	UniformHandle getUniformHandle(const std::string& name, GLenum expectedType = GL_NONE) const;
+
 	void setBool(const std::string& name, bool value) const;
 	void setInt(const std::string& name, int value) const;
 	void setFloat(const std::string& name, float value) const;
 	void setFloat2(const std::string& name, float value1, float value2);
 	void setFloat4(const std::string& name, float value1, float value2, float value3, float value4);
 	void setMat4(const std::string& name, const GLfloat* matrix);
-};
 
+	void setBool(UniformHandle handle, bool value) const;
+	void setInt(UniformHandle handle, int value) const;
+	void setFloat(UniformHandle handle, float value) const;
+	void setFloat2(UniformHandle handle, float value1, float value2);
+	void setFloat4(UniformHandle handle, float value1, float value2, float value3, float value4);
+	void setMat4(UniformHandle handle, const GLfloat* matrix);
+
+	/// <summary>
+	/// How many times any Shader has had to call glGetUniformLocation for a name that wasn't in its reflected uniform table.
+	/// Once the handles are resolved this shouldn't go up any more, so comparing it between two frames is an easy way to
+	/// check nothing on the frame path is still doing lookups
+	/// </summary>
+	static size_t getUniformLocationLookupCount();
+
+	/// <summary>
+	/// Deletes the placeholder program, if it was ever made. Call before the context goes away, or it shows up as a leak
+	/// (see GLResourceRegistry::ReportLeaks). It gets made again if something still needs it
+	/// </summary>
+	static void deletePlaceholder();
+
+private:
+	struct UniformInfo
+	{
+		std::string name;
+		GLint location;
+		GLenum type;
+		GLint size; // number of elements, for arrays
+		GLenum expectedType; // what getUniformHandle was told to expect, checked once the real type is known
+	};
+
+	// the last value set on a uniform. Kept while the program is still compiling so it can be applied once it's done,
+	// and while hot reload is on so it can be put back on the new program after a reload
+	struct UniformValue
+	{
+		int index = -1;
+		GLenum type = GL_NONE; // GL_INT, GL_FLOAT, GL_FLOAT_VEC2, GL_FLOAT_VEC4 or GL_FLOAT_MAT4
+		GLint intValue = 0;
+		GLfloat floatValues[16] = {};
+	};
+
+	// every active uniform in the program, straight from glGetActiveUniform, plus any array elements asked for by name
+	// (e.g. "lights[2]") since those aren't listed separately. Handles index into this.
+	// name -> index into m_uniforms. Names the program doesn't have get cached too (as -1) so they're only looked up once.
+	// Both are mutable so the const set functions can fill them in
+	mutable std::vector<UniformInfo> m_uniforms;
+	mutable std::unordered_map<std::string, int> m_uniformIndices;
+
+	static size_t s_uniformLocationLookups;
+
+	// async compile state. The shader objects are kept until the link finishes so their logs can be printed if it fails
+	bool m_pending = false;
+	GLShaderObject m_vertexShader;
+	GLShaderObject m_fragmentShader;
+	uint64_t m_cacheKey = 0;
+	double m_submitTime = 0.0;
+	double m_loadMilliseconds = 0.0;
+	mutable std::vector<UniformValue> m_uniformValues;
+
+	static bool s_parallelCompileChecked;
+	static bool s_parallelCompileSupported;
+	static int s_pendingPrograms;
+	static int s_asyncPrograms;
+	static double s_firstSubmitTime;
+	static bool s_startupStatsPrinted;
+	static unsigned int s_placeholderProgram;
+	static bool s_keepUniformValues;
+
+	void init(const ShaderSource& source, bool async);
+	// glCreateProgram, tracked by GLResourceRegistry
+	static unsigned int createProgram();
+	void submitCompile(const ShaderSource& source);
+	bool finishCompile();
+	void finishPending();
+	void reflectUniforms();
+	void bindUniformBlocks();
+	void checkUniformType(int index) const;
+	GLint getLocation(UniformHandle handle) const;
+	void storeUniform(const UniformValue& value) const;
+	void applyStoredUniforms();
+	static void applyUniform(GLint location, const UniformValue& value);
+
+	static void initParallelCompile();
+	static void usePlaceholder();
+	static void printStartupStats();
+	static double getTimeMilliseconds();
+};
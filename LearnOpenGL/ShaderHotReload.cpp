@@ -0,0 +1,249 @@
+#include "ShaderHotReload.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "PathUtilities.h"
+
+std::mutex ShaderHotReload::s_mutex;
+std::vector<ShaderHotReload::WatchedProgram> ShaderHotReload::s_programs;
+std::vector<ShaderHotReload::PendingReload> ShaderHotReload::s_pendingReloads;
+std::vector<std::string> ShaderHotReload::s_newDirectories;
+std::thread ShaderHotReload::s_thread;
+std::atomic<bool> ShaderHotReload::s_running(false);
+std::vector<std::pair<std::string, double>> ShaderHotReload::s_reloadsToReport;
+
+void ShaderHotReload::Start()
+{
+#ifdef __linux__
+	if (s_running)
+	{
+		return;
+	}
+	// so the reloaded programs can have their uniforms put back
+	Shader::setKeepUniformValues(true);
+	s_running = true;
+	s_thread = std::thread(&ShaderHotReload::WatchLoop);
+	std::string directory = ShaderSourceLoader::GetOverrideDirectory();
+	if (directory.empty())
+	{
+		std::cout << "Shader hot reload: the shaders are the embedded copies, so there are no files to watch" << std::endl;
+	}
+	else
+	{
+		std::cout << "Shader hot reload: watching the shader files in " << directory << " for changes" << std::endl;
+	}
+#else
+	std::cout << "Shader hot reload: only supported on Linux" << std::endl;
+#endif
+}
+
+void ShaderHotReload::Stop()
+{
+	if (!s_running)
+	{
+		return;
+	}
+	s_running = false;
+	s_thread.join();
+	Shader::setKeepUniformValues(false);
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_pendingReloads.clear();
+}
+
+void ShaderHotReload::Watch(const std::string& vertexName, const std::string& fragmentName, const std::vector<std::string>& defines,
+	const ShaderSource& source, std::weak_ptr<Shader> shader)
+{
+	WatchedProgram program = { vertexName, fragmentName, defines, {}, shader, shader.lock().get() };
+	for (const auto& stageSource : { source.vertex, source.fragment })
+	{
+		if (stageSource)
+		{
+			for (const ShaderSourceLoader::Dependency& dependency : stageSource->dependencies)
+			{
+				program.files.push_back(dependency.path);
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (const std::string& path : program.files)
+	{
+		s_newDirectories.push_back(PathUtilities::GetDirectory(path));
+	}
+	s_programs.push_back(std::move(program));
+}
+
+void ShaderHotReload::Unwatch(const Shader* shader)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_programs.erase(std::remove_if(s_programs.begin(), s_programs.end(),
+		[&](const WatchedProgram& program) { return program.address == shader; }), s_programs.end());
+	s_pendingReloads.erase(std::remove_if(s_pendingReloads.begin(), s_pendingReloads.end(),
+		[&](const PendingReload& reload) { return reload.address == shader; }), s_pendingReloads.end());
+}
+
+void ShaderHotReload::Update()
+{
+	double now = GetTimeMilliseconds();
+	for (const auto& report : s_reloadsToReport)
+	{
+		std::cout << "Reloaded " << report.first << ": " << now - report.second << " ms from save to first frame" << std::endl;
+	}
+	s_reloadsToReport.clear();
+
+	std::vector<PendingReload> reloads;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		reloads.swap(s_pendingReloads);
+	}
+	for (PendingReload& reload : reloads)
+	{
+		std::shared_ptr<Shader> shader = reload.shader.lock();
+		if (shader && shader->reload(reload.source))
+		{
+			s_reloadsToReport.push_back(std::make_pair(reload.fileName, reload.savedTime));
+		}
+	}
+}
+
+/// <summary>
+/// Reads the new source of every live program that uses one of the changed files, and queues it up for Update
+/// </summary>
+void ShaderHotReload::QueueReloads(const std::vector<std::string>& changedPaths, double savedTime)
+{
+	std::vector<WatchedProgram> affected;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (const WatchedProgram& program : s_programs)
+		{
+			bool changed = std::any_of(changedPaths.begin(), changedPaths.end(), [&](const std::string& path) {
+				return std::find(program.files.begin(), program.files.end(), path) != program.files.end();
+			});
+			if (changed && !program.shader.expired())
+			{
+				affected.push_back(program);
+			}
+		}
+	}
+
+	// the file reading happens here, outside the lock, so Update never has to wait for it
+	std::vector<PendingReload> reloads;
+	for (const WatchedProgram& program : affected)
+	{
+		std::string fileName = program.vertexName + " + " + program.fragmentName;
+		reloads.push_back(PendingReload{ program.shader, program.address, fileName, Shader::readSource(program.vertexName.c_str(), program.fragmentName.c_str(), program.defines), savedTime });
+	}
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (PendingReload& reload : reloads)
+	{
+		s_pendingReloads.push_back(std::move(reload));
+	}
+}
+
+#ifdef __linux__
+
+/// <summary>
+/// Watches the directories the shader files are in rather than the files themselves, since a lot of editors save by
+/// writing a new file and renaming it over the old one, which a watch on the old file wouldn't see
+/// </summary>
+void ShaderHotReload::WatchLoop()
+{
+	int inotifyFd = inotify_init1(IN_NONBLOCK);
+	if (inotifyFd < 0)
+	{
+		std::cout << "Shader hot reload: inotify_init1 failed" << std::endl;
+		return;
+	}
+
+	// watch descriptor -> the directory it's watching
+	std::vector<std::pair<int, std::string>> watchedDirectories;
+
+	alignas(struct inotify_event) char buffer[4096];
+	while (s_running)
+	{
+		// pick up any directories of programs created since last time around
+		std::vector<std::string> newDirectories;
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			newDirectories.swap(s_newDirectories);
+		}
+		for (const std::string& directory : newDirectories)
+		{
+			bool alreadyWatched = std::any_of(watchedDirectories.begin(), watchedDirectories.end(),
+				[&](const std::pair<int, std::string>& watched) { return watched.second == directory; });
+			if (!alreadyWatched)
+			{
+				int watch = inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+				if (watch >= 0)
+				{
+					watchedDirectories.push_back(std::make_pair(watch, directory));
+				}
+			}
+		}
+
+		// wait a bit for something to happen, then check whether we've been stopped
+		pollfd pollInfo = { inotifyFd, POLLIN, 0 };
+		if (poll(&pollInfo, 1, 100) <= 0)
+		{
+			continue;
+		}
+		double savedTime = GetTimeMilliseconds();
+
+		// saving often fires a few events in a row, so give the editor a moment to finish before reading anything
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		std::vector<std::string> changedPaths;
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* position = buffer; position < buffer + length;)
+			{
+				const inotify_event* event = (const inotify_event*)position;
+				position += sizeof(inotify_event) + event->len;
+				if (event->len == 0)
+				{
+					continue;
+				}
+				for (const auto& watched : watchedDirectories)
+				{
+					if (watched.first == event->wd)
+					{
+						std::string path = PathUtilities::Join(watched.second, event->name);
+						if (std::find(changedPaths.begin(), changedPaths.end(), path) == changedPaths.end())
+						{
+							changedPaths.push_back(path);
+						}
+					}
+				}
+			}
+		}
+		if (!changedPaths.empty())
+		{
+			QueueReloads(changedPaths, savedTime);
+		}
+	}
+	close(inotifyFd);
+}
+
+#else
+
+void ShaderHotReload::WatchLoop()
+{
+}
+
+#endif
+
+double ShaderHotReload::GetTimeMilliseconds()
+{
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now().time_since_epoch();
+	return time.count();
+}
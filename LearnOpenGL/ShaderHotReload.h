@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Shader.h"
+
+/// <summary>
+/// Watches the shader files of every program loaded through ShaderRegistry, and reloads a program when one of its files
+/// (including anything it #includes) is saved, so shaders can be tweaked without restarting the app. Programs built
+/// from the embedded shaders have no files, so this only does anything when ShaderSourceLoader has an override
+/// directory.
+///
+/// The watching (inotify, so Linux only, everywhere else Start just says so and nothing happens) and the reading of the
+/// new source both happen on a background thread. The only thing left for the main thread is the part that needs the GL
+/// context: Update compiles the new source and swaps it into the existing Shader, which keeps the old program if the new
+/// one doesn't compile. Call Update once a frame.
+///
+/// The time from the file being saved to the first frame drawn with the new program is logged for every reload
+/// </summary>
+class ShaderHotReload
+{
+public:
+	static void Start();
+	static void Stop();
+	static void Update();
+
+	/// <summary>
+	/// Adds a program to the set being watched. ShaderRegistry does this for everything it creates
+	/// </summary>
+	static void Watch(const std::string& vertexName, const std::string& fragmentName, const std::vector<std::string>& defines,
+		const ShaderSource& source, std::weak_ptr<Shader> shader);
+	/// <summary>
+	/// Forgets a program that's being destroyed, along with any reload of it that hasn't been compiled yet.
+	/// ShaderRegistry does this when the last handle to one goes away
+	/// </summary>
+	static void Unwatch(const Shader* shader);
+
+private:
+	struct WatchedProgram
+	{
+		std::string vertexName;
+		std::string fragmentName;
+		std::vector<std::string> defines;
+		// every file that went into the program's source
+		std::vector<std::string> files;
+		std::weak_ptr<Shader> shader;
+		// what Unwatch looks for. By the time a Shader is being destroyed, its weak_ptrs can't be locked any more
+		const Shader* address;
+	};
+
+	// new source read by the watcher thread, waiting for the main thread to compile it
+	struct PendingReload
+	{
+		std::weak_ptr<Shader> shader;
+		const Shader* address;
+		std::string fileName;
+		ShaderSource source;
+		double savedTime;
+	};
+
+	static std::mutex s_mutex;
+	static std::vector<WatchedProgram> s_programs;
+	static std::vector<PendingReload> s_pendingReloads;
+	// directories of files added by Watch that the watcher thread hasn't started watching yet
+	static std::vector<std::string> s_newDirectories;
+	static std::thread s_thread;
+	static std::atomic<bool> s_running;
+
+	// reloads swapped in this frame. The latency gets logged at the start of the next Update, once the frame using them is done
+	static std::vector<std::pair<std::string, double>> s_reloadsToReport;
+
+	static void WatchLoop();
+	static void QueueReloads(const std::vector<std::string>& changedPaths, double savedTime);
+	static double GetTimeMilliseconds();
+};
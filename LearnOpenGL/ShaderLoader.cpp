@@ -1,28 +1,35 @@
 #include "ShaderLoader.h"
+#include <chrono>
+#include <vector>
+
+#include "GLResources.h"
+#include "GLStateCache.h"
+#include "ProgramBinaryCache.h"
 
 /// <summary>
 /// I wrote this class because I got annoyed at the fact the shaders in the tutorial were just raw strings.
 /// I didn't realize there was a section later on that teaches you to do exactly this. So I guess this is no
 /// longer necessary :facepalm:
 /// 
-/// Still, it was a good exercise in debugging C++ and setting up build steps to copy glsl files to the output directory
-/// Downside of this implementation is it reads the files line by line. It's better to use the official Shader.cpp version
-/// since that one will just read everything at once
+/// Still, it was a good exercise in debugging C++ and setting up build steps to copy glsl files to the output directory.
+/// It used to read the files line by line, but now the files are memory mapped by ShaderSourceLoader, and the pieces
+/// (the file, split up around any #includes) are handed to glShaderSource as they are, with their lengths, so the
+/// code never gets copied into a string at all
 /// </summary>
-/// <param name="path"></param>
-/// <param name="result"></param>
-void ShaderLoader::readFile(const char* path, std::string &result)
+void ShaderLoader::SetSource(const unsigned int shaderId, const ShaderSourceLoader::Source& source)
 {
-	// input file stream
-	std::ifstream fileStream(path, std::ios::in);
-
-	// getline clobbers existing value of the 2nd param string, so need to store in temp variable
-	std::string tempLine;
-	while (std::getline(fileStream, tempLine))
+	std::vector<const GLchar*> strings;
+	std::vector<GLint> lengths;
+	strings.reserve(source.pieces.size());
+	lengths.reserve(source.pieces.size());
+	for (std::string_view piece : source.pieces)
 	{
-		result += tempLine + "\n";
+		strings.push_back(piece.data());
+		lengths.push_back((GLint)piece.size());
 	}
-	fileStream.close();
+	// 2nd param is the # of strings we want to pass, 3rd is the strings, and 4th their lengths. Passing NULL for the
+	// lengths would mean they're all null terminated, which a view into the middle of a file isn't
+	glShaderSource(shaderId, (GLsizei)strings.size(), strings.data(), lengths.data());
 }
 
 void ShaderLoader::ValidateShader(const unsigned int shaderId)
@@ -44,48 +51,60 @@ void ShaderLoader::ValidateShader(const unsigned int shaderId)
 	}
 }
 
-unsigned int ShaderLoader::createBasicShaderProgram(const char* vertShaderPath, const char* fragShaderPath) {
-	std::string vertexSource;
-	readFile(vertShaderPath, vertexSource);
-	const char* vertData = vertexSource.c_str();
+unsigned int ShaderLoader::createBasicShaderProgram(const char* vertShaderName, const char* fragShaderName) {
+	std::shared_ptr<const ShaderSourceLoader::Source> vertexSource = ShaderSourceLoader::Load(vertShaderName);
+	std::shared_ptr<const ShaderSourceLoader::Source> fragmentSource = ShaderSourceLoader::Load(fragShaderName);
+	if (!vertexSource || !fragmentSource)
+	{
+		// the loader already printed why
+		return createProgram();
+	}
+
+	// skip the whole compile and link below if a previous run already saved this program's binary
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t cacheKey = ProgramBinaryCache::ComputeKey(vertexSource->hash, fragmentSource->hash);
+	unsigned int cachedProgram = createProgram();
+	if (ProgramBinaryCache::TryLoad(cachedProgram, cacheKey))
+	{
+		std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+		ProgramBinaryCache::RecordProgramLoad(true, loadTime.count());
+		return cachedProgram;
+	}
+	GLStateCache::DeleteProgram(cachedProgram);
+
 	// INSTANTIATE THE SHADER
 	// shaders are also OpenGL objects. This function instantiates one and returns
 	// its OpenGL object ID. It returns 0 if an error occurred. The parameter to the
 	// function is the type of shader you want to create
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	GLShaderObject vertexShader;
+	vertexShader.Create("ShaderLoader vertex shader", GL_VERTEX_SHADER);
 
-	// SET THE SHADER'S CODE TO THE VERTEX SHADER STRING
-	// 2nd param is the # of strings we want to pass. We only have one shader so pass 1
-	// 3rd param is an array of strings holding the source code(s). We only have one.
-	// Recall that using &some_pointer is the same as the type for an array of that pointer
-	glShaderSource(vertexShader, 1, &vertData, NULL);
+	// SET THE SHADER'S CODE TO THE VERTEX SHADER SOURCE
+	SetSource(vertexShader.Get(), *vertexSource);
 
 	// test compile the shader. If your shader is correct, you don't actually need to run this
 	// as OpenGL will compile it at runtime anyway. But if you want to do validation, which we
 	// do here, you do need to call glCompileShader, or glGetShaderiv with GL_COMPILE_STATUS will
 	// say that your shader failed to compile.
-	glCompileShader(vertexShader);
+	glCompileShader(vertexShader.Get());
 
 	// CHECK THAT THE SHADER COMPILES
-	ValidateShader(vertexShader);
-
-	std::string fragmentSource;
-	readFile(fragShaderPath, fragmentSource);
-	const char* fragData = fragmentSource.c_str();
+	ValidateShader(vertexShader.Get());
 
 	// INSTANTIATE FRAGMENT SHADER
-	unsigned int fragmentShader;
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragData, NULL);
-	glCompileShader(fragmentShader);
+	GLShaderObject fragmentShader;
+	fragmentShader.Create("ShaderLoader fragment shader", GL_FRAGMENT_SHADER);
+	SetSource(fragmentShader.Get(), *fragmentSource);
+	glCompileShader(fragmentShader.Get());
 
-	ValidateShader(fragmentShader);
+	ValidateShader(fragmentShader.Get());
 
 	// CREATE A PROGRAM, WHICH IS A SPECIFICATION OF ALL THE SHADERS YOU WANT TO RUN
 	unsigned int shaderProgram;
-	shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader); // can only add one shader of each shader type
+	shaderProgram = createProgram();
+	glAttachShader(shaderProgram, vertexShader.Get());
+	glAttachShader(shaderProgram, fragmentShader.Get()); // can only add one shader of each shader type
+	ProgramBinaryCache::PrepareForStore(shaderProgram); // tell the driver we'll want the binary back afterwards
 	glLinkProgram(shaderProgram); // this step links the attached shaders together and makes sure their inputs and outputs match. It will fail if they don't
 
 	// VALIDATE THE PROGRAM
@@ -97,12 +116,73 @@ unsigned int ShaderLoader::createBasicShaderProgram(const char* vertShaderPath,
 	{
 		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
 	}
+	else
+	{
+		ProgramBinaryCache::Store(shaderProgram, cacheKey);
+	}
 
 	// CLEANUP
 	// once you link shader objects to programs, you don't need them anymore
-	// this deallocs memory used for the shader object
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// this deallocs memory used for the shader object (going out of scope would too)
+	vertexShader.Reset();
+	fragmentShader.Reset();
+
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+	ProgramBinaryCache::RecordProgramLoad(false, loadTime.count());
 	return shaderProgram;
 
 }
+
+unsigned int ShaderLoader::createComputeProgram(const char* computeShaderName)
+{
+	std::shared_ptr<const ShaderSourceLoader::Source> source = ShaderSourceLoader::Load(computeShaderName);
+	if (!source)
+	{
+		return createProgram();
+	}
+
+	// the cache key is made for a vertex and fragment pair, but a compute shader on its own hashes just as well
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t cacheKey = ProgramBinaryCache::ComputeKey(source->hash, 0);
+	unsigned int program = createProgram();
+	if (ProgramBinaryCache::TryLoad(program, cacheKey))
+	{
+		std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+		ProgramBinaryCache::RecordProgramLoad(true, loadTime.count());
+		return program;
+	}
+	GLStateCache::DeleteProgram(program);
+
+	GLShaderObject computeShader;
+	computeShader.Create("ShaderLoader compute shader", GL_COMPUTE_SHADER);
+	SetSource(computeShader.Get(), *source);
+	glCompileShader(computeShader.Get());
+	ValidateShader(computeShader.Get());
+
+	program = createProgram();
+	glAttachShader(program, computeShader.Get());
+	ProgramBinaryCache::PrepareForStore(program);
+	glLinkProgram(program);
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << computeShaderName << "\n" << infoLog << std::endl;
+	}
+	else
+	{
+		ProgramBinaryCache::Store(program, cacheKey);
+	}
+	computeShader.Reset();
+
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+	ProgramBinaryCache::RecordProgramLoad(false, loadTime.count());
+	return program;
+}
+
+unsigned int ShaderLoader::createProgram()
+{
+	return GLResourceRegistry::Track(GLResourceType::Program, glCreateProgram(), "ShaderLoader");
+}
@@ -1,18 +1,31 @@
 #pragma once
 #include <string>
-#include <fstream>
 #include <glad/glad.h>
 #include <iostream>
 
+#include "ShaderSourceLoader.h"
+
 class ShaderLoader
 {
 private:
-	void readFile(const char* path, std::string &result);
-
 	void ValidateShader(const unsigned int shaderId);
 
+	/// <summary>
+	/// glCreateProgram, tracked by GLResourceRegistry. Whoever gets the program deletes it through GLStateCache
+	/// </summary>
+	unsigned int createProgram();
+
 public:
-	unsigned int createBasicShaderProgram(const char* vertShaderPath, const char* fragShaderPath);
+	/// <summary>
+	/// Hands the driver the pieces of an expanded source straight out of the mapped files. Shader uses this too
+	/// </summary>
+	static void SetSource(const unsigned int shaderId, const ShaderSourceLoader::Source& source);
+
+	unsigned int createBasicShaderProgram(const char* vertShaderName, const char* fragShaderName);
+	/// <summary>
+	/// Same thing for a compute shader, which is a whole program on its own. Needs GL 4.3
+	/// </summary>
+	unsigned int createComputeProgram(const char* computeShaderName);
 
 };
 
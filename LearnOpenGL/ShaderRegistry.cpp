@@ -0,0 +1,79 @@
+#include "ShaderRegistry.h"
+#include <iostream>
+
+#include "Hash.h"
+#include "ShaderHotReload.h"
+
+std::unordered_map<uint64_t, ShaderRegistry::Entry> ShaderRegistry::s_entries;
+int ShaderRegistry::s_programsCreated = 0;
+int ShaderRegistry::s_programsReleased = 0;
+int ShaderRegistry::s_programsReused = 0;
+
+std::shared_ptr<Shader> ShaderRegistry::Load(const std::string& vertexName, const std::string& fragmentName, bool async)
+{
+	return Load(vertexName, fragmentName, {}, async);
+}
+
+std::shared_ptr<Shader> ShaderRegistry::Load(const std::string& vertexName, const std::string& fragmentName, const std::vector<std::string>& defines, bool async)
+{
+	ShaderSource source = Shader::readSource(vertexName.c_str(), fragmentName.c_str(), defines);
+	uint64_t key = source.getHash();
+
+	// a program whose files couldn't be read isn't shared, so fixing one of them and hot reloading doesn't affect others
+	auto found = source.isValid() ? s_entries.find(key) : s_entries.end();
+	if (found != s_entries.end())
+	{
+		std::shared_ptr<Shader> existing = found->second.shader.lock();
+		if (existing)
+		{
+			found->second.requestCount++;
+			s_programsReused++;
+			return existing;
+		}
+	}
+
+	// the deleter tells us when the last handle is gone, so the entry can record how long the program took to load
+	std::shared_ptr<Shader> shader(new Shader(source, async), [key](Shader* released) { Release(key, released); });
+	s_entries[key] = Entry{ shader, vertexName, fragmentName, defines, 1, 0.0 };
+	s_programsCreated++;
+	ShaderHotReload::Watch(vertexName, fragmentName, defines, source, shader);
+	return shader;
+}
+
+void ShaderRegistry::Release(uint64_t key, Shader* shader)
+{
+	auto found = s_entries.find(key);
+	if (found != s_entries.end())
+	{
+		found->second.loadMilliseconds = shader->getLoadMilliseconds();
+	}
+	s_programsReleased++;
+	ShaderHotReload::Unwatch(shader);
+	delete shader;
+}
+
+void ShaderRegistry::PrintDiagnostics()
+{
+	std::cout << "Shader registry: " << s_programsCreated << " programs created, " << s_programsReused << " requests served by an existing program, "
+		<< s_programsCreated - s_programsReleased << " still alive" << std::endl;
+
+	double totalSaved = 0.0;
+	for (const auto& pair : s_entries)
+	{
+		const Entry& entry = pair.second;
+		std::shared_ptr<Shader> shader = entry.shader.lock();
+		double loadMilliseconds = shader ? shader->getLoadMilliseconds() : entry.loadMilliseconds;
+
+		// every request after the first would have been a compile of its own
+		double saved = loadMilliseconds * (entry.requestCount - 1);
+		totalSaved += saved;
+		std::cout << "  " << entry.vertexName << " + " << entry.fragmentName;
+		for (const std::string& define : entry.defines)
+		{
+			std::cout << " " << define;
+		}
+		std::cout << ": " << entry.requestCount << " requests, "
+			<< loadMilliseconds << " ms to load, " << saved << " ms saved" << (shader ? "" : " (released)") << std::endl;
+	}
+	std::cout << "  total compile time saved: " << totalSaved << " ms" << std::endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+/// <summary>
+/// Hands out shared Shader programs, so asking for the same program twice compiles it once.
+///
+/// Programs are matched by a hash of their final source code (what actually gets handed to glShaderSource), not by their
+/// file paths, so two different files with identical contents share a program too. Handles are shared_ptrs: the program
+/// is deleted as soon as the last handle to it goes away, which has to happen while the GL context is still alive.
+/// The registry itself only keeps weak references, so it never keeps a program alive on its own
+/// </summary>
+class ShaderRegistry
+{
+public:
+	static std::shared_ptr<Shader> Load(const std::string& vertexName, const std::string& fragmentName, bool async = false);
+
+	/// <summary>
+	/// Same, with defines added to both shaders (see ShaderSourceLoader::AddDefines). ShaderVariants uses this
+	/// </summary>
+	static std::shared_ptr<Shader> Load(const std::string& vertexName, const std::string& fragmentName, const std::vector<std::string>& defines, bool async = false);
+
+	/// <summary>
+	/// Prints every program the registry knows about, how many times each was asked for, and how much compile time
+	/// handing out the existing program saved
+	/// </summary>
+	static void PrintDiagnostics();
+
+private:
+	struct Entry
+	{
+		std::weak_ptr<Shader> shader;
+		std::string vertexName;
+		std::string fragmentName;
+		std::vector<std::string> defines;
+		int requestCount;
+		// filled in when the program is released, since the load time of an async program isn't known until it's used
+		double loadMilliseconds;
+	};
+
+	static std::unordered_map<uint64_t, Entry> s_entries;
+	static int s_programsCreated;
+	static int s_programsReleased;
+	static int s_programsReused;
+
+	static void Release(uint64_t key, Shader* shader);
+};
@@ -0,0 +1,297 @@
+#include "ShaderSourceLoader.h"
+#include <cstdlib>
+#include <iostream>
+
+#include "Generated/EmbeddedShaders.h"
+#include "Hash.h"
+#include "PathUtilities.h"
+
+std::mutex ShaderSourceLoader::s_mutex;
+std::string ShaderSourceLoader::s_overrideDirectory;
+std::unordered_map<std::string, std::shared_ptr<const ShaderSourceLoader::Source>> ShaderSourceLoader::s_cache;
+int ShaderSourceLoader::s_filesMapped = 0;
+int ShaderSourceLoader::s_cacheHits = 0;
+int ShaderSourceLoader::s_embeddedLoads = 0;
+
+void ShaderSourceLoader::Configure(const std::string& appPath)
+{
+	const char* environmentDirectory = std::getenv("LEARNOPENGL_SHADER_DIR");
+	if (environmentDirectory != nullptr && environmentDirectory[0] != '\0')
+	{
+		SetOverrideDirectory(environmentDirectory);
+	}
+	else
+	{
+#if defined(NDEBUG)
+		SetOverrideDirectory("");
+#elif defined(LEARNOPENGL_SOURCE_SHADER_DIR)
+		// the project file points this at src/shaders/simple, so the files being edited are the ones hot reload watches,
+		// not the copies the build put next to the executable
+		SetOverrideDirectory(LEARNOPENGL_SOURCE_SHADER_DIR);
+#else
+		SetOverrideDirectory(appPath);
+#endif
+	}
+
+	if (s_overrideDirectory.empty())
+	{
+		std::cout << "Shaders: using the " << EmbeddedShaders::Count << " embedded shaders" << std::endl;
+	}
+	else
+	{
+		std::cout << "Shaders: loading from " << s_overrideDirectory << " (falling back to the embedded copies)" << std::endl;
+	}
+}
+
+void ShaderSourceLoader::SetOverrideDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_overrideDirectory = directory;
+}
+
+std::string ShaderSourceLoader::GetOverrideDirectory()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_overrideDirectory;
+}
+
+std::shared_ptr<const ShaderSourceLoader::Source> ShaderSourceLoader::Load(const std::string& name)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (!s_overrideDirectory.empty())
+		{
+			std::string path = PathUtilities::Join(s_overrideDirectory, name);
+			uint64_t modifiedTime, size;
+			if (MappedFile::GetFileInfo(path, modifiedTime, size))
+			{
+				return LoadLocked(path, 0);
+			}
+		}
+	}
+	return LoadEmbedded(name);
+}
+
+/// <summary>
+/// The embedded sources already had their includes expanded and their hash worked out at build time, so this is just a
+/// lookup. The piece points at the string in the executable, so there's nothing to keep alive
+/// </summary>
+std::shared_ptr<const ShaderSourceLoader::Source> ShaderSourceLoader::LoadEmbedded(const std::string& name)
+{
+	for (const EmbeddedShader& embedded : EmbeddedShaders::All)
+	{
+		if (embedded.name == name)
+		{
+			auto source = std::make_shared<Source>();
+			source->path = name;
+			source->pieces.push_back(embedded.source);
+			source->hash = embedded.hash;
+			source->length = embedded.source.size();
+
+			std::lock_guard<std::mutex> lock(s_mutex);
+			s_embeddedLoads++;
+			return source;
+		}
+	}
+	std::cout << "ERROR::SHADER::NOT_FOUND " << name << " isn't one of the embedded shaders" << std::endl;
+	return nullptr;
+}
+
+bool ShaderSourceLoader::IsUpToDate(const Source& source)
+{
+	for (const Dependency& dependency : source.dependencies)
+	{
+		uint64_t modifiedTime, size;
+		if (!MappedFile::GetFileInfo(dependency.path, modifiedTime, size) || modifiedTime != dependency.modifiedTime || size != dependency.size)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Checks whether line is #include "name" (spaces and tabs allowed before, after and around the #), and if so gives back the name
+/// </summary>
+bool ShaderSourceLoader::ParseInclude(std::string_view line, std::string_view& includeName)
+{
+	size_t position = line.find_first_not_of(" \t");
+	if (position == std::string_view::npos || line[position] != '#')
+	{
+		return false;
+	}
+	position = line.find_first_not_of(" \t", position + 1);
+	if (position == std::string_view::npos || line.compare(position, 7, "include") != 0)
+	{
+		return false;
+	}
+	size_t open = line.find('"', position + 7);
+	size_t close = open == std::string_view::npos ? open : line.find('"', open + 1);
+	if (close == std::string_view::npos)
+	{
+		return false;
+	}
+	includeName = line.substr(open + 1, close - open - 1);
+	return true;
+}
+
+std::shared_ptr<const ShaderSourceLoader::Source> ShaderSourceLoader::LoadLocked(const std::string& path, int depth)
+{
+	auto cached = s_cache.find(path);
+	if (cached != s_cache.end() && IsUpToDate(*cached->second))
+	{
+		s_cacheHits++;
+		return cached->second;
+	}
+
+	if (depth > m_maxIncludeDepth)
+	{
+		std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << " (is something including itself?)" << std::endl;
+		return nullptr;
+	}
+
+	// get the file info first, so if the file changes while we're reading it, the next load sees a different time and reads it again
+	auto source = std::make_shared<Source>();
+	source->path = path;
+	Dependency self = { path, 0, 0 };
+	auto file = std::make_shared<MappedFile>();
+	if (!MappedFile::GetFileInfo(path, self.modifiedTime, self.size) || !file->Open(path))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+		return nullptr;
+	}
+	s_filesMapped++;
+	source->files.push_back(file);
+	source->dependencies.push_back(self);
+
+	std::string directory = PathUtilities::GetDirectory(path);
+	std::string_view text = file->GetView();
+
+	// go through line by line, copying nothing. Everything between includes becomes one piece
+	size_t pieceStart = 0;
+	size_t lineStart = 0;
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == std::string_view::npos)
+		{
+			lineEnd = text.size();
+		}
+
+		std::string_view includeName;
+		if (ParseInclude(text.substr(lineStart, lineEnd - lineStart), includeName))
+		{
+			std::shared_ptr<const Source> included = LoadLocked(PathUtilities::Join(directory, std::string(includeName)), depth + 1);
+			if (!included)
+			{
+				std::cout << "  included from " << path << std::endl;
+				return nullptr;
+			}
+			if (lineStart > pieceStart)
+			{
+				source->pieces.push_back(text.substr(pieceStart, lineStart - pieceStart));
+			}
+			source->pieces.insert(source->pieces.end(), included->pieces.begin(), included->pieces.end());
+			source->files.insert(source->files.end(), included->files.begin(), included->files.end());
+			source->dependencies.insert(source->dependencies.end(), included->dependencies.begin(), included->dependencies.end());
+			// the next piece starts at the include line's newline, so whatever comes after still starts on a line of its own
+			pieceStart = lineEnd;
+		}
+		lineStart = lineEnd + 1;
+	}
+	if (pieceStart < text.size())
+	{
+		source->pieces.push_back(text.substr(pieceStart));
+	}
+
+	uint64_t hash = Hash::FnvOffsetBasis;
+	for (std::string_view piece : source->pieces)
+	{
+		hash = Hash::Fnv1a(piece.data(), piece.size(), hash);
+		source->length += piece.size();
+	}
+	source->hash = hash;
+
+	s_cache[path] = source;
+	return source;
+}
+
+std::shared_ptr<const ShaderSourceLoader::Source> ShaderSourceLoader::AddDefines(const std::shared_ptr<const Source>& source, const std::vector<std::string>& defines)
+{
+	if (!source || defines.empty())
+	{
+		return source;
+	}
+
+	auto generated = std::make_shared<std::string>();
+	for (const std::string& define : defines)
+	{
+		*generated += "#define " + define + "\n";
+	}
+
+	auto result = std::make_shared<Source>(*source);
+	result->generated = generated;
+	result->pieces.clear();
+
+	// find the piece with the #version line in it, and split it right after that line
+	bool inserted = false;
+	for (std::string_view piece : source->pieces)
+	{
+		size_t lineStart = 0;
+		while (!inserted && lineStart < piece.size())
+		{
+			size_t lineEnd = piece.find('\n', lineStart);
+			lineEnd = lineEnd == std::string_view::npos ? piece.size() : lineEnd + 1;
+			size_t position = piece.find_first_not_of(" \t", lineStart);
+			if (position < lineEnd && piece.compare(position, 8, "#version") == 0)
+			{
+				result->pieces.push_back(piece.substr(0, lineEnd));
+				// a #version line at the very end of the file has no newline to end it
+				if (piece[lineEnd - 1] != '\n')
+				{
+					result->pieces.push_back("\n");
+				}
+				result->pieces.push_back(*generated);
+				piece = piece.substr(lineEnd);
+				inserted = true;
+			}
+			lineStart = lineEnd;
+		}
+		if (!piece.empty())
+		{
+			result->pieces.push_back(piece);
+		}
+	}
+	if (!inserted)
+	{
+		// no #version (so it's GLSL 1.10), the defines can just go first
+		result->pieces.insert(result->pieces.begin(), *generated);
+	}
+
+	result->hash = Hash::FnvOffsetBasis;
+	result->length = 0;
+	for (std::string_view piece : result->pieces)
+	{
+		result->hash = Hash::Fnv1a(piece.data(), piece.size(), result->hash);
+		result->length += piece.size();
+	}
+	return result;
+}
+
+std::string ShaderSourceLoader::ToString(const Source& source)
+{
+	std::string result;
+	result.reserve(source.length);
+	for (std::string_view piece : source.pieces)
+	{
+		result.append(piece.data(), piece.size());
+	}
+	return result;
+}
+
+void ShaderSourceLoader::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::cout << "Shader sources: " << s_filesMapped << " files mapped, " << s_cacheHits << " loads served from the cache, "
+		<< s_embeddedLoads << " embedded sources used" << std::endl;
+}
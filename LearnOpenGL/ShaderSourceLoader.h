@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+/// <summary>
+/// Finds shader sources by file name. Every shader is embedded in the executable at build time (see EmbedShaders.py),
+/// and that's what gets used unless an override directory is set, in which case the files in it are loaded instead,
+/// so they can be edited (and hot reloaded) without rebuilding. See Configure for how the directory is picked.
+///
+/// Files are loaded by memory mapping them, and #include "file" lines are expanded (paths are relative to the file
+/// doing the including).
+///
+/// Nothing gets copied: the expanded source is a list of pieces pointing straight into the mapped files, which can be
+/// handed to glShaderSource as they are, with their lengths. Expanded files are cached by path and checked against
+/// the modified time and size of every file that went into them, so a snippet included by lots of shaders is only read
+/// once, but an edited file (see ShaderHotReload) is picked up on the next load.
+///
+/// Safe to call from any thread
+/// </summary>
+class ShaderSourceLoader
+{
+public:
+	struct Dependency
+	{
+		std::string path;
+		uint64_t modifiedTime;
+		uint64_t size;
+	};
+
+	struct Source
+	{
+		std::string path;
+		std::vector<std::string_view> pieces;
+		// FNV-1a of all the pieces one after the other, i.e. of the fully expanded source
+		uint64_t hash = 0;
+		size_t length = 0;
+		// the mappings the pieces point into. They stay mapped for as long as anything holds on to this
+		std::vector<std::shared_ptr<const MappedFile>> files;
+		// this file and everything it included
+		std::vector<Dependency> dependencies;
+		// text that was added rather than loaded (see AddDefines), which pieces can point into
+		std::shared_ptr<const std::string> generated;
+	};
+
+	/// <summary>
+	/// Picks where shaders come from: the directory in the LEARNOPENGL_SHADER_DIR environment variable if it's set,
+	/// otherwise in debug builds the source tree's shader directory (LEARNOPENGL_SOURCE_SHADER_DIR, which the project
+	/// file defines) or appPath if that isn't defined (the build copies the shader files there too), and the embedded
+	/// copies in release builds, which then don't touch the file system for shaders at all
+	/// </summary>
+	static void Configure(const std::string& appPath);
+	static void SetOverrideDirectory(const std::string& directory);
+	/// <summary>
+	/// Empty when only the embedded shaders are used
+	/// </summary>
+	static std::string GetOverrideDirectory();
+
+	/// <summary>
+	/// Returns the expanded source of the shader called name (e.g. "vertex.glsl"), or nullptr (after printing an error)
+	/// if there's no such shader or something it includes couldn't be read. If the file isn't in the override
+	/// directory, the embedded copy is used instead
+	/// </summary>
+	static std::shared_ptr<const Source> Load(const std::string& name);
+
+	/// <summary>
+	/// A copy of source with a #define line for each of defines ("NAME" or "NAME value") right after the #version line,
+	/// which has to stay first. The copy shares source's pieces and mappings, so only the new lines are extra
+	/// </summary>
+	static std::shared_ptr<const Source> AddDefines(const std::shared_ptr<const Source>& source, const std::vector<std::string>& defines);
+
+	/// <summary>
+	/// Puts the whole expanded source back together into one string. Only for things like printing it, the point of this
+	/// class is to not need to do that
+	/// </summary>
+	static std::string ToString(const Source& source);
+
+	static void PrintStats();
+
+private:
+	static constexpr int m_maxIncludeDepth = 16;
+
+	static std::mutex s_mutex;
+	static std::string s_overrideDirectory;
+	static std::unordered_map<std::string, std::shared_ptr<const Source>> s_cache;
+	static int s_filesMapped;
+	static int s_cacheHits;
+	static int s_embeddedLoads;
+
+	static std::shared_ptr<const Source> LoadLocked(const std::string& path, int depth);
+	static std::shared_ptr<const Source> LoadEmbedded(const std::string& name);
+	static bool IsUpToDate(const Source& source);
+	static bool ParseInclude(std::string_view line, std::string_view& includeName);
+};
@@ -0,0 +1,128 @@
+#include "ShaderVariants.h"
+#include <algorithm>
+#include <iostream>
+
+#include "ShaderRegistry.h"
+
+ShaderVariants::ShaderVariants(const std::string& vertexName, const std::string& fragmentName)
+{
+	m_vertexName = vertexName;
+	m_fragmentName = fragmentName;
+
+	// only the keyword lines are needed here, nothing gets compiled until a variant is asked for. The loader caches the
+	// sources, so this doesn't cost a second read when the first variant does get loaded
+	for (const std::string& name : { vertexName, fragmentName })
+	{
+		std::shared_ptr<const ShaderSourceLoader::Source> source = ShaderSourceLoader::Load(name);
+		if (source)
+		{
+			ReadKeywords(*source);
+		}
+	}
+	m_validBits = m_keywords.size() == m_maxKeywords ? ~0ull : (1ull << m_keywords.size()) - 1;
+}
+
+/// <summary>
+/// Finds every "#pragma keywords A B C" line and adds the keywords that aren't already known
+/// </summary>
+void ShaderVariants::ReadKeywords(const ShaderSourceLoader::Source& source)
+{
+	// the loader splits pieces on line boundaries, so a line is never spread over two pieces
+	for (std::string_view piece : source.pieces)
+	{
+		size_t lineStart = 0;
+		while (lineStart < piece.size())
+		{
+			size_t lineEnd = piece.find('\n', lineStart);
+			if (lineEnd == std::string_view::npos)
+			{
+				lineEnd = piece.size();
+			}
+			std::string_view line = piece.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+
+			size_t position = line.find_first_not_of(" \t");
+			if (position == std::string_view::npos || line[position] != '#')
+			{
+				continue;
+			}
+			position = line.find_first_not_of(" \t", position + 1);
+			if (position == std::string_view::npos || line.compare(position, 6, "pragma") != 0)
+			{
+				continue;
+			}
+			position = line.find_first_not_of(" \t", position + 6);
+			if (position == std::string_view::npos || line.compare(position, 8, "keywords") != 0)
+			{
+				continue;
+			}
+
+			position += 8;
+			while ((position = line.find_first_not_of(" \t\r", position)) != std::string_view::npos)
+			{
+				size_t end = std::min(line.find_first_of(" \t\r", position), line.size());
+				std::string keyword(line.substr(position, end - position));
+				position = end;
+				if (std::find(m_keywords.begin(), m_keywords.end(), keyword) != m_keywords.end())
+				{
+					continue;
+				}
+				if (m_keywords.size() == m_maxKeywords)
+				{
+					std::cout << "ERROR::SHADER::TOO_MANY_KEYWORDS " << source.path << " ignoring " << keyword << std::endl;
+					continue;
+				}
+				m_keywords.push_back(keyword);
+			}
+		}
+	}
+}
+
+uint64_t ShaderVariants::GetKeywordBit(const std::string& keyword) const
+{
+	auto found = std::find(m_keywords.begin(), m_keywords.end(), keyword);
+	if (found == m_keywords.end())
+	{
+		std::cout << "WARNING::SHADER::UNKNOWN_KEYWORD " << keyword << " isn't declared by " << m_vertexName << " or " << m_fragmentName << std::endl;
+		return 0;
+	}
+	return 1ull << (found - m_keywords.begin());
+}
+
+uint64_t ShaderVariants::GetMask(const std::vector<std::string>& keywords) const
+{
+	uint64_t mask = 0;
+	for (const std::string& keyword : keywords)
+	{
+		mask |= GetKeywordBit(keyword);
+	}
+	return mask;
+}
+
+std::shared_ptr<Shader> ShaderVariants::Get(uint64_t mask, bool async)
+{
+	// bits that don't belong to any keyword make no difference to the source, so they shouldn't make a new variant
+	mask &= m_validBits;
+	auto found = m_variants.find(mask);
+	if (found != m_variants.end())
+	{
+		return found->second;
+	}
+
+	std::vector<std::string> defines;
+	for (size_t i = 0; i < m_keywords.size(); ++i)
+	{
+		if (mask & (1ull << i))
+		{
+			defines.push_back(m_keywords[i]);
+		}
+	}
+	std::shared_ptr<Shader> shader = ShaderRegistry::Load(m_vertexName, m_fragmentName, defines, async);
+	m_variants[mask] = shader;
+	return shader;
+}
+
+void ShaderVariants::Clear()
+{
+	m_variants.clear();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+#include "ShaderSourceLoader.h"
+
+/// <summary>
+/// Every variant of one vertex + fragment shader pair. Instead of keeping near copies of a shader around, a shader
+/// declares the features it can be built with on a line like
+///
+///     #pragma keywords USE_INTERP_UNIFORM MIRROR_SECOND_TEXTURE
+///
+/// and tests them with #ifdef. Each keyword gets a bit (in the order they're declared, vertex shader first), and a
+/// variant is picked by a mask of those bits. A variant is only compiled the first time it's asked for, with a #define
+/// for each of its keywords added after the #version line, and is kept from then on, so a shader with hundreds of
+/// possible variants only ever costs the ones actually used.
+///
+/// Variants are loaded through ShaderRegistry, so they're shared with anything else asking for the same source and
+/// hot reload keeps working. GLSL ignores pragmas it doesn't know, so the keywords line doesn't bother the compiler
+/// </summary>
+class ShaderVariants
+{
+public:
+	ShaderVariants(const std::string& vertexName, const std::string& fragmentName);
+
+	/// <summary>
+	/// The bit for keyword, or 0 (after printing a warning) if neither shader declares it
+	/// </summary>
+	uint64_t GetKeywordBit(const std::string& keyword) const;
+	uint64_t GetMask(const std::vector<std::string>& keywords) const;
+
+	/// <summary>
+	/// The variant with the keywords in mask turned on, compiling it if this is the first time it's been asked for
+	/// </summary>
+	std::shared_ptr<Shader> Get(uint64_t mask, bool async = false);
+
+	const std::vector<std::string>& GetKeywords() const { return m_keywords; }
+	size_t GetCompiledCount() const { return m_variants.size(); }
+
+	/// <summary>
+	/// Lets go of every variant. Programs have to be deleted while the context is still alive, so call this before
+	/// terminating GLFW if this object is going to outlive the context
+	/// </summary>
+	void Clear();
+
+private:
+	static constexpr size_t m_maxKeywords = 64;
+
+	std::string m_vertexName;
+	std::string m_fragmentName;
+	std::vector<std::string> m_keywords;
+	uint64_t m_validBits = 0;
+	std::unordered_map<uint64_t, std::shared_ptr<Shader>> m_variants;
+
+	void ReadKeywords(const ShaderSourceLoader::Source& source);
+};
@@ -0,0 +1,169 @@
+#include "StreamingRingBuffer.h"
+#include <cstring>
+#include <iostream>
+
+#include "GLStateCache.h"
+#include "VertexArrayCache.h"
+
+StreamingRingBuffer::~StreamingRingBuffer()
+{
+	Destroy();
+}
+
+void StreamingRingBuffer::Create(GLenum target, GLsizeiptr capacity, const char* name)
+{
+	m_target = target;
+	m_name = name;
+	m_allocator.Reset((size_t)capacity);
+
+	m_buffer.Create(m_name);
+	m_buffer.SetBytes((size_t)capacity);
+	GLStateCache::BindBuffer(m_target, m_buffer.Get());
+	if (GLAD_GL_VERSION_4_4)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(m_target, capacity, NULL, flags);
+		m_mapped = (unsigned char*)glMapBufferRange(m_target, 0, capacity, flags);
+	}
+	else
+	{
+		glBufferData(m_target, capacity, NULL, GL_STREAM_DRAW);
+	}
+	GLStateCache::BindBuffer(m_target, 0);
+
+	std::cout << "Streaming buffer " << m_name << ": " << capacity << " bytes, "
+		<< (m_mapped ? "persistently mapped" : "mapped unsynchronized per allocation") << std::endl;
+}
+
+void StreamingRingBuffer::Destroy()
+{
+	if (!m_buffer.IsValid())
+	{
+		return;
+	}
+	while (m_allocator.HasSubmittedRegions())
+	{
+		glDeleteSync(ToSync(m_allocator.GetOldestFence()));
+		m_allocator.ReleaseOldest();
+	}
+	if (m_mapped)
+	{
+		GLStateCache::BindBuffer(m_target, m_buffer.Get());
+		glUnmapBuffer(m_target);
+		GLStateCache::BindBuffer(m_target, 0);
+		m_mapped = nullptr;
+	}
+	VertexArrayCache::RemoveBuffer(m_buffer.Get());
+	m_buffer.Reset();
+	std::cout << "Streaming buffer " << m_name << ": wrapped " << m_allocator.GetWrapCount() << " times, waited on the GPU "
+		<< m_fenceWaits << " times" << std::endl;
+}
+
+void StreamingRingBuffer::ReleaseOldest(bool wait)
+{
+	GLsync fence = ToSync(m_allocator.GetOldestFence());
+	if (wait)
+	{
+		// flush, in case the fence itself hasn't been sent to the GPU yet, which would make us wait forever
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	m_allocator.ReleaseOldest();
+}
+
+/// <summary>
+/// Gives back every region whose fence has already passed, without waiting on anything
+/// </summary>
+void StreamingRingBuffer::ReleaseFinished()
+{
+	while (m_allocator.HasSubmittedRegions())
+	{
+		GLenum result = glClientWaitSync(ToSync(m_allocator.GetOldestFence()), 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+		ReleaseOldest(false);
+	}
+}
+
+StreamingRingBuffer::Allocation StreamingRingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation;
+	if (size == 0)
+	{
+		return allocation;
+	}
+	if (size > (GLsizeiptr)m_allocator.GetCapacity())
+	{
+		std::cout << "ERROR::STREAMING_BUFFER " << m_name << ": " << size << " bytes won't fit in " << m_allocator.GetCapacity() << std::endl;
+		return allocation;
+	}
+
+	size_t offset = m_allocator.Allocate((size_t)size, (size_t)alignment);
+	if (offset == RingAllocator::InvalidOffset)
+	{
+		ReleaseFinished();
+		offset = m_allocator.Allocate((size_t)size, (size_t)alignment);
+	}
+	while (offset == RingAllocator::InvalidOffset && m_allocator.HasSubmittedRegions())
+	{
+		// the GPU is still using earlier frames' data. This is a stall, and a sign the buffer is too small
+		m_fenceWaits++;
+		ReleaseOldest(true);
+		offset = m_allocator.Allocate((size_t)size, (size_t)alignment);
+	}
+	if (offset == RingAllocator::InvalidOffset)
+	{
+		// what's left is this frame's own data. The draws that read it may not even have been issued yet, so a fence
+		// now would pass before they've run: there's nothing safe to wait for, and the caller has to make do
+		std::cout << "ERROR::STREAMING_BUFFER " << m_name << ": full of this frame's data, " << size << " more bytes won't fit" << std::endl;
+		return allocation;
+	}
+
+	allocation.offset = (GLintptr)offset;
+	allocation.size = size;
+	if (m_mapped)
+	{
+		allocation.data = m_mapped + offset;
+	}
+	else
+	{
+		GLStateCache::BindBuffer(m_target, m_buffer.Get());
+		allocation.data = glMapBufferRange(m_target, allocation.offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	}
+	return allocation;
+}
+
+void StreamingRingBuffer::Commit(const Allocation& allocation)
+{
+	if (!m_mapped && allocation.data)
+	{
+		GLStateCache::BindBuffer(m_target, m_buffer.Get());
+		glUnmapBuffer(m_target);
+	}
+}
+
+GLintptr StreamingRingBuffer::Write(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation = Allocate(size, alignment);
+	if (!allocation.data)
+	{
+		return -1;
+	}
+	std::memcpy(allocation.data, data, size);
+	Commit(allocation);
+	return allocation.offset;
+}
+
+void StreamingRingBuffer::EndFrame()
+{
+	if (m_allocator.GetUnsubmittedBytes() > 0)
+	{
+		m_allocator.Submit(FromSync(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "GLResources.h"
+#include "RingAllocator.h"
+
+/// <summary>
+/// A GL buffer for data that's rewritten every frame (instance data, uniform blocks, dynamic vertices). Instead of
+/// orphaning the buffer or glBufferSubData-ing into it, which make the driver either copy the data or wait for the
+/// GPU, every write gets fresh space from a RingAllocator, and space is only reused once a fence placed after the
+/// frame that used it has passed. With a big enough buffer (a few frames' worth) that fence has always passed by then,
+/// so nothing ever waits.
+///
+/// With GL 4.4 the buffer is immutable storage mapped once with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, so
+/// Allocate hands out a pointer straight into it and writes need no flushing. On 3.3 each allocation is mapped on its
+/// own with GL_MAP_UNSYNCHRONIZED_BIT (the fences already make that safe), which means it has to be unmapped again
+/// with Commit before drawing. Commit is a no-op when persistently mapped, so always call it.
+///
+/// Call EndFrame once a frame, after the last draw that reads this frame's data
+/// </summary>
+class StreamingRingBuffer
+{
+public:
+	struct Allocation
+	{
+		// where to write, valid until Commit
+		void* data = nullptr;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	StreamingRingBuffer() = default;
+	~StreamingRingBuffer();
+	StreamingRingBuffer(const StreamingRingBuffer&) = delete;
+	StreamingRingBuffer& operator=(const StreamingRingBuffer&) = delete;
+
+	/// <summary>
+	/// target is only used for binding the buffer while setting it up and mapping it. The buffer can be bound to any
+	/// target afterwards. Needs a current context
+	/// </summary>
+	void Create(GLenum target, GLsizeiptr capacity, const char* name);
+	void Destroy();
+
+	/// <summary>
+	/// size bytes at an offset that's a multiple of alignment. Waits for the GPU if the ring is full of earlier frames'
+	/// data it hasn't finished with. Returns an allocation with no data if size is 0, bigger than the whole buffer, or
+	/// doesn't fit beside what's already been written this frame (which is never given back before EndFrame), so skip
+	/// or split the work then
+	/// </summary>
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 4);
+	void Commit(const Allocation& allocation);
+
+	/// <summary>
+	/// Allocate + copy + Commit in one go, for data that's already sitting in memory somewhere. Returns the offset it
+	/// was written to, or -1 if it didn't fit
+	/// </summary>
+	GLintptr Write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 4);
+
+	void EndFrame();
+
+	GLuint GetBuffer() const { return m_buffer.Get(); }
+	bool IsPersistentlyMapped() const { return m_mapped != nullptr; }
+	uint64_t GetFenceWaitCount() const { return m_fenceWaits; }
+	uint64_t GetWrapCount() const { return m_allocator.GetWrapCount(); }
+
+private:
+	GLenum m_target = GL_ARRAY_BUFFER;
+	GLBuffer m_buffer;
+	unsigned char* m_mapped = nullptr;
+	const char* m_name = "";
+	RingAllocator m_allocator;
+	// times the ring was full and we had to wait for the GPU to catch up
+	uint64_t m_fenceWaits = 0;
+
+	void ReleaseOldest(bool wait);
+	void ReleaseFinished();
+	static GLsync ToSync(uint64_t fence) { return (GLsync)(uintptr_t)fence; }
+	static uint64_t FromSync(GLsync sync) { return (uint64_t)(uintptr_t)sync; }
+};
@@ -0,0 +1,251 @@
+#include "TextureLoader.h"
+#include <algorithm>
+#include <iostream>
+#include <stb/stb_image.h>
+
+#include "GLStateCache.h"
+
+TextureLoader::TextureLoader(unsigned int workerCount)
+	: m_decoders(workerCount)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	Destroy();
+}
+
+void TextureLoader::Create(size_t frameByteBudget)
+{
+	m_frameByteBudget = frameByteBudget;
+	// three frames, like the other rings, so by the time a frame's staging space comes round again the GPU has long
+	// since copied out of it
+	m_staging.Create(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)(3 * frameByteBudget), "Texture uploads");
+
+	// a grey checkerboard, so it's obvious what's still loading
+	const unsigned char placeholderPixels[2 * 2 * 4] = {
+		96, 96, 96, 255,     160, 160, 160, 255,
+		160, 160, 160, 255,  96, 96, 96, 255
+	};
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_placeholder.Create("Texture placeholder");
+	GLStateCache::BindTexture(GL_TEXTURE_2D, m_placeholder.Get());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholderPixels);
+	m_placeholder.SetBytes(sizeof(placeholderPixels));
+}
+
+void TextureLoader::Destroy()
+{
+	for (std::unique_ptr<Request>& request : m_requests)
+	{
+		if (request->state == State::Decoding)
+		{
+			m_decoders.Wait(request->decodeJob);
+		}
+		stbi_image_free(request->pixels);
+	}
+	m_requests.clear();
+	m_pending.clear();
+	m_placeholder.Reset();
+	m_staging.Destroy();
+}
+
+TextureLoader::TextureId TextureLoader::Load(const std::string& path, GLint wrapMode)
+{
+	if (m_requests.empty())
+	{
+		m_firstRequestTime = std::chrono::steady_clock::now();
+	}
+	TextureId id = (TextureId)m_requests.size();
+	m_requests.push_back(std::make_unique<Request>());
+	Request* request = m_requests.back().get();
+	request->path = path;
+	request->wrapMode = wrapMode;
+	m_pending.push_back(id);
+	m_stats.requested++;
+
+	// a batch of one. Reading the file happens on the worker too, which is often the slow part
+	m_decoders.Dispatch(request->decodeJob, 1, 1, [request](size_t, size_t) {
+		int channelCount;
+		request->pixels = stbi_load(request->path.c_str(), &request->width, &request->height, &channelCount, 4);
+		if (!request->pixels)
+		{
+			const char* reason = stbi_failure_reason();
+			request->failureReason = reason ? reason : "unknown error";
+		}
+	});
+	return id;
+}
+
+GLuint TextureLoader::GetTexture(TextureId id) const
+{
+	if (id < m_requests.size() && m_requests[id]->state == State::Resident)
+	{
+		return m_requests[id]->texture.Get();
+	}
+	return m_placeholder.Get();
+}
+
+bool TextureLoader::IsResident(TextureId id) const
+{
+	return id < m_requests.size() && m_requests[id]->state == State::Resident;
+}
+
+void TextureLoader::Update()
+{
+	if (!m_firstFrameSeen)
+	{
+		m_firstFrameSeen = true;
+		m_stats.firstFrameMilliseconds = MillisecondsSinceFirstRequest();
+	}
+	if (m_pending.empty())
+	{
+		return;
+	}
+
+	size_t uploaded = 0;
+	for (TextureId id : m_pending)
+	{
+		Request& request = *m_requests[id];
+		if (request.state == State::Decoding)
+		{
+			if (!request.decodeJob.IsDone())
+			{
+				// later ones may well be done already, a small image queued after a big one shouldn't wait for it
+				continue;
+			}
+			if (!request.pixels)
+			{
+				std::cout << "ERROR::TEXTURE_LOADER failed to load " << request.path << ": " << request.failureReason << std::endl;
+				Finish(request, State::Failed);
+				continue;
+			}
+			request.state = State::Uploading;
+		}
+		if (uploaded >= m_frameByteBudget)
+		{
+			continue;
+		}
+		uploaded += UploadRows(request, m_frameByteBudget - uploaded, uploaded == 0);
+	}
+	// whatever else is bound to the unpack target makes glTexImage2D read from it instead of the pointer it's given
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [this](TextureId id) {
+		State state = m_requests[id]->state;
+		return state == State::Resident || state == State::Failed;
+	}), m_pending.end());
+
+	if (uploaded > 0)
+	{
+		m_stats.bytesUploaded += uploaded;
+		m_stats.largestFrameUpload = std::max(m_stats.largestFrameUpload, uploaded);
+		m_stats.uploadFrames++;
+	}
+	if (m_pending.empty())
+	{
+		m_stats.allResidentMilliseconds = MillisecondsSinceFirstRequest();
+	}
+}
+
+void TextureLoader::EndFrame()
+{
+	m_staging.EndFrame();
+}
+
+void TextureLoader::CreateStorage(Request& request)
+{
+	// no data yet, just the space for it: the rows come later, from the staging buffer
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	request.texture.Create(request.path.c_str());
+	GLStateCache::BindTexture(GL_TEXTURE_2D, request.texture.Get());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, request.wrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, request.wrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, request.width, request.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	// the mip chain adds another third
+	request.texture.SetBytes((size_t)request.width * request.height * 4 * 4 / 3);
+}
+
+size_t TextureLoader::UploadRows(Request& request, size_t budget, bool firstThisFrame)
+{
+	size_t rowBytes = (size_t)request.width * 4;
+	size_t rows = std::min((size_t)(request.height - request.uploadedRows), budget / rowBytes);
+	if (rows == 0)
+	{
+		if (!firstThisFrame)
+		{
+			return 0;
+		}
+		// a single row bigger than the budget still has to go some time
+		rows = 1;
+	}
+	if (rows * rowBytes > 3 * m_frameByteBudget)
+	{
+		std::cout << "ERROR::TEXTURE_LOADER " << request.path << " has rows too wide for the staging buffer" << std::endl;
+		Finish(request, State::Failed);
+		return 0;
+	}
+
+	if (!request.texture.IsValid())
+	{
+		CreateStorage(request);
+	}
+	// Write leaves the staging buffer bound to the unpack target on 3.3, but not when it's persistently mapped
+	GLintptr offset = m_staging.Write(request.pixels + request.uploadedRows * rowBytes, (GLsizeiptr)(rows * rowBytes));
+	if (offset < 0)
+	{
+		// no room left beside this frame's uploads. The rows are still there, so they go next frame
+		return 0;
+	}
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_staging.GetBuffer());
+	GLStateCache::BindTexture(GL_TEXTURE_2D, request.texture.Get());
+	// with a buffer bound to the unpack target, the "pointer" is an offset into it
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, request.uploadedRows, request.width, (GLsizei)rows, GL_RGBA, GL_UNSIGNED_BYTE,
+		(const void*)offset);
+	request.uploadedRows += (int)rows;
+
+	if (request.uploadedRows == request.height)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		Finish(request, State::Resident);
+	}
+	return rows * rowBytes;
+}
+
+void TextureLoader::Finish(Request& request, State state)
+{
+	request.state = state;
+	// the GPU copies out of the staging buffer, not out of these, so they can go as soon as the last row is written
+	stbi_image_free(request.pixels);
+	request.pixels = nullptr;
+	if (state == State::Resident)
+	{
+		m_stats.resident++;
+	}
+	else
+	{
+		m_stats.failed++;
+		request.texture.Reset();
+	}
+}
+
+double TextureLoader::MillisecondsSinceFirstRequest() const
+{
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_firstRequestTime;
+	return elapsed.count();
+}
+
+void TextureLoader::PrintStats() const
+{
+	std::cout << "Texture loader: " << m_stats.resident << "/" << m_stats.requested << " textures resident (" << m_stats.failed
+		<< " failed), " << m_stats.bytesUploaded / 1024 << " KB uploaded over " << m_stats.uploadFrames << " frames, at most "
+		<< m_stats.largestFrameUpload / 1024 << " KB in one (budget " << m_frameByteBudget / 1024 << " KB). First frame "
+		<< m_stats.firstFrameMilliseconds << " ms after the first request, all resident after " << m_stats.allResidentMilliseconds
+		<< " ms" << std::endl;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GLResources.h"
+#include "JobSystem.h"
+#include "StreamingRingBuffer.h"
+
+/// <summary>
+/// Loads textures without holding up the frame loop. Load only queues the file: it's read and decoded by stb_image on
+/// the loader's own worker threads (a JobSystem, so decoding never competes with the frame's transform jobs), and the
+/// frame loop calls Update once a frame to upload whatever has been decoded.
+///
+/// Uploads go through a StreamingRingBuffer bound as the GL_PIXEL_UNPACK_BUFFER, so glTexSubImage2D copies from a
+/// buffer the driver can DMA from instead of from our memory, and no more than the frame's byte budget is copied in
+/// per frame. A big image takes a band of rows each frame until it's all there; only then are its mipmaps made and
+/// GetTexture starts handing out the real texture. Until that happens it hands out a placeholder, so anything can be
+/// drawn straight away and the first frame doesn't depend on how many textures there are or how big.
+///
+/// Images are always decoded to RGBA, so every row is a multiple of 4 bytes (GL_UNPACK_ALIGNMENT's default) and the
+/// texture is stored the way drivers keep RGB ones anyway. stb_image's flip setting is global, so set it before the
+/// first Load and leave it alone while anything's decoding
+/// </summary>
+class TextureLoader
+{
+public:
+	using TextureId = uint32_t;
+	static constexpr TextureId InvalidTexture = ~0u;
+
+	struct Stats
+	{
+		size_t requested = 0;
+		size_t resident = 0;
+		size_t failed = 0;
+		uint64_t bytesUploaded = 0;
+		size_t largestFrameUpload = 0;
+		// frames that uploaded anything
+		uint64_t uploadFrames = 0;
+		// from the first Load, to the first Update (i.e. the first frame) and to the last texture becoming resident
+		double firstFrameMilliseconds = 0.0;
+		double allResidentMilliseconds = 0.0;
+	};
+
+	/// <summary>
+	/// Starts workerCount decoding threads. They sleep while there's nothing to decode
+	/// </summary>
+	TextureLoader(unsigned int workerCount = 2);
+	~TextureLoader();
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	/// <summary>
+	/// Makes the placeholder and room to stage three frames of frameByteBudget bytes of uploads. Needs a current context
+	/// </summary>
+	void Create(size_t frameByteBudget);
+	/// <summary>
+	/// Waits for any decodes still going and deletes every texture. Call while the context is still alive
+	/// </summary>
+	void Destroy();
+
+	/// <summary>
+	/// Queues the image at path to be loaded, with wrapMode for both directions. Returns straight away
+	/// </summary>
+	TextureId Load(const std::string& path, GLint wrapMode);
+	/// <summary>
+	/// The texture to bind for id: the real one once it's been fully uploaded, the placeholder until then (or for good,
+	/// if the file couldn't be loaded). Ask every frame, the name changes when it's ready
+	/// </summary>
+	GLuint GetTexture(TextureId id) const;
+	bool IsResident(TextureId id) const;
+	bool IsIdle() const { return m_pending.empty(); }
+
+	/// <summary>
+	/// Call once a frame before drawing: starts uploading textures that have finished decoding, and uploads up to the
+	/// budget's worth of rows
+	/// </summary>
+	void Update();
+	/// <summary>
+	/// Call once a frame, after the last draw, with the other ring buffers' EndFrames
+	/// </summary>
+	void EndFrame();
+
+	const Stats& GetStats() const { return m_stats; }
+	void PrintStats() const;
+
+private:
+	enum class State
+	{
+		Decoding,
+		Uploading,
+		Resident,
+		Failed
+	};
+
+	struct Request
+	{
+		std::string path;
+		GLint wrapMode;
+		State state = State::Decoding;
+		JobSystem::Counter decodeJob;
+		// written by the decode job, only read once decodeJob is done
+		unsigned char* pixels = nullptr;
+		// stb_image keeps this per thread, so it has to be picked up on the thread that failed
+		std::string failureReason;
+		int width = 0;
+		int height = 0;
+		GLTexture texture;
+		int uploadedRows = 0;
+	};
+
+	JobSystem m_decoders;
+	StreamingRingBuffer m_staging;
+	GLTexture m_placeholder;
+	size_t m_frameByteBudget = 0;
+	// a request's address can't change while its decode job is running, hence the pointers
+	std::vector<std::unique_ptr<Request>> m_requests;
+	// decoding or uploading, oldest first
+	std::deque<TextureId> m_pending;
+	Stats m_stats;
+	std::chrono::steady_clock::time_point m_firstRequestTime;
+	bool m_firstFrameSeen = false;
+
+	/// <summary>
+	/// Uploads as many of request's rows as fit in budget bytes (at least one, if nothing else went this frame), and
+	/// finishes the texture off if that was the last of them. Returns the bytes used
+	/// </summary>
+	size_t UploadRows(Request& request, size_t budget, bool firstThisFrame);
+	void CreateStorage(Request& request);
+	void Finish(Request& request, State state);
+	double MillisecondsSinceFirstRequest() const;
+};
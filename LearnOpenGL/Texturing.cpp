@@ -1,21 +1,37 @@
 #include "Texturing.h"
+#include <cstddef>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "VertexArrayCache.h"
+#include "VertexLayout.h"
+
+// how m_vertices is laid out
+using TexturedVertexLayout = VertexLayout<Pos3f, Color3f, UV2f>;
+static_assert(TexturedVertexLayout::Matches<TexturedVertex>(), "TexturedVertexLayout doesn't describe TexturedVertex");
+static_assert(TexturedVertexLayout::MemberMatches<0, decltype(TexturedVertex::position)>(offsetof(TexturedVertex, position)), "position isn't where TexturedVertexLayout expects it");
+static_assert(TexturedVertexLayout::MemberMatches<1, decltype(TexturedVertex::color)>(offsetof(TexturedVertex, color)), "color isn't where TexturedVertexLayout expects it");
+static_assert(TexturedVertexLayout::MemberMatches<2, decltype(TexturedVertex::texCoord)>(offsetof(TexturedVertex, texCoord)), "texCoord isn't where TexturedVertexLayout expects it");
+
 Texturing::Texturing(IApplicationParamsProvider* appParamsProvider)
 {
     m_appParamsProvider = appParamsProvider;
 }
 
-const char* Texturing::GetVertexShaderPath()
+const char* Texturing::GetVertexShaderName()
+{
+    return m_vertexShaderName;
+}
+
+const char* Texturing::GetFragmentShaderName()
 {
-    return m_vertexShaderPath;
+    return m_fragmentShaderName;
 }
 
-const char* Texturing::GetFragmentShaderPath()
+std::vector<std::string> Texturing::GetShaderKeywords()
 {
-    return m_fragmentShaderPath;
+    return { "USE_INTERP_UNIFORM", "MIRROR_SECOND_TEXTURE" };
 }
 
 int Texturing::Run()
@@ -29,22 +45,30 @@ int Texturing::Run()
     
     // images are defined w/ 0 along the y axis at the top, but 
     // OpenGL expects 0 to be at the bottom of the image. So we need to tell STB we want
-    // images to be loaded "flipped":
+    // images to be loaded "flipped". This is global, so it has to happen before the loader's threads start decoding
     stbi_set_flip_vertically_on_load(true);
-
-    unsigned int texture1, texture2;
-    CreateTexture("container.jpg", GL_RGB, texture1, GL_CLAMP_TO_EDGE);
-    CreateTexture("awesomeface.png", GL_RGBA, texture2, GL_REPEAT);
+    m_textureLoader.Create(m_textureUploadBudget);
+
+    // submit both programs before anything else, so the driver can compile them while we load the textures.
+    // Nothing waits for them until they're first used in the render loop, and until then a placeholder is drawn instead
+    // both rectangles use the same variant, so it only gets compiled once and the same program is handed back
+    ShaderVariants variants(GetVertexShaderName(), GetFragmentShaderName());
+    uint64_t variantMask = variants.GetMask(GetShaderKeywords());
+    std::shared_ptr<Shader> shader = variants.Get(variantMask, true);
+    std::shared_ptr<Shader> shader2 = variants.Get(variantMask, true);
+
+    // these come back straight away, and are drawn with a placeholder until they've been decoded and uploaded
+    TextureLoader::TextureId texture1 = CreateTexture("container.jpg", GL_CLAMP_TO_EDGE);
+    TextureLoader::TextureId texture2 = CreateTexture("awesomeface.png", GL_REPEAT);
     unsigned int VAO;
     CreateRectangle(VAO);
 
     unsigned int VAO2;
     CreateRectangle(VAO2);
 
-    // auto vertPath = m_appParamsProvider->GetAppPath() + "\\vertex_textured.glsl";
-    auto vertPath = m_appParamsProvider->GetAppPath() + GetVertexShaderPath();
-    auto fragPath = m_appParamsProvider->GetAppPath() + GetFragmentShaderPath();
-    Shader shader = *(new Shader(vertPath.c_str(), fragPath.c_str()));
+    // edit a shader file while this is running to see the change without restarting. This has to start before any
+    // uniforms are set, since it's what makes the shaders remember the values to put back on a reloaded program
+    ShaderHotReload::Start();
 
     // This is how you would set texture uniform, but if your shader uses only one,
     // it just sets it by default when you bind the texture. You don't even need to
@@ -54,22 +78,42 @@ int Texturing::Run()
     
     // since we have two texture, we will have to set the uniforms for them
     // NOTE: the numbers used in the 2nd param should match the ones you will call later on with
-    // "glActiveTexture(GL_TEXTURE<number>);", and NOT the textureIDs you get from the CreateTexture calls.
+    // "glActiveTexture(GL_TEXTURE<number>);", and NOT the textures you get from the texture loader.
     // This is essentially saying to the pipeline, when the shaders ask for these texture sampler uniforms,
     // grab them from the available Textures 0 and 1 (OpenGL supports up to 16). It is the glBindTexture
     // call in the render loop that attaches the actual textureIDs to these "active" textures.
-    shader.use(); // VERY IMPORTANT: you must USE the program before you can set any uniforms, or it will not do anything!!
-    shader.setInt("texture1", 0);
-    shader.setInt("texture2", 1);
-    shader.setFloat("interp", m_interp);
-
-    Shader shader2 = *(new Shader(vertPath.c_str(), fragPath.c_str()));
-    shader2.use();
-    shader2.setInt("texture1", 0);
-    shader2.setInt("texture2", 1);
-    shader2.setFloat("interp", m_interp);
-
-    return ExecuteWindow(window, shader, shader2, VAO, VAO2, texture1, texture2);
+    shader->use(); // VERY IMPORTANT: you must USE the program before you can set any uniforms, or it will not do anything!!
+    shader->setInt("texture1", 0);
+    shader->setInt("texture2", 1);
+    shader->setFloat("interp", m_interp);
+
+    // these get remembered, so they're applied once the programs are done compiling and put back after a reload
+    shader2->use();
+    shader2->setInt("texture1", 0);
+    shader2->setInt("texture2", 1);
+    shader2->setFloat("interp", m_interp);
+
+    int ret = ExecuteWindow(window, *shader, *shader2, VAO, VAO2, texture1, texture2);
+    ShaderHotReload::Stop();
+    m_geometryPool.PrintStats();
+    m_geometryPool.Destroy();
+    VertexArrayCache::PrintStats();
+    VertexArrayCache::Clear();
+
+    // the programs and textures have to be deleted while there's still a context to delete them from, so let go of them
+    // before terminating GLFW. Anything GLResourceRegistry still knows about after that was leaked
+    shader.reset();
+    shader2.reset();
+    variants.Clear();
+    m_textureLoader.PrintStats();
+    m_textureLoader.Destroy();
+    Shader::deletePlaceholder();
+    ShaderRegistry::PrintDiagnostics();
+    ShaderSourceLoader::PrintStats();
+    GLResourceRegistry::PrintStats();
+    GLResourceRegistry::ReportLeaks();
+    glfwTerminate();
+    return ret;
 }
 
 void Texturing::GetTransform(glm::mat4& transform) {
@@ -84,89 +128,51 @@ void Texturing::GetTransform2(glm::mat4& transform) {
     transform = glm::scale(transform, glm::vec3(scaleScalar, scaleScalar, scaleScalar));
 }
 
-void Texturing::CreateTexture(std::string imageFileName, GLenum format, GLuint& textureID, GLint wrapMode)
+TextureLoader::TextureId Texturing::CreateTexture(std::string imageFileName, GLint wrapMode)
 {
-    int width, height, colorChannelCount;
-
-    // stbi = STB_image. STB = Sean T. Barrett, author of the library
-    // image is a bunch of 8 bit (char) values. 6 for rgb, 2 for alpha
-    unsigned char* data = stbi_load((m_appParamsProvider->GetAppPath() + "\\" + imageFileName).c_str(), &width, &height, &colorChannelCount, 0);
-    // *Skimming the stb implementation, I think the last parameter is for specifying how
-    // many channels you want to retrieve. Setting it to 0 just returns all 4 channels
-
-    // create a texture in OpenGL's state, bind it to GL_TEXTURE_2D
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    // actually generate the texture from the loaded container.jpg data
-    glTexImage2D(
-        // specifies to generate a texture on the currently bound texture of target GL_TEXTURE_2D
-        // any textures bound to GL_TEXTURE_1D or _3D are unaffected
-        GL_TEXTURE_2D,
-        // mipmap level to create texture for (first lvl is 0)
-        0,
-        // format to store texture in
-        GL_RGB,
-        width,
-        height,
-        // this param should always be 0. It's a legacy thing
-        0,
-        // source format
-        format,
-        // source per-pixel type
-        GL_UNSIGNED_BYTE,
-        // finally, the image data itself
-        data
-    );
-    // create multiple levels of mipmaps for the texture
-    // OpenGL just has a function for this which is pretty convenient
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data); // good practice to clean shit up!
+    // stbi = STB_image. STB = Sean T. Barrett, author of the library. The loader reads and decodes the file with it on
+    // another thread, and uploads it through a pixel buffer over the next few frames
+    return m_textureLoader.Load(PathUtilities::Join(m_appParamsProvider->GetAppPath(), imageFileName), wrapMode);
 }
 
 void Texturing::CreateRectangle(GLuint& VAO)
 {
-    // array object to store raw vertices, element buffers, and vertex attribute settings
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // raw vertices
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    size_t size;
-    const float* vertices = GetVertices(size);
-    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
-
-    // element buffer
-    unsigned int EBO;
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m_indices), m_indices, GL_STATIC_DRAW);
-
-    GLsizei stride = 8 * sizeof(float);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+    // both rectangles are the same, so the mesh only gets added once, and the VAO comes from VertexArrayCache, which
+    // hands back the same one for the same layout and buffers
+    if (m_rectangleMesh == GeometryPool::InvalidMesh)
+    {
+        if (!m_geometryPool.IsCreated())
+        {
+            m_geometryPool.Create(TexturedVertexLayout::Stride, 1024, 4096, "Texturing");
+        }
+        size_t size;
+        const void* vertices = GetVertices(size);
+        static_assert(sizeof(m_indices[0]) == sizeof(uint32_t), "the pool's indices are GL_UNSIGNED_INT");
+        m_rectangleMesh = m_geometryPool.Add(vertices, size / sizeof(TexturedVertex), m_indices, sizeof(m_indices) / sizeof(m_indices[0]));
+    }
+
+    // adding meshes can move the pool to new buffers, so get them after
+    GLuint vertexBuffer = m_geometryPool.GetVertexBuffer();
+    VAO = VertexArrayCache::Bind(TexturedVertexLayout::GetFormat(), &vertexBuffer, nullptr, m_geometryPool.GetIndexBuffer());
 }
 
 int Texturing::SetupWindow(GLFWwindow*& window)
 {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // ask for 4.3 first, which the GPU culling path needs (see GpuCulling). Everything else is written against 3.3, so
+    // if the driver can't do 4.3 (macOS stops at 4.1), a 3.3 context is fine and those paths fall back on their own
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     window = glfwCreateWindow(m_windowWidth, m_windowHeight, "Texturing", NULL, NULL);
     if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(m_windowWidth, m_windowHeight, "Texturing", NULL, NULL);
+    }
+    if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -179,6 +185,8 @@ int Texturing::SetupWindow(GLFWwindow*& window)
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GLStateCache::Invalidate();
+    std::cout << "OpenGL " << glGetString(GL_VERSION) << std::endl;
 
     glViewport(0, 0, m_windowWidth, m_windowHeight);
 
@@ -187,42 +195,66 @@ int Texturing::SetupWindow(GLFWwindow*& window)
 }
 
 int Texturing::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader& shader2, unsigned int VAO, unsigned int VAO2, unsigned int texture1, unsigned int texture2) {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    GLStateCache::PolygonMode(GL_FILL);
+
+    // look the uniforms up once here instead of by name every frame
+    UniformHandle transformUniform = shader.getUniformHandle("transform", GL_FLOAT_MAT4);
+    UniformHandle transformUniform2 = shader2.getUniformHandle("transform", GL_FLOAT_MAT4);
+    // the rectangles share a program (see ShaderRegistry), so interp is set per draw. The arrow keys only fade the
+    // first one, the second keeps the amount it started with
+    UniformHandle interpUniform = shader.getUniformHandle("interp", GL_FLOAT);
+    UniformHandle interpUniform2 = shader2.getUniformHandle("interp", GL_FLOAT);
+    const float interp2 = m_interp;
 
     while (!glfwWindowShouldClose(window))
     {
         GLFWUtilities::closeWindowIfEscapePressed(window);
-        updateInterpAmount(window, shader);
+        ShaderHotReload::Update();
+        m_textureLoader.Update();
+        updateInterpAmount(window);
 
         glClearColor(0.3f, 0.6f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        shader.use();
-
         glm::mat4 transform = glm::mat4(1.0);
         GetTransform(transform);
-        shader.setMat4("transform", glm::value_ptr(transform));
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, sizeof(m_indices), GL_UNSIGNED_INT, 0);
-
-        shader2.use();
         glm::mat4 transform2 = glm::mat4(1.0);
         GetTransform2(transform2);
-        shader2.setMat4("transform", glm::value_ptr(transform2));
-        glBindVertexArray(VAO2);
-        glDrawElements(GL_TRIANGLES, sizeof(m_indices), GL_UNSIGNED_INT, 0);
+
+        // both rectangles are flat on the screen, so depth only says which one goes on top: the second one, drawn last
+        RenderQueue::Command rectangle;
+        rectangle.shader = &shader;
+        rectangle.vertexArray = VAO;
+        rectangle.textures[0] = m_textureLoader.GetTexture(texture1);
+        rectangle.textures[1] = m_textureLoader.GetTexture(texture2);
+        rectangle.indexType = GL_UNSIGNED_INT;
+        const GeometryPool::Mesh& rectangleMesh = m_geometryPool.GetMesh(m_rectangleMesh);
+        rectangle.count = rectangleMesh.indexCount;
+        rectangle.first = rectangleMesh.firstIndex;
+        rectangle.baseVertex = rectangleMesh.baseVertex;
+        rectangle.matrixUniform = transformUniform;
+        rectangle.matrix = glm::value_ptr(transform);
+        rectangle.floatUniform = interpUniform;
+        rectangle.floatValue = m_interp;
+        m_renderQueue.Submit(rectangle, 0.0f);
+
+        rectangle.shader = &shader2;
+        rectangle.vertexArray = VAO2;
+        rectangle.matrixUniform = transformUniform2;
+        rectangle.matrix = glm::value_ptr(transform2);
+        rectangle.floatUniform = interpUniform2;
+        rectangle.floatValue = interp2;
+        m_renderQueue.Submit(rectangle, 1.0f);
+
+        m_renderQueue.Execute();
+        m_textureLoader.EndFrame();
+        GLStateCache::EndFrame();
+        VertexArrayCache::EndFrame();
 
         glfwPollEvents();
 
         glfwSwapBuffers(window);
     }
-    glfwTerminate();
     return 0;
 }
 
@@ -231,23 +263,22 @@ int Texturing::ExecuteWindow(GLFWwindow* window, Shader& shader, Shader& shader2
 /// so that I don't have to wait a long time if I pressed up/down for too long before the
 /// image changes
 /// </summary>
-void Texturing::updateInterpAmount(GLFWwindow* window, Shader& shader)
+void Texturing::updateInterpAmount(GLFWwindow* window)
 {
+    // only changes the value, it gets set on the first rectangle's draw
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
     {
         m_interp -= m_fadeSpeed;
         m_interp = std::clamp(m_interp, 0.f, 1.f);
-        shader.setFloat("interp", m_interp);
     }
     else if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
     {
         m_interp += m_fadeSpeed;
-        shader.setFloat("interp", m_interp);
         m_interp = std::clamp(m_interp, 0.f, 1.f);
     }
 }
 
-const float* Texturing::GetVertices(size_t& size) {
+const void* Texturing::GetVertices(size_t& size) {
     size = sizeof(m_vertices);
     return m_vertices;
 }
\ No newline at end of file
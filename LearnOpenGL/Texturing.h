@@ -7,30 +7,48 @@
 #include <stb/stb_image.h>
 #include <iostream>
 #include <algorithm>
+#include <string>
+#include <vector>
 
+#include "GeometryPool.h"
 #include "GLFWUtilities.h"
+#include "GLResources.h"
+#include "GLStateCache.h"
 #include "IApplicationParamsProvider.h"
 #include "OpenGLUtilities.h"
+#include "PathUtilities.h"
+#include "RenderQueue.h"
 #include "Shader.h"
+#include "ShaderHotReload.h"
+#include "ShaderRegistry.h"
+#include "ShaderVariants.h"
+#include "TextureLoader.h"
+
+// one corner of the rectangles, as m_vertices stores them (see TexturedVertexLayout in Texturing.cpp)
+struct TexturedVertex
+{
+    float position[3];
+    float color[3];
+    float texCoord[2];
+};
 
 class Texturing
 {
 private:
-    static constexpr const char* m_vertexShaderPath = "\\vertex_textured_transformed.glsl";
-    static constexpr const char* m_fragmentShaderPath = "\\fragment_textured.glsl";
+    static constexpr const char* m_vertexShaderName = "vertex_textured_transformed.glsl";
+    static constexpr const char* m_fragmentShaderName = "fragment_textured.glsl";
 	static constexpr int m_windowWidth = 800;
 	static constexpr int m_windowHeight = 600;
     float m_interp = 0.5f;
     static constexpr float m_fadeSpeed = 0.01f;
 	IApplicationParamsProvider* m_appParamsProvider;
 protected:
-    static constexpr int m_verticesSize = 32;
-    static constexpr float m_vertices[m_verticesSize] = {
-        // positions          // colors           // texture coords
-         0.7f,  0.7f, 0.0f,   1.0f, 0.0f, 0.0f,   1.5f, 1.5f,   // top right
-         0.7f, -0.7f, 0.0f,   0.0f, 1.0f, 0.0f,   1.5f, 0.5f,   // bottom right
-        -0.7f, -0.7f, 0.0f,   0.0f, 0.0f, 1.0f,   0.5f, 0.5f,   // bottom left
-        -0.7f,  0.7f, 0.0f,   1.0f, 1.0f, 0.0f,   0.5f, 1.5f    // top left 
+    static constexpr TexturedVertex m_vertices[4] = {
+        // positions             // colors              // texture coords
+        { {  0.7f,  0.7f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.5f, 1.5f } },   // top right
+        { {  0.7f, -0.7f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 1.5f, 0.5f } },   // bottom right
+        { { -0.7f, -0.7f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.5f, 0.5f } },   // bottom left
+        { { -0.7f,  0.7f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.5f, 1.5f } }    // top left
     };
 
     // elements
@@ -39,16 +57,35 @@ protected:
         1, 2, 3    // second triangle
     };
 
+    // the frame's draws are submitted here and issued sorted by state, instead of straight from the frame loop
+    RenderQueue m_renderQueue;
+
+    // every static mesh lives in here, so drawing another one doesn't bind other buffers (see GeometryPool). Created
+    // by CreateRectangle, for the vertex format of whichever app this is
+    GeometryPool m_geometryPool;
+
+    // the textures are loaded in the background while the frame loop runs (see TextureLoader). ExecuteWindow's
+    // texture1 and texture2 are ids from this, to be swapped for a texture name with GetTexture every frame
+    TextureLoader m_textureLoader;
+    // at most this much texture data gets uploaded per frame
+    static constexpr size_t m_textureUploadBudget = 1024 * 1024;
+
+private:
+    GeometryPool::MeshId m_rectangleMesh = GeometryPool::InvalidMesh;
+
 private:
-    void CreateTexture(std::string imageFileName, GLenum format, GLuint& textureID, GLint wrapMode);
+    TextureLoader::TextureId CreateTexture(std::string imageFileName, GLint wrapMode);
     int SetupWindow(GLFWwindow*& window);
 
-    void updateInterpAmount(GLFWwindow* window, Shader& shader);
+    void updateInterpAmount(GLFWwindow* window);
 protected:
     virtual int ExecuteWindow(GLFWwindow* window, Shader& shader, Shader& shader2, unsigned int VAO, unsigned int VAO2, unsigned int texture1, unsigned int texture2);
-    virtual const float* GetVertices(size_t& size);
-    virtual const char* GetVertexShaderPath();
-    virtual const char* GetFragmentShaderPath();
+    // the vertices in whatever layout the app draws them with, and their size in bytes
+    virtual const void* GetVertices(size_t& size);
+    virtual const char* GetVertexShaderName();
+    virtual const char* GetFragmentShaderName();
+    // which of the shaders' #pragma keywords to build them with (see ShaderVariants)
+    virtual std::vector<std::string> GetShaderKeywords();
     virtual void CreateRectangle(GLuint& VAO);
 
 public:
@@ -0,0 +1,327 @@
+#include "TransformKernel.h"
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+// SIMD is only available on x86. Everywhere else we always take the scalar path
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC lets you use any intrinsic anywhere, it's up to us to only call them if the CPU has them
+#define TRANSFORM_KERNEL_TARGET_AVX2
+#else
+// gcc and clang only let you use AVX intrinsics in functions that are explicitly compiled for AVX
+#define TRANSFORM_KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+void TransformBatch::Resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    angleDegrees.resize(count);
+}
+
+TransformKernel::TransformKernel(glm::vec3 rotationAxis) : TransformKernel(rotationAxis, DetectInstructionSet())
+{
+}
+
+TransformKernel::TransformKernel(glm::vec3 rotationAxis, InstructionSet instructionSet)
+{
+    m_rotationAxis = rotationAxis;
+    // this is the same normalize glm::rotate does internally, so the axis comes out the same down to the last bit
+    m_normalizedAxis = glm::normalize(rotationAxis);
+    m_instructionSet = instructionSet;
+}
+
+TransformKernel::InstructionSet TransformKernel::GetInstructionSet() const
+{
+    return m_instructionSet;
+}
+
+TransformKernel::InstructionSet TransformKernel::DetectInstructionSet()
+{
+#ifdef TRANSFORM_KERNEL_X86
+#ifdef _MSC_VER
+    // CPUID leaf 7, EBX bit 5 says the CPU has AVX2. But the OS also has to save the upper halves of the
+    // ymm registers on a context switch, which is what the OSXSAVE bit + XCR0 check is for
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 5)) != 0)
+        {
+            return InstructionSet::AVX2;
+        }
+    }
+    // SSE2 is part of x64, and MSVC already assumes it on 32 bit builds too
+    return InstructionSet::SSE;
+#else
+    // this checks the OS support as well
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return InstructionSet::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return InstructionSet::SSE;
+    }
+    return InstructionSet::Scalar;
+#endif
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+const char* TransformKernel::GetInstructionSetName(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case InstructionSet::SSE:
+        return "SSE";
+    case InstructionSet::AVX2:
+        return "AVX2";
+    default:
+        return "Scalar";
+    }
+}
+
+void TransformKernel::ComputeModelMatrices(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    switch (m_instructionSet)
+    {
+    case InstructionSet::AVX2:
+        ComputeAVX2(batch, first, count, out);
+        break;
+    case InstructionSet::SSE:
+        ComputeSSE(batch, first, count, out);
+        break;
+    default:
+        ComputeScalar(batch, first, count, out);
+        break;
+    }
+}
+
+/// <summary>
+/// The reference implementation. This is exactly what the cube loop used to do per cube
+/// </summary>
+void TransformKernel::ComputeScalar(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    for (size_t i = first; i < first + count; ++i)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(batch.x[i], batch.y[i], batch.z[i]));
+        model = glm::rotate(model, glm::radians(batch.angleDegrees[i]), m_rotationAxis);
+        out[i] = model;
+    }
+}
+
+#ifdef TRANSFORM_KERNEL_X86
+
+// Everything below mirrors glm::translate(glm::mat4(1.0f), position) followed by glm::rotate(model, angle, axis).
+// glm multiplies the rotation into the translate matrix, which is the identity apart from its last column, so most of
+// the products are by 1 or 0. A product by 1 gives back the same float, so we can skip it, but we still add the
+// products by 0 in the same order glm does, otherwise a -0.0f could come out as +0.0f and the matrices wouldn't be
+// bit-identical any more.
+
+void TransformKernel::ComputeSSE(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    const size_t end = first + count;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 ax = _mm_set1_ps(m_normalizedAxis.x);
+    const __m128 ay = _mm_set1_ps(m_normalizedAxis.y);
+    const __m128 az = _mm_set1_ps(m_normalizedAxis.z);
+
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        alignas(16) float cosines[4];
+        alignas(16) float sines[4];
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            float angle = glm::radians(batch.angleDegrees[i + lane]);
+            cosines[lane] = std::cos(angle);
+            sines[lane] = std::sin(angle);
+        }
+        __m128 c = _mm_load_ps(cosines);
+        __m128 s = _mm_load_ps(sines);
+
+        // temp = (1 - c) * axis
+        __m128 oneMinusC = _mm_sub_ps(one, c);
+        __m128 t0 = _mm_mul_ps(oneMinusC, ax);
+        __m128 t1 = _mm_mul_ps(oneMinusC, ay);
+        __m128 t2 = _mm_mul_ps(oneMinusC, az);
+
+        // the rotation matrix, one register per element, each holding that element for 4 objects
+        __m128 r[3][3];
+        r[0][0] = _mm_add_ps(c, _mm_mul_ps(t0, ax));
+        r[0][1] = _mm_add_ps(_mm_mul_ps(t0, ay), _mm_mul_ps(s, az));
+        r[0][2] = _mm_sub_ps(_mm_mul_ps(t0, az), _mm_mul_ps(s, ay));
+        r[1][0] = _mm_sub_ps(_mm_mul_ps(t1, ax), _mm_mul_ps(s, az));
+        r[1][1] = _mm_add_ps(c, _mm_mul_ps(t1, ay));
+        r[1][2] = _mm_add_ps(_mm_mul_ps(t1, az), _mm_mul_ps(s, ax));
+        r[2][0] = _mm_add_ps(_mm_mul_ps(t2, ax), _mm_mul_ps(s, ay));
+        r[2][1] = _mm_sub_ps(_mm_mul_ps(t2, ay), _mm_mul_ps(s, ax));
+        r[2][2] = _mm_add_ps(c, _mm_mul_ps(t2, az));
+
+        float* destination = &out[i][0][0];
+        for (int column = 0; column < 3; ++column)
+        {
+            __m128 zr0 = _mm_mul_ps(zero, r[column][0]);
+            __m128 zr1 = _mm_mul_ps(zero, r[column][1]);
+            __m128 zr2 = _mm_mul_ps(zero, r[column][2]);
+            __m128 e0 = _mm_add_ps(_mm_add_ps(r[column][0], zr1), zr2);
+            __m128 e1 = _mm_add_ps(_mm_add_ps(zr0, r[column][1]), zr2);
+            __m128 e2 = _mm_add_ps(_mm_add_ps(zr0, zr1), r[column][2]);
+            __m128 e3 = _mm_add_ps(_mm_add_ps(zr0, zr1), zr2);
+
+            // turn "element k of 4 objects" into "column of object k" so we can store whole columns
+            _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+            _mm_storeu_ps(destination + 0 * 16 + column * 4, e0);
+            _mm_storeu_ps(destination + 1 * 16 + column * 4, e1);
+            _mm_storeu_ps(destination + 2 * 16 + column * 4, e2);
+            _mm_storeu_ps(destination + 3 * 16 + column * 4, e3);
+        }
+
+        // translation column
+        __m128 x = _mm_loadu_ps(&batch.x[i]);
+        __m128 y = _mm_loadu_ps(&batch.y[i]);
+        __m128 z = _mm_loadu_ps(&batch.z[i]);
+        __m128 zx = _mm_mul_ps(zero, x);
+        __m128 zy = _mm_mul_ps(zero, y);
+        __m128 zz = _mm_mul_ps(zero, z);
+        __m128 e0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(x, zy), zz), zero);
+        __m128 e1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(zx, y), zz), zero);
+        __m128 e2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(zx, zy), z), zero);
+        __m128 e3 = _mm_add_ps(_mm_add_ps(_mm_add_ps(zx, zy), zz), one);
+        _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+        _mm_storeu_ps(destination + 0 * 16 + 12, e0);
+        _mm_storeu_ps(destination + 1 * 16 + 12, e1);
+        _mm_storeu_ps(destination + 2 * 16 + 12, e2);
+        _mm_storeu_ps(destination + 3 * 16 + 12, e3);
+    }
+
+    // whatever doesn't fill a whole register
+    ComputeScalar(batch, i, end - i, out);
+}
+
+/// <summary>
+/// Stores the 4 registers (element 0 to 3 of a column, for 8 objects each) as that column of 8 consecutive matrices
+/// </summary>
+TRANSFORM_KERNEL_TARGET_AVX2
+static inline void StoreColumnAVX2(float* destination, int column, __m256 e0, __m256 e1, __m256 e2, __m256 e3)
+{
+    // the 4x8 version of _MM_TRANSPOSE4_PS. AVX shuffles only work within each 128 bit half, so after this the low half
+    // of u0 is object 0's column and the high half is object 4's, and so on
+    __m256 t0 = _mm256_unpacklo_ps(e0, e1);
+    __m256 t1 = _mm256_unpackhi_ps(e0, e1);
+    __m256 t2 = _mm256_unpacklo_ps(e2, e3);
+    __m256 t3 = _mm256_unpackhi_ps(e2, e3);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    _mm_storeu_ps(destination + 0 * 16 + column * 4, _mm256_castps256_ps128(u0));
+    _mm_storeu_ps(destination + 1 * 16 + column * 4, _mm256_castps256_ps128(u1));
+    _mm_storeu_ps(destination + 2 * 16 + column * 4, _mm256_castps256_ps128(u2));
+    _mm_storeu_ps(destination + 3 * 16 + column * 4, _mm256_castps256_ps128(u3));
+    _mm_storeu_ps(destination + 4 * 16 + column * 4, _mm256_extractf128_ps(u0, 1));
+    _mm_storeu_ps(destination + 5 * 16 + column * 4, _mm256_extractf128_ps(u1, 1));
+    _mm_storeu_ps(destination + 6 * 16 + column * 4, _mm256_extractf128_ps(u2, 1));
+    _mm_storeu_ps(destination + 7 * 16 + column * 4, _mm256_extractf128_ps(u3, 1));
+}
+
+TRANSFORM_KERNEL_TARGET_AVX2
+static void ComputeBlockAVX2(const float* angleDegrees, const float* px, const float* py, const float* pz, const glm::vec3& axis, float* destination)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 ax = _mm256_set1_ps(axis.x);
+    const __m256 ay = _mm256_set1_ps(axis.y);
+    const __m256 az = _mm256_set1_ps(axis.z);
+
+    alignas(32) float cosines[8];
+    alignas(32) float sines[8];
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        float angle = glm::radians(angleDegrees[lane]);
+        cosines[lane] = std::cos(angle);
+        sines[lane] = std::sin(angle);
+    }
+    __m256 c = _mm256_load_ps(cosines);
+    __m256 s = _mm256_load_ps(sines);
+
+    // same steps as the SSE version, just 8 wide
+    __m256 oneMinusC = _mm256_sub_ps(one, c);
+    __m256 t0 = _mm256_mul_ps(oneMinusC, ax);
+    __m256 t1 = _mm256_mul_ps(oneMinusC, ay);
+    __m256 t2 = _mm256_mul_ps(oneMinusC, az);
+
+    __m256 r[3][3];
+    r[0][0] = _mm256_add_ps(c, _mm256_mul_ps(t0, ax));
+    r[0][1] = _mm256_add_ps(_mm256_mul_ps(t0, ay), _mm256_mul_ps(s, az));
+    r[0][2] = _mm256_sub_ps(_mm256_mul_ps(t0, az), _mm256_mul_ps(s, ay));
+    r[1][0] = _mm256_sub_ps(_mm256_mul_ps(t1, ax), _mm256_mul_ps(s, az));
+    r[1][1] = _mm256_add_ps(c, _mm256_mul_ps(t1, ay));
+    r[1][2] = _mm256_add_ps(_mm256_mul_ps(t1, az), _mm256_mul_ps(s, ax));
+    r[2][0] = _mm256_add_ps(_mm256_mul_ps(t2, ax), _mm256_mul_ps(s, ay));
+    r[2][1] = _mm256_sub_ps(_mm256_mul_ps(t2, ay), _mm256_mul_ps(s, ax));
+    r[2][2] = _mm256_add_ps(c, _mm256_mul_ps(t2, az));
+
+    for (int column = 0; column < 3; ++column)
+    {
+        __m256 zr0 = _mm256_mul_ps(zero, r[column][0]);
+        __m256 zr1 = _mm256_mul_ps(zero, r[column][1]);
+        __m256 zr2 = _mm256_mul_ps(zero, r[column][2]);
+        __m256 e0 = _mm256_add_ps(_mm256_add_ps(r[column][0], zr1), zr2);
+        __m256 e1 = _mm256_add_ps(_mm256_add_ps(zr0, r[column][1]), zr2);
+        __m256 e2 = _mm256_add_ps(_mm256_add_ps(zr0, zr1), r[column][2]);
+        __m256 e3 = _mm256_add_ps(_mm256_add_ps(zr0, zr1), zr2);
+        StoreColumnAVX2(destination, column, e0, e1, e2, e3);
+    }
+
+    __m256 x = _mm256_loadu_ps(px);
+    __m256 y = _mm256_loadu_ps(py);
+    __m256 z = _mm256_loadu_ps(pz);
+    __m256 zx = _mm256_mul_ps(zero, x);
+    __m256 zy = _mm256_mul_ps(zero, y);
+    __m256 zz = _mm256_mul_ps(zero, z);
+    __m256 e0 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x, zy), zz), zero);
+    __m256 e1 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(zx, y), zz), zero);
+    __m256 e2 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(zx, zy), z), zero);
+    __m256 e3 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(zx, zy), zz), one);
+    StoreColumnAVX2(destination, 3, e0, e1, e2, e3);
+}
+
+void TransformKernel::ComputeAVX2(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    const size_t end = first + count;
+    size_t i = first;
+    for (; i + 8 <= end; i += 8)
+    {
+        ComputeBlockAVX2(&batch.angleDegrees[i], &batch.x[i], &batch.y[i], &batch.z[i], m_normalizedAxis, &out[i][0][0]);
+    }
+
+    // the leftovers can still go 4 at a time
+    ComputeSSE(batch, i, end - i, out);
+}
+
+#else
+
+void TransformKernel::ComputeSSE(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    ComputeScalar(batch, first, count, out);
+}
+
+void TransformKernel::ComputeAVX2(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const
+{
+    ComputeScalar(batch, first, count, out);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Positions and rotation angles of a group of objects, stored as a structure of arrays rather than an array of
+/// structures. That way the SIMD kernel can load the x of 4 (or 8) objects with a single instruction instead of
+/// having to gather them out of an array of vec3s.
+/// </summary>
+struct TransformBatch
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> angleDegrees;
+
+    void Resize(size_t count);
+    size_t Size() const { return x.size(); }
+};
+
+/// <summary>
+/// Builds model matrices of the form translate(position) * rotate(angle, axis) for a whole batch of objects at once,
+/// which is what the cube loop in CoordinateSystems used to do one cube at a time with glm::translate and glm::rotate.
+/// The rotation axis is fixed per kernel, so it only gets normalized once.
+///
+/// There is an SSE path (4 objects per iteration) and an AVX2 path (8 objects per iteration), picked at runtime based
+/// on what the CPU supports, and a scalar path that just calls glm. The SIMD paths do exactly the same float
+/// operations in the same order as glm does, so they produce bit-identical matrices. sin/cos are still done one at a
+/// time with the standard library so they match too.
+/// </summary>
+class TransformKernel
+{
+public:
+    enum class InstructionSet { Scalar, SSE, AVX2 };
+
+    TransformKernel(glm::vec3 rotationAxis);
+    TransformKernel(glm::vec3 rotationAxis, InstructionSet instructionSet);
+
+    /// <summary>
+    /// Writes the model matrices of objects [first, first + count) of the batch into out[first] to out[first + count - 1].
+    /// The range lets callers split one batch into chunks and compute them on different threads.
+    /// </summary>
+    void ComputeModelMatrices(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const;
+    InstructionSet GetInstructionSet() const;
+
+    static InstructionSet DetectInstructionSet();
+    static const char* GetInstructionSetName(InstructionSet instructionSet);
+
+private:
+    glm::vec3 m_rotationAxis;
+    glm::vec3 m_normalizedAxis;
+    InstructionSet m_instructionSet;
+
+    void ComputeScalar(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const;
+    void ComputeSSE(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const;
+    void ComputeAVX2(const TransformBatch& batch, size_t first, size_t count, glm::mat4* out) const;
+};
@@ -55,6 +55,8 @@ int TrianglesAndShaders::mainImplTriangleWithVBO() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	// Shader binds its programs through the state cache, which has to start from a clean slate with a new context
+	GLStateCache::Invalidate();
 
 	// this tells OpenGL the dimensions of the rendering window. The previous usage of these
 	// dimensions was just to tell GLFW to make the window that size. 
@@ -116,9 +118,7 @@ int TrianglesAndShaders::mainImplTriangleWithVBO() {
 	// other options are GL_DYNAMIC_DRAW, where data will change and is used by GPU many times
 	// and GL_STREAM_DRAW, where it doesn't change and is used only a few times
 
-	auto vertPath = m_appParamsProvider->GetAppPath() + "\\vertex.glsl";
-	auto fragPath = m_appParamsProvider->GetAppPath() + "\\fragment.glsl";
-	Shader shader = *(new Shader(vertPath.c_str(), fragPath.c_str()));
+	std::shared_ptr<Shader> shader = ShaderRegistry::Load("vertex.glsl", "fragment.glsl");
 
 	// unsigned int yellowShaderProgram = createBasicShaderProgram("1.0f, 1.5f, 0.2f, 1.0f");
 
@@ -208,12 +208,12 @@ int TrianglesAndShaders::mainImplTriangleWithVBO() {
 		float timeValue = glfwGetTime();
 		float greenValue = (sin(timeValue) / 2.0f) + 0.5f; // sin oscillation between 0 and 1
 
-		shader.setFloat2("offset", 0.25f, 0.f);
+		shader->setFloat2("offset", 0.25f, 0.f);
 		// shader.setFloat4("ourColor", 0.0f, greenValue, 0.0f, 1.0f);
 		std::cout << greenValue << std::endl;
 
 		// ACTIVATE THE PROGRAM
-		shader.use();
+		shader->use();
 		// every shader and render call will now use this program object
 
 		// bind the VAO for this frame
@@ -243,6 +243,7 @@ int TrianglesAndShaders::mainImplTriangleWithVBO() {
 		glfwSwapBuffers(window);
 	}
 
+	shader.reset(); // the program has to be deleted before the context goes away
 	glfwTerminate(); // remember to clean up
 	return 0;
 
@@ -250,11 +251,7 @@ int TrianglesAndShaders::mainImplTriangleWithVBO() {
 
 unsigned int TrianglesAndShaders::createBasicShaderProgram() {
 	ShaderLoader shaderLoader;
-	auto vertexPath = m_appParamsProvider->GetAppPath() + "\\vertex.glsl";
-	auto fragmentPath = m_appParamsProvider->GetAppPath() + "\\fragment.glsl";
-	return shaderLoader.createBasicShaderProgram(
-		vertexPath.c_str(),
-		fragmentPath.c_str());
+	return shaderLoader.createBasicShaderProgram("vertex.glsl", "fragment.glsl");
 }
 
 unsigned int TrianglesAndShaders::createBasicShaderProgram(std::string fragColorString) {
@@ -349,6 +346,8 @@ int TrianglesAndShaders::mainImplRectangleWithEBO() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	// Shader binds its programs through the state cache, which has to start from a clean slate with a new context
+	GLStateCache::Invalidate();
 
 	glViewport(0, 0, m_windowWidth, m_windowHeight);
 
@@ -366,9 +365,7 @@ int TrianglesAndShaders::mainImplRectangleWithEBO() {
 		1, 2, 3    // second triangle
 	};
 
-	auto vertPath = m_appParamsProvider->GetAppPath() + "\\vertex.glsl";
-	auto fragPath = m_appParamsProvider->GetAppPath() + "\\fragment.glsl";
-	Shader shader = *(new Shader(vertPath.c_str(), fragPath.c_str()));
+	std::shared_ptr<Shader> shader = ShaderRegistry::Load("vertex.glsl", "fragment.glsl");
 
 	// initialize a VAO
 	// VAOs also store element buffers. If after binding this VAO, GL_ELEMENT_ARRAY_BUFFER is bound, 
@@ -407,7 +404,7 @@ int TrianglesAndShaders::mainImplRectangleWithEBO() {
 		glClearColor(0.3f, 0.6f, 0.1f, 1.0f); // set color used when clearing
 		glClear(GL_COLOR_BUFFER_BIT); // clear
 
-		shader.use();
+		shader->use();
 		glBindVertexArray(VAO); // bind the VAO that points to the EBO to use its vertex attribute config
 
 		// make it draw a wireframe (can revert with GL_FILL instead of GL_LINE afterwards)
@@ -430,6 +427,7 @@ int TrianglesAndShaders::mainImplRectangleWithEBO() {
 
 	}
 
+	shader.reset();
 	glfwTerminate();
 	return 0;
 }
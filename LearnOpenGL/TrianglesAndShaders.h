@@ -8,8 +8,10 @@
 #include <iostream>
 
 // Custom files from this project
+#include "GLStateCache.h"
 #include "ShaderLoader.h"
 #include "Shader.h"
+#include "ShaderRegistry.h"
 #include "IApplicationParamsProvider.h"
 #include "OpenGLUtilities.h"
 #include "GLFWUtilities.h"
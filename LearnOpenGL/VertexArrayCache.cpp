@@ -0,0 +1,225 @@
+#include "VertexArrayCache.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "GLResources.h"
+#include "GLStateCache.h"
+#include "Hash.h"
+
+std::unordered_map<VertexArrayCache::Key, VertexArrayCache::Entry, VertexArrayCache::KeyHash> VertexArrayCache::s_entries;
+bool VertexArrayCache::s_reportedBufferSwitch = false;
+VertexArrayCache::Counters VertexArrayCache::s_frame;
+VertexArrayCache::Counters VertexArrayCache::s_lastFrame;
+VertexArrayCache::Counters VertexArrayCache::s_total;
+
+bool VertexArrayCache::Key::operator==(const Key& other) const
+{
+	return formatHash == other.formatHash && elementBuffer == other.elementBuffer
+		&& memcmp(buffers, other.buffers, sizeof(buffers)) == 0;
+}
+
+size_t VertexArrayCache::KeyHash::operator()(const Key& key) const
+{
+	uint64_t hash = Hash::Fnv1a((const char*)key.buffers, sizeof(key.buffers), key.formatHash);
+	return (size_t)Hash::Fnv1a((const char*)&key.elementBuffer, sizeof(key.elementBuffer), hash);
+}
+
+GLuint VertexArrayCache::Bind(const VertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint elementBuffer)
+{
+	s_frame.binds++;
+	s_total.binds++;
+
+	GLuint bindingCount = (GLuint)format.bindings.size();
+	if (bindingCount > MaxBindings)
+	{
+		std::cout << "ERROR::VERTEX_ARRAY_CACHE: " << bindingCount << " buffer bindings, only " << MaxBindings << " are supported" << std::endl;
+		return 0;
+	}
+
+	Key key = {};
+	key.formatHash = format.hash;
+	if (!UsesSeparateFormats())
+	{
+		memcpy(key.buffers, buffers, bindingCount * sizeof(GLuint));
+		key.elementBuffer = elementBuffer;
+	}
+
+	auto found = s_entries.find(key);
+	if (found == s_entries.end())
+	{
+		found = s_entries.emplace(key, CreateVertexArray(format)).first;
+		s_frame.created++;
+		s_total.created++;
+	}
+	Entry& entry = found->second;
+
+	GLStateCache::BindVertexArray(entry.vertexArray);
+	for (GLuint binding = 0; binding < bindingCount; ++binding)
+	{
+		GLintptr offset = offsets ? offsets[binding] : 0;
+		if (entry.buffers[binding] != buffers[binding] || entry.offsets[binding] != offset)
+		{
+			// a buffer that's been deleted would have taken the VAO with it (see RemoveBuffer), so this one is still in
+			// use by an earlier Bind, which may be sitting in a render queue
+			if (entry.buffers[binding] != 0 && entry.buffers[binding] != buffers[binding] && !s_reportedBufferSwitch)
+			{
+				std::cout << "ERROR::VERTEX_ARRAY_CACHE: binding " << binding << " of a format switched from buffer " << entry.buffers[binding]
+					<< " to " << buffers[binding] << ". Meshes of one format have to share their buffers" << std::endl;
+				s_reportedBufferSwitch = true;
+			}
+			AttachBuffer(format, binding, buffers[binding], offset);
+			entry.buffers[binding] = buffers[binding];
+			entry.offsets[binding] = offset;
+		}
+	}
+	if (entry.elementBuffer != elementBuffer)
+	{
+		if (entry.elementBuffer != 0 && !s_reportedBufferSwitch)
+		{
+			std::cout << "ERROR::VERTEX_ARRAY_CACHE: a format's element buffer switched from " << entry.elementBuffer << " to "
+				<< elementBuffer << ". Meshes of one format have to share their buffers" << std::endl;
+			s_reportedBufferSwitch = true;
+		}
+		GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+		entry.elementBuffer = elementBuffer;
+	}
+	return entry.vertexArray;
+}
+
+VertexArrayCache::Entry VertexArrayCache::CreateVertexArray(const VertexFormat& format)
+{
+	Entry entry;
+	// the cache deletes these in batches itself (through GLStateCache, which untracks them), so they're plain names
+	glGenVertexArrays(1, &entry.vertexArray);
+	GLResourceRegistry::Track(GLResourceType::VertexArray, entry.vertexArray, "VertexArrayCache");
+	GLStateCache::BindVertexArray(entry.vertexArray);
+
+	for (const VertexFormat::Attribute& attribute : format.attributes)
+	{
+		if (UsesSeparateFormats())
+		{
+			// the format is all that's set here. Where the data comes from is up to the binding, which Bind attaches
+			// buffers to
+			if (attribute.integer)
+			{
+				glVertexAttribIFormat(attribute.location, attribute.components, attribute.type, attribute.relativeOffset);
+			}
+			else
+			{
+				glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.relativeOffset);
+			}
+			glVertexAttribBinding(attribute.location, attribute.binding);
+		}
+		else if (format.bindings[attribute.binding].divisor != 0)
+		{
+			glVertexAttribDivisor(attribute.location, format.bindings[attribute.binding].divisor);
+		}
+		glEnableVertexAttribArray(attribute.location);
+	}
+	if (UsesSeparateFormats())
+	{
+		for (GLuint binding = 0; binding < format.bindings.size(); ++binding)
+		{
+			glVertexBindingDivisor(binding, format.bindings[binding].divisor);
+		}
+	}
+
+	// a new VAO points at nothing, and an offset of -1 never matches, so Bind attaches every buffer
+	for (GLintptr& offset : entry.offsets)
+	{
+		offset = -1;
+	}
+	return entry;
+}
+
+void VertexArrayCache::AttachBuffer(const VertexFormat& format, GLuint binding, GLuint buffer, GLintptr offset)
+{
+	s_frame.vertexBufferBinds++;
+	s_total.vertexBufferBinds++;
+	const VertexFormat::Binding& bindingFormat = format.bindings[binding];
+	if (UsesSeparateFormats())
+	{
+		glBindVertexBuffer(binding, buffer, offset, bindingFormat.stride);
+		return;
+	}
+
+	// the attribute pointers take their buffer from GL_ARRAY_BUFFER when they're set, so every attribute reading from
+	// this binding is pointed again
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (const VertexFormat::Attribute& attribute : format.attributes)
+	{
+		if (attribute.binding != binding)
+		{
+			continue;
+		}
+		const void* pointer = (const void*)(offset + attribute.relativeOffset);
+		if (attribute.integer)
+		{
+			glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, bindingFormat.stride, pointer);
+		}
+		else
+		{
+			glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, bindingFormat.stride, pointer);
+		}
+	}
+}
+
+void VertexArrayCache::RemoveBuffer(GLuint buffer)
+{
+	// 0 is what every unused binding holds, so it would match nearly everything
+	if (buffer == 0)
+	{
+		return;
+	}
+	std::vector<GLuint> deleted;
+	for (auto it = s_entries.begin(); it != s_entries.end();)
+	{
+		Entry& entry = it->second;
+		bool pointsAtBuffer = entry.elementBuffer == buffer;
+		for (GLuint bound : entry.buffers)
+		{
+			pointsAtBuffer = pointsAtBuffer || bound == buffer;
+		}
+		if (pointsAtBuffer)
+		{
+			deleted.push_back(entry.vertexArray);
+			it = s_entries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	if (!deleted.empty())
+	{
+		GLStateCache::DeleteVertexArrays((GLsizei)deleted.size(), deleted.data());
+	}
+}
+
+void VertexArrayCache::Clear()
+{
+	std::vector<GLuint> vertexArrays;
+	for (const auto& keyAndEntry : s_entries)
+	{
+		vertexArrays.push_back(keyAndEntry.second.vertexArray);
+	}
+	if (!vertexArrays.empty())
+	{
+		GLStateCache::DeleteVertexArrays((GLsizei)vertexArrays.size(), vertexArrays.data());
+	}
+	s_entries.clear();
+}
+
+void VertexArrayCache::EndFrame()
+{
+	s_lastFrame = s_frame;
+	s_frame = Counters();
+}
+
+void VertexArrayCache::PrintStats()
+{
+	std::cout << "Vertex array cache: " << s_entries.size() << " VAOs (" << (UsesSeparateFormats() ? "one per format" : "one per format and buffers")
+		<< "), " << s_total.binds << " binds, " << s_total.vertexBufferBinds << " vertex buffer binds, "
+		<< GLStateCache::GetTotalCounters().vertexArraySwitches << " VAO switches" << std::endl;
+}
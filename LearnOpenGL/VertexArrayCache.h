@@ -0,0 +1,101 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "VertexLayout.h"
+
+/// <summary>
+/// Hands out VAOs by vertex format and buffers, so a mesh doesn't need a VAO of its own set up by hand, and two meshes
+/// with the same layout (or the same mesh set up twice) share one.
+///
+/// With GL 4.3 the format and the buffers are separate (ARB_vertex_attrib_binding): each format gets one VAO, with the
+/// attribute formats set once by glVertexAttribFormat, and switching to another mesh in the same format is just
+/// glBindVertexBuffer (and the element buffer) on that same VAO, with no VAO switch at all. Before 4.3 the buffers are
+/// baked into the attribute pointers, so there's a VAO per format and set of buffers instead, which still saves making
+/// the same one twice. Either way a binding whose offset changes (a new slice of a ring buffer) is re-pointed in
+/// place rather than getting a new VAO.
+///
+/// The cache remembers which buffers each VAO points at, so a buffer has to be passed to RemoveBuffer before it's
+/// deleted, or a new buffer that gets the same name would be taken for it. There's only one context, so this is all
+/// static, like GLStateCache, which every bind here goes through.
+///
+/// With separate formats the returned VAO only stays pointed at these buffers until the next Bind of the same format,
+/// and RenderQueue::Command only keeps the VAO's name. So every mesh of a format has to come from the same buffers (one
+/// GeometryPool per format, plus one ring buffer for per-instance data, whose offset can move) or two queued draws would
+/// both read whichever buffers were attached last. Bind prints an error if a format's VAO is switched to a different
+/// buffer while the old one is still alive
+/// </summary>
+class VertexArrayCache
+{
+public:
+	static constexpr int MaxBindings = 4;
+
+	struct Counters
+	{
+		// Bind calls, and how many of those had to make a new VAO
+		uint64_t binds = 0;
+		uint64_t created = 0;
+		// buffers (re)attached to a binding point, by glBindVertexBuffer or by setting the attribute pointers again
+		uint64_t vertexBufferBinds = 0;
+	};
+
+	static bool UsesSeparateFormats() { return GLAD_GL_VERSION_4_3 != 0; }
+
+	/// <summary>
+	/// Binds a VAO that reads format's binding i from buffers[i], starting offsets[i] bytes in (all 0 if offsets is
+	/// nullptr), with elementBuffer as its element buffer, making one if there isn't one yet. Returns it, so it can be
+	/// bound again later (e.g. by the render queue) without going through here, as long as nothing in the meantime
+	/// bound it with other buffers
+	/// </summary>
+	static GLuint Bind(const VertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint elementBuffer);
+
+	/// <summary>
+	/// Forgets every VAO that points at buffer. Call before deleting it
+	/// </summary>
+	static void RemoveBuffer(GLuint buffer);
+	/// <summary>
+	/// Deletes every VAO. Call before the context goes away
+	/// </summary>
+	static void Clear();
+
+	static void EndFrame();
+	static size_t GetVertexArrayCount() { return s_entries.size(); }
+	static const Counters& GetLastFrameCounters() { return s_lastFrame; }
+	static void PrintStats();
+
+private:
+	struct Key
+	{
+		uint64_t formatHash;
+		// all 0 with separate formats, where the buffers aren't part of the VAO's identity
+		GLuint buffers[MaxBindings];
+		GLuint elementBuffer;
+
+		bool operator==(const Key& other) const;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+	struct Entry
+	{
+		GLuint vertexArray = 0;
+		// what the VAO points at now
+		GLuint buffers[MaxBindings] = {};
+		GLintptr offsets[MaxBindings] = {};
+		GLuint elementBuffer = 0;
+	};
+
+	static std::unordered_map<Key, Entry, KeyHash> s_entries;
+	// the buffer switch error is only printed once, since it would otherwise come every frame
+	static bool s_reportedBufferSwitch;
+	static Counters s_frame;
+	static Counters s_lastFrame;
+	static Counters s_total;
+
+	static Entry CreateVertexArray(const VertexFormat& format);
+	static void AttachBuffer(const VertexFormat& format, GLuint binding, GLuint buffer, GLintptr offset);
+};
+
@@ -1,19 +1,265 @@
 #include "VertexBufferLayout.h"
-#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
-void VertexBufferLayout::Process()
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::Float(GLint components)
+{
+    return Attribute{ components, GL_FLOAT, GL_FALSE, false };
+}
+
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::HalfFloat(GLint components)
+{
+    return Attribute{ components, GL_HALF_FLOAT, GL_FALSE, false };
+}
+
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::UnsignedShortNormalized(GLint components)
+{
+    return Attribute{ components, GL_UNSIGNED_SHORT, GL_TRUE, false };
+}
+
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::UnsignedByteNormalized(GLint components)
+{
+    return Attribute{ components, GL_UNSIGNED_BYTE, GL_TRUE, false };
+}
+
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::PackedNormal()
+{
+    // a packed type always has 4 components as far as GL is concerned. A vec3 in the shader just ignores w
+    return Attribute{ 4, GL_INT_2_10_10_10_REV, GL_TRUE, false };
+}
+
+VertexBufferLayout::Attribute VertexBufferLayout::Attribute::Integer(GLint components, GLenum type)
+{
+    return Attribute{ components, type, GL_FALSE, true };
+}
+
+GLsizei VertexBufferLayout::Attribute::GetSize() const
+{
+    GLsizei size = type == GL_INT_2_10_10_10_REV ? 4 : components * GetComponentSize(type);
+    return (size + 3) & ~3;
+}
+
+int VertexBufferLayout::Attribute::GetSourceFloatCount() const
+{
+    return type == GL_INT_2_10_10_10_REV ? 3 : components;
+}
+
+VertexBufferLayout::VertexBufferLayout(std::vector<int>&& layout)
+{
+    for (int attributeSize : layout)
+    {
+        m_attributes.push_back(Attribute::Float(attributeSize));
+    }
+}
+
+GLsizei VertexBufferLayout::GetStride() const
 {
     GLsizei stride = 0;
+    for (const Attribute& attribute : m_attributes)
+    {
+        stride += attribute.GetSize();
+    }
+    return stride;
+}
+
+int VertexBufferLayout::GetSourceFloatCount() const
+{
+    int count = 0;
+    for (const Attribute& attribute : m_attributes)
+    {
+        count += attribute.GetSourceFloatCount();
+    }
+    return count;
+}
+
+void VertexBufferLayout::Process()
+{
+    GLsizei stride = GetStride();
+
+    size_t offset = 0;
+    for (size_t i = 0; i < m_attributes.size(); ++i) {
+        const Attribute& attribute = m_attributes[i];
+        GLuint location = (GLuint)i;
+        if (attribute.integer)
+        {
+            glVertexAttribIPointer(location, attribute.components, attribute.type, stride, (void*)offset);
+        }
+        else
+        {
+            glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized, stride, (void*)offset);
+        }
+        offset += attribute.GetSize();
+        glEnableVertexAttribArray(location);
+    }
+}
+
+/// <summary>
+/// value scaled from [0, 1] (or [-1, 1] if it's signed) to [0, max] (or [-max, max]) and rounded. The multiply is
+/// done in double, since a float only has about 1/256 precision left around 65535, which would round some values the
+/// wrong way. Before GL 4.2, signed values decode as (2c + 1) / (2 max + 1), so that's inverted instead, giving
+/// [-max - 1, max]
+/// </summary>
+static int32_t Normalize(float value, int32_t max, bool isSigned, VertexBufferLayout::SignedNormalization signedRule)
+{
+    value = std::min(std::max(value, isSigned ? -1.0f : 0.0f), 1.0f);
+    if (isSigned && signedRule == VertexBufferLayout::SignedNormalization::BeforeGl42)
+    {
+        int32_t quantized = (int32_t)std::lround(((double)value * (2 * max + 1) - 1.0) / 2.0);
+        return std::min(std::max(quantized, -max - 1), max);
+    }
+    return (int32_t)std::lround((double)value * max);
+}
+
+VertexBufferLayout::SignedNormalization VertexBufferLayout::GetContextSignedNormalization()
+{
+    return GLAD_GL_VERSION_4_2 ? SignedNormalization::Gl42AndLater : SignedNormalization::BeforeGl42;
+}
 
-    for (auto&& attributeSize : m_layout) {
-        stride += attributeSize;
+std::vector<unsigned char> VertexBufferLayout::Quantize(const float* vertices, size_t vertexCount) const
+{
+    return Quantize(vertices, vertexCount, GetContextSignedNormalization());
+}
+
+std::vector<unsigned char> VertexBufferLayout::Quantize(const float* vertices, size_t vertexCount, SignedNormalization signedRule) const
+{
+    GLsizei stride = GetStride();
+    std::vector<unsigned char> output(vertexCount * stride, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        unsigned char* destination = &output[v * stride];
+        for (const Attribute& attribute : m_attributes)
+        {
+            if (attribute.type == GL_INT_2_10_10_10_REV)
+            {
+                // two's complement 10 bit x, y and z, from the lowest bits up
+                uint32_t packed = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    packed |= ((uint32_t)Normalize(vertices[c], 511, true, signedRule) & 0x3FF) << (c * 10);
+                }
+                memcpy(destination, &packed, sizeof(packed));
+            }
+            else
+            {
+                for (int c = 0; c < attribute.components; ++c)
+                {
+                    float value = vertices[c];
+                    unsigned char* component = destination + c * GetComponentSize(attribute.type);
+                    switch (attribute.type)
+                    {
+                    case GL_HALF_FLOAT:
+                    {
+                        uint16_t half = FloatToHalf(value);
+                        memcpy(component, &half, sizeof(half));
+                        break;
+                    }
+                    case GL_UNSIGNED_SHORT:
+                    {
+                        uint16_t quantized = (uint16_t)(attribute.normalized ? Normalize(value, 0xFFFF, false, signedRule) : std::lround(value));
+                        memcpy(component, &quantized, sizeof(quantized));
+                        break;
+                    }
+                    case GL_SHORT:
+                    {
+                        int16_t quantized = (int16_t)(attribute.normalized ? Normalize(value, 0x7FFF, true, signedRule) : std::lround(value));
+                        memcpy(component, &quantized, sizeof(quantized));
+                        break;
+                    }
+                    case GL_UNSIGNED_BYTE:
+                        *component = (unsigned char)(attribute.normalized ? Normalize(value, 0xFF, false, signedRule) : std::lround(value));
+                        break;
+                    case GL_BYTE:
+                        *component = (unsigned char)(int8_t)(attribute.normalized ? Normalize(value, 0x7F, true, signedRule) : std::lround(value));
+                        break;
+                    case GL_UNSIGNED_INT:
+                    case GL_INT:
+                    {
+                        int32_t quantized = (int32_t)std::lround(value);
+                        memcpy(component, &quantized, sizeof(quantized));
+                        break;
+                    }
+                    default:
+                        memcpy(component, &value, sizeof(value));
+                        break;
+                    }
+                }
+            }
+            vertices += attribute.GetSourceFloatCount();
+            destination += attribute.GetSize();
+        }
+    }
+    return output;
+}
+
+uint16_t VertexBufferLayout::FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+    {
+        // infinity stays infinity, NaN stays a NaN
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31)
+    {
+        // too big for a half
+        return sign | 0x7C00;
+    }
+    if (exponent <= 0)
+    {
+        // too small to be a normal half. Either a denormal, with the implicit 1 shifted down into the mantissa, or 0
+        if (exponent < -10)
+        {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        // round to nearest, ties to even
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return sign | (uint16_t)half;
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    // a carry out of the mantissa rounds up into the exponent, which is exactly right, up to and including infinity
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+        half++;
     }
-    stride *= sizeof(float);
+    return sign | (uint16_t)half;
+}
 
-    int offset = 0;
-    for (int i = 0; i < m_layout.size(); ++i) {
-        glVertexAttribPointer(i, m_layout[i], GL_FLOAT, GL_FALSE, stride, (void*)(offset * sizeof(float)));
-        offset += m_layout[i];
-        glEnableVertexAttribArray(i);
+float VertexBufferLayout::HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent == 0)
+    {
+        // 0 or a denormal, which is mantissa * 2^-24 either way
+        float value = std::ldexp((float)mantissa, -24);
+        return sign ? -value : value;
+    }
+    else
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
     }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
 }
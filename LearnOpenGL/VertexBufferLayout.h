@@ -1,4 +1,8 @@
 #pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 /// <summary>
@@ -7,13 +11,95 @@
 /// in units of array elements as a list to the constructor, and then call Process() to inform OpenGL
 /// of the layout of the attributes. Note that it expects the order to be sequential starting from layout
 /// location 0.
+///
+/// A list of sizes means every attribute is floats. To store them smaller, give it Attributes instead, and use
+/// Quantize to turn the float vertices into that layout. Half floats are plenty for positions of anything that isn't
+/// huge, 16 bit normalized ints for texture coordinates in [0, 1], 10 bits per axis for normals and a byte per channel
+/// for colors, which takes a position, normal, texture coordinate and RGBA color vertex from 48 bytes to 20.
+/// The shader doesn't need to change, everything but integer attributes still arrives as floats.
+///
+/// For a layout that's known at compile time, VertexLayout (in VertexLayout.h) does the same thing without working
+/// anything out at runtime
 /// </summary>
 class VertexBufferLayout
 {
+public:
+	/// <summary>
+	/// How the shader turns a signed normalized int c of b bits back into a float. GL 4.2 changed the rule: it's c / max
+	/// (max being 2^(b-1) - 1) from then on, but before that it was (2c + 1) / (2^b - 1), which has no exact 0 and is half
+	/// a step off the other one everywhere. Which one applies depends on the context's version
+	/// </summary>
+	enum class SignedNormalization { Gl42AndLater, BeforeGl42 };
+
+	struct Attribute
+	{
+		GLint components = 0;
+		GLenum type = GL_FLOAT;
+		// integer types only: whether [0, max] (or [-max, max] for signed ones) maps to [0, 1] (or [-1, 1]) in the
+		// shader, or the value is just converted to a float
+		GLboolean normalized = GL_FALSE;
+		// read by the shader as ints (ivec/uvec), which takes glVertexAttribIPointer
+		bool integer = false;
+
+		static Attribute Float(GLint components);
+		static Attribute HalfFloat(GLint components);
+		static Attribute UnsignedShortNormalized(GLint components);
+		static Attribute UnsignedByteNormalized(GLint components);
+		/// <summary>
+		/// A unit vector in [-1, 1], as 10 bits each for x, y and z in one int (GL_INT_2_10_10_10_REV). Quantize reads 3
+		/// floats for it, and the 2 bits of w are left 0
+		/// </summary>
+		static Attribute PackedNormal();
+		static Attribute Integer(GLint components, GLenum type);
+
+		/// <summary>
+		/// Bytes taken up in a vertex, rounded up to a multiple of 4, since that's the alignment GPUs like attributes to
+		/// start on
+		/// </summary>
+		GLsizei GetSize() const;
+		/// <summary>
+		/// How many floats of the unquantized vertex this is made from
+		/// </summary>
+		int GetSourceFloatCount() const;
+	};
+
 private:
-	std::vector<int> m_layout;
+	std::vector<Attribute> m_attributes;
 public:
-	VertexBufferLayout(std::vector<int>&& layout) : m_layout(layout) {}
+	VertexBufferLayout(std::vector<int>&& layout);
+	VertexBufferLayout(std::vector<Attribute>&& attributes) : m_attributes(std::move(attributes)) {}
 	void Process();
+
+	GLsizei GetStride() const;
+	/// <summary>
+	/// Floats per vertex of the unquantized vertices Quantize takes
+	/// </summary>
+	int GetSourceFloatCount() const;
+
+	/// <summary>
+	/// Converts vertexCount vertices of GetSourceFloatCount floats each into this layout, ready to upload. Values outside
+	/// what a normalized attribute can hold are clamped, floats are rounded to the nearest representable value. Signed
+	/// normalized values are rounded to the nearest one under signedRule, so they decode right on a context that uses it
+	/// </summary>
+	std::vector<unsigned char> Quantize(const float* vertices, size_t vertexCount, SignedNormalization signedRule) const;
+	/// <summary>
+	/// Same, for the rule of the current context (see GetContextSignedNormalization)
+	/// </summary>
+	std::vector<unsigned char> Quantize(const float* vertices, size_t vertexCount) const;
+
+	/// <summary>
+	/// The signed normalization rule of the context GL was loaded for
+	/// </summary>
+	static SignedNormalization GetContextSignedNormalization();
+
+	static constexpr GLsizei GetComponentSize(GLenum type)
+	{
+		return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1
+			: type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2
+			: 4;
+	}
+
+	static uint16_t FloatToHalf(float value);
+	static float HalfToFloat(uint16_t half);
 };
 
@@ -0,0 +1,302 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "GLStateCache.h"
+#include "Hash.h"
+#include "VertexBufferLayout.h"
+
+/// <summary>
+/// A vertex layout written out as plain data, split into the format of each attribute and the buffer bindings they
+/// read from, the way glVertexAttribFormat and glBindVertexBuffer see it. This is what VertexArrayCache works from.
+/// The layout templates below build theirs once (see GetFormat), so there's one per layout type and its address never
+/// changes
+/// </summary>
+struct VertexFormat
+{
+	struct Attribute
+	{
+		GLuint location;
+		GLuint binding;
+		GLint components;
+		GLenum type;
+		GLboolean normalized;
+		bool integer;
+		// from the start of the vertex
+		GLuint relativeOffset;
+	};
+	struct Binding
+	{
+		GLsizei stride;
+		GLuint divisor;
+	};
+
+	std::vector<Attribute> attributes;
+	std::vector<Binding> bindings;
+	// of everything above, so two formats that are the same hash the same no matter where they came from
+	uint64_t hash = 0;
+
+	void ComputeHash()
+	{
+		hash = Hash::FnvOffsetBasis;
+		for (const Attribute& attribute : attributes)
+		{
+			const GLuint fields[] = { attribute.location, attribute.binding, (GLuint)attribute.components, attribute.type,
+				attribute.normalized, attribute.integer, attribute.relativeOffset };
+			hash = Hash::Fnv1aPart((const char*)fields, sizeof(fields), hash);
+		}
+		for (const Binding& binding : bindings)
+		{
+			const GLuint fields[] = { (GLuint)binding.stride, binding.divisor };
+			hash = Hash::Fnv1aPart((const char*)fields, sizeof(fields), hash);
+		}
+	}
+};
+
+/// <summary>
+/// One vertex attribute as a type, so a whole layout can be worked out by the compiler. Locations is how many
+/// attribute locations it takes up, each of them Components of Type: a mat4 is 4 vec4 columns, one per location
+/// </summary>
+template<GLint ComponentCount, GLenum ComponentType, GLboolean IsNormalized = GL_FALSE, bool IsInteger = false, GLuint LocationCount = 1>
+struct VertexAttribute
+{
+	static constexpr GLint Components = ComponentCount;
+	static constexpr GLenum Type = ComponentType;
+	static constexpr GLboolean Normalized = IsNormalized;
+	static constexpr bool Integer = IsInteger;
+	static constexpr GLuint Locations = LocationCount;
+	// padded to 4 bytes per location, the same as VertexBufferLayout::Attribute::GetSize
+	static constexpr GLsizei LocationSize = Type == GL_INT_2_10_10_10_REV ? 4
+		: (Components * VertexBufferLayout::GetComponentSize(Type) + 3) & ~3;
+	static constexpr GLsizei Size = LocationSize * Locations;
+};
+
+using Pos3f = VertexAttribute<3, GL_FLOAT>;
+using Pos3h = VertexAttribute<3, GL_HALF_FLOAT>;
+using Normal3f = VertexAttribute<3, GL_FLOAT>;
+using NormalPacked = VertexAttribute<4, GL_INT_2_10_10_10_REV, GL_TRUE>;
+using Color3f = VertexAttribute<3, GL_FLOAT>;
+using Color4ub = VertexAttribute<4, GL_UNSIGNED_BYTE, GL_TRUE>;
+using UV2f = VertexAttribute<2, GL_FLOAT>;
+using UV2us = VertexAttribute<2, GL_UNSIGNED_SHORT, GL_TRUE>;
+using Mat4f = VertexAttribute<4, GL_FLOAT, GL_FALSE, false, 4>;
+
+/// <summary>
+/// The same job as VertexBufferLayout, but for layouts known at compile time, which is nearly all of them: stride and
+/// offsets are constants, and Apply is just the glVertexAttribPointer calls, with no vectors or loops over a list.
+/// A layout is VertexLayout<Pos3f, Color3f, UV2f> (per vertex) or InstanceLayout<Mat4f> (per instance), and
+/// static_assert(Layout::Matches<Vertex>()) checks it against the struct the vertices are written as.
+///
+/// The attributes are interleaved in one buffer. For attributes split across several buffers (positions in one,
+/// texture coordinates in another, instance data in a third), see MultiBufferVertexLayout
+/// </summary>
+template<GLuint Divisor, typename... Attributes>
+class BasicVertexLayout
+{
+public:
+	static constexpr GLuint AttributeDivisor = Divisor;
+	static constexpr size_t AttributeCount = sizeof...(Attributes);
+	static constexpr GLsizei Stride = (0 + ... + Attributes::Size);
+	static constexpr GLuint LocationCount = (0 + ... + Attributes::Locations);
+
+	/// <summary>
+	/// Byte offset of attribute Index within a vertex
+	/// </summary>
+	template<size_t Index>
+	static constexpr GLsizei Offset()
+	{
+		static_assert(Index < AttributeCount, "the layout doesn't have that many attributes");
+		constexpr GLsizei sizes[] = { Attributes::Size... };
+		GLsizei offset = 0;
+		for (size_t i = 0; i < Index; ++i)
+		{
+			offset += sizes[i];
+		}
+		return offset;
+	}
+
+	/// <summary>
+	/// Whether Vertex can be uploaded as is for this layout. C++ can't list a struct's members, so this is its size
+	/// (which catches a missing, extra or wrongly sized member, or padding) and that it's laid out like a C struct
+	/// </summary>
+	template<typename Vertex>
+	static constexpr bool Matches()
+	{
+		return sizeof(Vertex) == Stride && std::is_standard_layout<Vertex>::value;
+	}
+
+	/// <summary>
+	/// The per member half of Matches: whether a member of type Member (e.g. decltype(Vertex::position) for a float[3]),
+	/// offset bytes into the struct (offsetof), is what attribute Index expects there. That's Offset<Index>(), the same
+	/// number of components, and components of the C++ type that goes with the attribute's GL type (GLushort for half
+	/// floats, one GLuint or GLint for packed normals). Together with Matches this catches reordered or retyped members
+	/// </summary>
+	template<size_t Index, typename Member>
+	static constexpr bool MemberMatches(size_t offset)
+	{
+		using Attribute = std::tuple_element_t<Index, std::tuple<Attributes...>>;
+		using Component = std::remove_all_extents_t<Member>;
+		constexpr bool packed = Attribute::Type == GL_INT_2_10_10_10_REV;
+		constexpr size_t componentCount = std::extent<Member>::value == 0 ? 1 : std::extent<Member>::value;
+		return Attribute::Locations == 1 && offset == (size_t)Offset<Index>()
+			&& componentCount == (packed ? 1 : (size_t)Attribute::Components)
+			&& IsComponentType<Component>(Attribute::Type);
+	}
+
+	/// <summary>
+	/// Points locations firstLocation onwards at the buffer bound to GL_ARRAY_BUFFER, starting baseOffset bytes in,
+	/// enables them and sets their divisor. The attribute setup belongs to the bound VAO
+	/// </summary>
+	static void Apply(GLuint firstLocation = 0, GLintptr baseOffset = 0)
+	{
+		GLuint location = firstLocation;
+		GLintptr offset = baseOffset;
+		(ApplyAttribute<Attributes>(location, offset, true), ...);
+	}
+
+	/// <summary>
+	/// Just the pointers, for when the data has moved within the buffer (e.g. a new slice of a ring buffer) but the
+	/// attributes are already enabled
+	/// </summary>
+	static void SetPointers(GLuint firstLocation, GLintptr baseOffset)
+	{
+		GLuint location = firstLocation;
+		GLintptr offset = baseOffset;
+		(ApplyAttribute<Attributes>(location, offset, false), ...);
+	}
+
+	/// <summary>
+	/// The same layout for VertexBufferLayout, to Quantize vertices into it
+	/// </summary>
+	static std::vector<VertexBufferLayout::Attribute> GetAttributes()
+	{
+		static_assert(((Attributes::Locations == 1) && ...), "VertexBufferLayout has no attributes taking more than one location");
+		return { VertexBufferLayout::Attribute{ Attributes::Components, Attributes::Type, Attributes::Normalized, Attributes::Integer }... };
+	}
+
+	/// <summary>
+	/// This layout as a VertexFormat with a single binding. Built the first time it's asked for
+	/// </summary>
+	static const VertexFormat& GetFormat()
+	{
+		static const VertexFormat format = []() {
+			VertexFormat built;
+			GLuint location = 0;
+			AppendFormat(built, location);
+			built.ComputeHash();
+			return built;
+		}();
+		return format;
+	}
+
+	/// <summary>
+	/// Adds this layout's attributes to format as a new binding, starting at location (which is moved past them)
+	/// </summary>
+	static void AppendFormat(VertexFormat& format, GLuint& location)
+	{
+		GLuint binding = (GLuint)format.bindings.size();
+		format.bindings.push_back(VertexFormat::Binding{ Stride, Divisor });
+		GLuint offset = 0;
+		(AppendAttribute<Attributes>(format, binding, location, offset), ...);
+	}
+
+private:
+	template<typename Component>
+	static constexpr bool IsComponentType(GLenum type)
+	{
+		return type == GL_FLOAT ? std::is_same<Component, GLfloat>::value
+			: type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT ? std::is_same<Component, GLushort>::value
+			: type == GL_SHORT ? std::is_same<Component, GLshort>::value
+			: type == GL_UNSIGNED_BYTE ? std::is_same<Component, GLubyte>::value
+			: type == GL_BYTE ? std::is_same<Component, GLbyte>::value
+			: type == GL_UNSIGNED_INT ? std::is_same<Component, GLuint>::value
+			: type == GL_INT ? std::is_same<Component, GLint>::value
+			: type == GL_INT_2_10_10_10_REV ? std::is_same<Component, GLuint>::value || std::is_same<Component, GLint>::value
+			: false;
+	}
+
+	template<typename Attribute>
+	static void AppendAttribute(VertexFormat& format, GLuint binding, GLuint& location, GLuint& offset)
+	{
+		for (GLuint i = 0; i < Attribute::Locations; ++i, ++location)
+		{
+			format.attributes.push_back(VertexFormat::Attribute{ location, binding, Attribute::Components, Attribute::Type,
+				Attribute::Normalized, Attribute::Integer, offset + i * Attribute::LocationSize });
+		}
+		offset += Attribute::Size;
+	}
+
+	template<typename Attribute>
+	static void ApplyAttribute(GLuint& location, GLintptr& offset, bool enable)
+	{
+		for (GLuint i = 0; i < Attribute::Locations; ++i, ++location)
+		{
+			const void* pointer = (const void*)(offset + i * Attribute::LocationSize);
+			if constexpr (Attribute::Integer)
+			{
+				glVertexAttribIPointer(location, Attribute::Components, Attribute::Type, Stride, pointer);
+			}
+			else
+			{
+				glVertexAttribPointer(location, Attribute::Components, Attribute::Type, Attribute::Normalized, Stride, pointer);
+			}
+			if (enable)
+			{
+				glEnableVertexAttribArray(location);
+				if constexpr (Divisor != 0)
+				{
+					glVertexAttribDivisor(location, Divisor);
+				}
+			}
+		}
+		offset += Attribute::Size;
+	}
+};
+
+template<typename... Attributes>
+using VertexLayout = BasicVertexLayout<0, Attributes...>;
+// advances once per instance instead of once per vertex
+template<typename... Attributes>
+using InstanceLayout = BasicVertexLayout<1, Attributes...>;
+
+/// <summary>
+/// Attributes spread over several buffers, one layout per buffer, e.g.
+/// MultiBufferVertexLayout<VertexLayout<Pos3f>, VertexLayout<UV2f>, InstanceLayout<Mat4f>>. The locations carry on
+/// from one layout to the next, so that one has positions at 0, texture coordinates at 1 and the matrix at 2 to 5
+/// </summary>
+template<typename... Layouts>
+class MultiBufferVertexLayout
+{
+public:
+	static constexpr size_t BufferCount = sizeof...(Layouts);
+	static constexpr GLuint LocationCount = (0 + ... + Layouts::LocationCount);
+
+	/// <summary>
+	/// Sets up every layout's attributes reading from its buffer, in order. Leaves the last buffer bound to
+	/// GL_ARRAY_BUFFER
+	/// </summary>
+	static void Apply(const GLuint (&buffers)[BufferCount], GLuint firstLocation = 0)
+	{
+		GLuint location = firstLocation;
+		size_t buffer = 0;
+		((GLStateCache::BindBuffer(GL_ARRAY_BUFFER, buffers[buffer++]), Layouts::Apply(location), location += Layouts::LocationCount), ...);
+	}
+
+	/// <summary>
+	/// All the layouts as one VertexFormat, with binding i being Layouts[i]
+	/// </summary>
+	static const VertexFormat& GetFormat()
+	{
+		static const VertexFormat format = []() {
+			VertexFormat built;
+			GLuint location = 0;
+			(Layouts::AppendFormat(built, location), ...);
+			built.ComputeHash();
+			return built;
+		}();
+		return format;
+	}
+};
@@ -0,0 +1,10 @@
+// the per-frame camera data, shared by every program. Has to match CameraUniforms in CameraUniformBuffer.h, which is
+// bound to this block's binding point once a frame
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+};
@@ -0,0 +1,82 @@
+#version 430 core
+// GPU culling for the cube field (see GpuCulling). One invocation per cube: test its bounding sphere against the
+// frustum, and if it's visible write its model matrix and a draw command for one instance of it. A culled cube still
+// gets a command, just with no instances, so every cube's command stays at its own index
+layout (local_size_x = 64) in;
+
+struct Object
+{
+    vec4 positionRadius; // xyz is the center, w the bounding sphere radius
+    vec4 rotation;       // x is the starting angle in degrees, y how many degrees a second it spins
+};
+
+// has to match DrawElementsIndirectCommand in GpuCulling.h, which is laid out the way glMultiDrawElementsIndirect reads it
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };
+// also the instanced model matrix attribute. baseInstance is what makes instance 0 of command i read models[i]
+layout (std430, binding = 1) writeonly buffer Matrices { mat4 models[]; };
+layout (std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 3) buffer Stats { uint visibleCount; };
+
+uniform vec4 planes[6];
+uniform vec3 rotationAxis; // normalized
+uniform float time;
+uniform uint objectCount;
+uniform uint indexCount;
+// where the mesh is in the element and vertex buffers it's drawn from (see GeometryPool)
+uniform uint firstIndex;
+uniform int baseVertex;
+
+// translate(position) * rotate(angle, axis), the same as TransformKernel builds on the CPU
+mat4 modelMatrix(vec3 position, float angleDegrees)
+{
+    float angle = radians(angleDegrees);
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 axis = rotationAxis;
+    vec3 temp = (1.0 - c) * axis;
+    return mat4(
+        vec4(c + temp.x * axis.x, temp.x * axis.y + s * axis.z, temp.x * axis.z - s * axis.y, 0.0),
+        vec4(temp.y * axis.x - s * axis.z, c + temp.y * axis.y, temp.y * axis.z + s * axis.x, 0.0),
+        vec4(temp.z * axis.x + s * axis.y, temp.z * axis.y - s * axis.x, c + temp.z * axis.z, 0.0),
+        vec4(position, 1.0));
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= objectCount)
+    {
+        return;
+    }
+
+    Object object = objects[i];
+    bool visible = true;
+    for (int p = 0; p < 6; ++p)
+    {
+        if (dot(planes[p].xyz, object.positionRadius.xyz) + planes[p].w < -object.positionRadius.w)
+        {
+            visible = false;
+            break;
+        }
+    }
+
+    commands[i].count = indexCount;
+    commands[i].instanceCount = visible ? 1u : 0u;
+    commands[i].firstIndex = firstIndex;
+    commands[i].baseVertex = baseVertex;
+    commands[i].baseInstance = i;
+    if (visible)
+    {
+        models[i] = modelMatrix(object.positionRadius.xyz, object.rotation.x + object.rotation.y * time);
+        atomicAdd(visibleCount, 1u);
+    }
+}
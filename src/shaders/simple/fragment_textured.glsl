@@ -1,15 +1,33 @@
 #version 330 core
+// USE_INTERP_UNIFORM: blend the textures by the interp uniform instead of a fixed 20%
+// MIRROR_SECOND_TEXTURE: flip the second texture horizontally
+#pragma keywords USE_INTERP_UNIFORM MIRROR_SECOND_TEXTURE
 out vec4 FragColor;
 
-in vec3 ourColor;
 in vec2 TexCoord;
 
+// texture samplers
 uniform sampler2D texture1;
 uniform sampler2D texture2;
+#ifdef USE_INTERP_UNIFORM
 uniform float interp;
+#endif
+
 void main()
 {
+#ifdef MIRROR_SECOND_TEXTURE
+    vec2 secondTexCoord = vec2(-TexCoord.s, TexCoord.t);
+#else
+    vec2 secondTexCoord = TexCoord;
+#endif
+
+#ifdef USE_INTERP_UNIFORM
+    float amount = clamp(interp, 0.0, 1.0);
+#else
+    float amount = 0.2; // 80% container, 20% awesomeface
+#endif
+
     // texture is GLSL's builtin function. Takes in a sampler and texture coords
     // it uses the texture settings we specify to OpenGL (mipmaps, sampling modes for min/maxification, etc)
-    FragColor = mix(texture(texture1, TexCoord), texture(texture2, vec2(-TexCoord.s, TexCoord.t)), clamp(interp, 0.0, 1.0));
-}
\ No newline at end of file
+    FragColor = mix(texture(texture1, TexCoord), texture(texture2, secondTexCoord), amount);
+}
@@ -1,15 +1,26 @@
 #version 330 core
+// INSTANCED: take the model matrix from a per-instance attribute instead of a uniform, so a whole field of cubes can
+// be drawn with one call
+#pragma keywords INSTANCED
 layout (location = 0) in vec3 aPos; // the position variable has attribute position 0
 layout (location = 1) in vec2 aTexCoord;
+#ifdef INSTANCED
+layout (location = 2) in mat4 aModel; // per-instance model matrix. A mat4 takes up locations 2, 3, 4 and 5
+#else
+uniform mat4 model;
+#endif
 
 out vec2 TexCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "camera.glsl"
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    mat4 modelMatrix = aModel;
+#else
+    mat4 modelMatrix = model;
+#endif
+    gl_Position = viewProjection * modelMatrix * vec4(aPos, 1.0);
     TexCoord = aTexCoord;
 }